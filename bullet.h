@@ -19,6 +19,13 @@
 #error "Bullet >= 2.78 is required"
 #endif
 
+/// Type of collision filter groups and masks, changed in Bullet 2.83
+#if BT_BULLET_VERSION >= 283
+typedef int CollisionFilterInt;
+#else
+typedef short int CollisionFilterInt;
+#endif
+
 
 /** @name GL aliases to use Bullet float precision
  */
@@ -0,0 +1,424 @@
+#include <cstring>
+#include <csetjmp>
+#include <png.h>
+#include "capture.h"
+#include "display.h"
+#include "glproc.h"
+#include "log.h"
+
+
+/** @name PNG related declarations
+ */
+//@{
+
+#define PNG_ERROR_SIZE  256
+
+typedef struct
+{
+  char msg[PNG_ERROR_SIZE];
+} png_error_data;
+
+
+static void png_handler_error(png_struct* png_ptr, const char* msg)
+{
+  png_error_data* error = (png_error_data*)png_get_error_ptr(png_ptr);
+  strncpy(error->msg, msg, PNG_ERROR_SIZE);
+  error->msg[PNG_ERROR_SIZE-1] = '\0';
+  longjmp(png_jmpbuf(png_ptr), 1);
+}
+
+static void png_handler_warning(png_struct* /*png_ptr*/, const char* msg)
+{
+  LOG("PNG: warning: %s", msg);
+}
+
+//@}
+
+void writePNG(const std::string& filename, int width, int height, const unsigned char* pixels, unsigned int channels, int level)
+{
+  // Open output file
+  FILE* fp = fopen(filename.c_str(), "wb");
+  if(!fp) {
+    throw(Error("cannot open file '%s' for writing", filename.c_str()));
+  }
+  auto fp_deleter = [](FILE* fp) { fclose(fp); };
+  std::unique_ptr<FILE, decltype(fp_deleter)> fp_safe(fp, fp_deleter);
+
+  // created before setjmp(), not modified after it
+  std::unique_ptr<png_bytep[]> row_pointers(new png_bytep[height]);
+  for(int i=0; i<height; i++) {
+    row_pointers[height-i-1] = (png_bytep)&pixels[channels*i*width];
+  }
+
+  png_error_data error;
+
+  // PNG initializations
+
+  png_structp png_ptr = png_create_write_struct(
+      PNG_LIBPNG_VER_STRING, &error,
+      png_handler_error, png_handler_warning
+      );
+  if(!png_ptr) {
+    throw(Error("png_create_write struct failed"));
+  }
+
+  png_infop info_ptr = png_create_info_struct(png_ptr);
+  if(!info_ptr) {
+    png_destroy_write_struct(&png_ptr, (png_infopp)NULL);
+    throw(Error("png_create_info_struct failed"));
+  }
+
+  if(setjmp(png_jmpbuf(png_ptr))) {
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    throw(Error(error.msg));
+  }
+
+  png_init_io(png_ptr, fp);
+  if(level >= 0) {
+    png_set_compression_level(png_ptr, level);
+  }
+
+  png_set_IHDR(png_ptr, info_ptr, width, height, 8, PNG_COLOR_TYPE_RGB,
+      PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+      PNG_FILTER_TYPE_DEFAULT);
+  png_set_rows(png_ptr, info_ptr, row_pointers.get());
+
+  // Write data
+  png_write_png(png_ptr, info_ptr,
+                channels == 4 ? PNG_TRANSFORM_STRIP_FILLER_AFTER : PNG_TRANSFORM_IDENTITY,
+                NULL);
+  png_destroy_write_struct(&png_ptr, &info_ptr);
+}
+
+
+/** @brief Check a PNG path pattern
+ *
+ * The pattern must contain a single integer conversion, with optional
+ * flags and width.
+ */
+static bool check_png_pattern(const std::string& path)
+{
+  unsigned int conversions = 0;
+  for(size_t i=0; i<path.size(); i++) {
+    if(path[i] != '%') {
+      continue;
+    }
+    i++;
+    if(i < path.size() && path[i] == '%') {
+      continue;
+    }
+    while(i < path.size() && strchr("-+ #0123456789", path[i])) {
+      i++;
+    }
+    if(i >= path.size() || (path[i] != 'd' && path[i] != 'u')) {
+      return false;
+    }
+    conversions++;
+  }
+  return conversions == 1;
+}
+
+
+FrameCapture::FrameCapture(const std::string& path, Format format, float fps, unsigned int pool_size, bool drop):
+    path_(path), format_(format), fps_(fps), drop_(drop), closed_(false),
+    pbo_support_(-1), pbo_pending_(0), pbo_head_(0), pbo_width_(0), pbo_height_(0),
+    captured_(0), dropped_(0), written_(0), stop_(false), failed_(false),
+    stream_(NULL), stream_width_(0), stream_height_(0)
+{
+  if(pool_size == 0) {
+    throw(Error("capture pool size must not be null"));
+  }
+  if(fps <= 0) {
+    throw(Error("invalid capture frame rate"));
+  }
+  if(format_ == FORMAT_PNG) {
+    if(!check_png_pattern(path_)) {
+      throw(Error("invalid PNG capture pattern, expected a single integer conversion: '%s'", path_.c_str()));
+    }
+  } else {
+    stream_ = fopen(path_.c_str(), "wb");
+    if(!stream_) {
+      throw(Error("cannot open file '%s' for writing", path_.c_str()));
+    }
+  }
+
+  frames_.resize(pool_size);
+  for(auto& frame : frames_) {
+    frame.reset(new Frame());
+    free_frames_.push_back(frame.get());
+  }
+  encoder_ = std::thread(&FrameCapture::encoderMain, this);
+}
+
+FrameCapture::~FrameCapture()
+{
+  close();
+}
+
+
+void FrameCapture::close()
+{
+  if(closed_) {
+    return;
+  }
+  closed_ = true;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_queued_.notify_all();
+  encoder_.join();
+  if(stream_) {
+    fclose(stream_);
+    stream_ = NULL;
+  }
+}
+
+
+unsigned int FrameCapture::getCaptured() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return captured_;
+}
+
+unsigned int FrameCapture::getDropped() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dropped_;
+}
+
+unsigned int FrameCapture::getWritten() const
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  return written_;
+}
+
+
+void FrameCapture::readFrame(const Display* d, int width, int height)
+{
+  if(closed_) {
+    return;
+  }
+
+  if(pbo_support_ < 0) {
+    pbo_support_ = glproc::loadBuffers(d) && glproc::hasExtension("GL_ARB_pixel_buffer_object");
+    if(!pbo_support_) {
+      LOG("pixel buffer objects not supported, frames are captured synchronously");
+    }
+  }
+
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+  if(!pbo_support_) {
+    Frame* frame = acquireFrame();
+    if(frame) {
+      frame->width = width;
+      frame->height = height;
+      frame->pixels.resize(4*width*height);
+      glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &frame->pixels[0]);
+      submitFrame(frame);
+    }
+    return;
+  }
+
+  if(pbo_width_ != width || pbo_height_ != height) {
+    releaseGL();
+  }
+  if(pbo_width_ == 0) {
+    glproc::GenBuffers(PBO_COUNT, pbos_);
+    for(unsigned int i=0; i<PBO_COUNT; i++) {
+      glproc::BindBuffer(GL_PIXEL_PACK_BUFFER_ARB, pbos_[i]);
+      glproc::BufferData(GL_PIXEL_PACK_BUFFER_ARB, 4*width*height, NULL, GL_STREAM_READ_ARB);
+    }
+    glproc::BindBuffer(GL_PIXEL_PACK_BUFFER_ARB, 0);
+    pbo_width_ = width;
+    pbo_height_ = height;
+  }
+
+  // start the read, it completes asynchronously
+  glproc::BindBuffer(GL_PIXEL_PACK_BUFFER_ARB, pbos_[pbo_head_]);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glproc::BindBuffer(GL_PIXEL_PACK_BUFFER_ARB, 0);
+  pbo_head_ = (pbo_head_ + 1) % PBO_COUNT;
+  pbo_pending_++;
+
+  // collect the oldest read when all buffers are used
+  if(pbo_pending_ == PBO_COUNT) {
+    collectFrame();
+  }
+}
+
+
+void FrameCapture::releaseGL()
+{
+  if(pbo_width_ == 0) {
+    return;
+  }
+  while(pbo_pending_ > 0) {
+    collectFrame();
+  }
+  glproc::DeleteBuffers(PBO_COUNT, pbos_);
+  pbo_head_ = 0;
+  pbo_width_ = 0;
+  pbo_height_ = 0;
+}
+
+
+void FrameCapture::collectFrame()
+{
+  const unsigned int index = (pbo_head_ + PBO_COUNT - pbo_pending_) % PBO_COUNT;
+  pbo_pending_--;
+  Frame* frame = closed_ ? NULL : acquireFrame();
+  if(!frame) {
+    return;
+  }
+
+  const size_t size = 4*pbo_width_*pbo_height_;
+  glproc::BindBuffer(GL_PIXEL_PACK_BUFFER_ARB, pbos_[index]);
+  const void* data = glproc::MapBuffer(GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY_ARB);
+  if(data) {
+    frame->width = pbo_width_;
+    frame->height = pbo_height_;
+    frame->pixels.resize(size);
+    memcpy(&frame->pixels[0], data, size);
+    glproc::UnmapBuffer(GL_PIXEL_PACK_BUFFER_ARB);
+  }
+  glproc::BindBuffer(GL_PIXEL_PACK_BUFFER_ARB, 0);
+
+  if(data) {
+    submitFrame(frame);
+  } else {
+    LOG("cannot map pixel buffer object, frame dropped");
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_frames_.push_back(frame);
+    dropped_++;
+  }
+}
+
+
+FrameCapture::Frame* FrameCapture::acquireFrame()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  if(!drop_) {
+    cond_free_.wait(lock, [&]{ return !free_frames_.empty() || failed_; });
+  }
+  if(free_frames_.empty() || failed_) {
+    dropped_++;
+    return NULL;
+  }
+  Frame* frame = free_frames_.back();
+  free_frames_.pop_back();
+  return frame;
+}
+
+void FrameCapture::submitFrame(Frame* frame)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(frame);
+    captured_++;
+  }
+  cond_queued_.notify_one();
+}
+
+
+void FrameCapture::encoderMain()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  for(;;) {
+    cond_queued_.wait(lock, [&]{ return !queue_.empty() || stop_; });
+    if(queue_.empty()) {
+      break;  // stopped, all frames written
+    }
+    Frame* frame = queue_.front();
+    queue_.pop_front();
+    const bool failed = failed_;
+    lock.unlock();
+
+    bool ok = false;
+    if(!failed) {
+      try {
+        writeFrame(*frame);
+        ok = true;
+      } catch(const Error& e) {
+        LOG("capture stopped: %s", e.what());
+      }
+    }
+
+    lock.lock();
+    if(ok) {
+      written_++;
+    } else {
+      failed_ = true;
+      dropped_++;
+    }
+    free_frames_.push_back(frame);
+    cond_free_.notify_one();
+  }
+}
+
+
+void FrameCapture::writeFrame(const Frame& frame)
+{
+  const int w = frame.width;
+  const int h = frame.height;
+  const unsigned char* pixels = &frame.pixels[0];
+
+  if(format_ == FORMAT_PNG) {
+    // favor speed over size
+    writePNG(stringf(path_.c_str(), written_), w, h, pixels, 4, 1);
+    return;
+  }
+
+  if(stream_width_ == 0) {
+    stream_width_ = w;
+    stream_height_ = h;
+    if(format_ == FORMAT_Y4M) {
+      fprintf(stream_, "YUV4MPEG2 W%d H%d F%u:1000 Ip A1:1 C444\n",
+              w, h, (unsigned int)(fps_*1000 + 0.5));
+    }
+  } else if(w != stream_width_ || h != stream_height_) {
+    throw(Error("frame size changed during a stream capture"));
+  }
+
+  if(format_ == FORMAT_RAW) {
+    row_buffer_.resize(3*w);
+    for(int y=h-1; y>=0; y--) {
+      const unsigned char* src = pixels + 4*y*w;
+      for(int x=0; x<w; x++) {
+        row_buffer_[3*x+0] = src[4*x+0];
+        row_buffer_[3*x+1] = src[4*x+1];
+        row_buffer_[3*x+2] = src[4*x+2];
+      }
+      fwrite(&row_buffer_[0], 3, w, stream_);
+    }
+  } else {
+    // BT.601 conversion, planes written one after the other
+    fputs("FRAME\n", stream_);
+    row_buffer_.resize(w);
+    for(int plane=0; plane<3; plane++) {
+      for(int y=h-1; y>=0; y--) {
+        const unsigned char* src = pixels + 4*y*w;
+        for(int x=0; x<w; x++) {
+          const int r = src[4*x+0];
+          const int g = src[4*x+1];
+          const int b = src[4*x+2];
+          int v;
+          if(plane == 0) {
+            v = ((66*r + 129*g + 25*b + 128) >> 8) + 16;
+          } else if(plane == 1) {
+            v = ((-38*r - 74*g + 112*b + 128) >> 8) + 128;
+          } else {
+            v = ((112*r - 94*g - 18*b + 128) >> 8) + 128;
+          }
+          row_buffer_[x] = v;
+        }
+        fwrite(&row_buffer_[0], 1, w, stream_);
+      }
+    }
+  }
+  if(ferror(stream_)) {
+    throw(Error("cannot write to '%s'", path_.c_str()));
+  }
+}
+
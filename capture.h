@@ -0,0 +1,186 @@
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+///@file
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <SDL/SDL_opengl.h>
+#include "smart.h"
+
+class Display;
+
+
+/** @brief Write a PNG image
+ *
+ * @param filename  output file
+ * @param width  image width
+ * @param height  image height
+ * @param pixels  RGB or RGBA pixels, rows from bottom to top (OpenGL order)
+ * @param channels  3 for RGB, 4 for RGBA (alpha is not written)
+ * @param level  zlib compression level, -1 for default
+ */
+void writePNG(const std::string& filename, int width, int height, const unsigned char* pixels, unsigned int channels, int level=-1);
+
+
+/** @brief Asynchronous capture of displayed frames
+ *
+ * Frames are read back into pixel buffer objects: the read of a frame
+ * completes while the next ones are drawn, the render thread does not wait
+ * for the GPU. Frames are then copied into a pool of buffers and encoded by
+ * a background thread.
+ *
+ * When the pool is exhausted (the encoder is late), new frames are dropped,
+ * or the render thread waits if dropping is disabled.
+ *
+ * Pixel buffer objects are used if supported, frames are read synchronously
+ * otherwise.
+ *
+ * @sa Display::setCapture()
+ */
+class FrameCapture: public SmartObject
+{
+ public:
+  /// Output formats
+  enum Format {
+    FORMAT_PNG,  ///< numbered PNG files
+    FORMAT_Y4M,  ///< YUV4MPEG2 stream, 4:4:4
+    FORMAT_RAW,  ///< raw RGB24 stream, rows from top to bottom
+  };
+
+  /** @brief Start a capture
+   *
+   * For PNG, \e path is a printf-like pattern with a single integer
+   * conversion for the frame number (e.g. <tt>frame-%05d.png</tt>).
+   * For streams, it is the output file.
+   *
+   * @param path  output path
+   * @param format  output format
+   * @param fps  frame rate written in stream headers
+   * @param pool_size  number of frames waiting to be encoded
+   * @param drop  drop frames when the pool is exhausted, instead of waiting
+   */
+  FrameCapture(const std::string& path, Format format=FORMAT_PNG, float fps=60, unsigned int pool_size=8, bool drop=true);
+  /// Stop the capture, see close()
+  virtual ~FrameCapture();
+
+  Format getFormat() const { return format_; }
+  const std::string& getPath() const { return path_; }
+
+  /** @brief Stop the capture
+   *
+   * Wait for pending frames to be written, then stop the encoder thread.
+   * Frames captured afterwards are ignored.
+   *
+   * @note Frames still being read back by the display are lost. They are
+   * collected when the capture is removed from the display.
+   */
+  void close();
+  bool isClosed() const { return closed_; }
+
+  /** @name Statistics
+   */
+  //@{
+  /// Frames queued for encoding
+  unsigned int getCaptured() const;
+  /// Frames dropped because the pool was exhausted or after an error
+  unsigned int getDropped() const;
+  /// Frames written
+  unsigned int getWritten() const;
+  //@}
+
+  /** @name Display interface
+   *
+   * These methods are called by the display, with its context current.
+   */
+  //@{
+  /// Read the current frame
+  void readFrame(const Display* d, int width, int height);
+  /// Collect frames being read, release OpenGL resources
+  void releaseGL();
+  //@}
+
+ private:
+  /// Number of pixel buffer objects, frames are collected with this delay
+  static const unsigned int PBO_COUNT = 3;
+
+  struct Frame
+  {
+    int width;
+    int height;
+    /// RGBA pixels, OpenGL order
+    std::vector<unsigned char> pixels;
+  };
+
+  /** @brief Get a free frame from the pool
+   *
+   * @return \e NULL if the frame has to be dropped.
+   */
+  Frame* acquireFrame();
+  /// Queue a frame for encoding
+  void submitFrame(Frame* frame);
+  /// Collect the oldest frame being read
+  void collectFrame();
+
+  /// Encoder thread main loop
+  void encoderMain();
+  /// Write a frame, called by the encoder thread
+  void writeFrame(const Frame& frame);
+
+  const std::string path_;
+  const Format format_;
+  const float fps_;
+  const bool drop_;
+  bool closed_;
+
+  /** @name Pixel buffer objects, used by the render thread
+   */
+  //@{
+  /// -1 if unknown, 0 if not supported
+  int pbo_support_;
+  GLuint pbos_[PBO_COUNT];
+  /// Number of frames being read
+  unsigned int pbo_pending_;
+  /// Index of the next PBO to use
+  unsigned int pbo_head_;
+  int pbo_width_;
+  int pbo_height_;
+  //@}
+
+  /** @name Encoder thread data, protected by the mutex
+   */
+  //@{
+  std::vector<std::unique_ptr<Frame>> frames_;
+  std::vector<Frame*> free_frames_;
+  std::deque<Frame*> queue_;
+  unsigned int captured_;
+  unsigned int dropped_;
+  unsigned int written_;
+  bool stop_;
+  /// Set if writing failed
+  bool failed_;
+  mutable std::mutex mutex_;
+  /// Signaled when a frame is queued or on stop
+  std::condition_variable cond_queued_;
+  /// Signaled when a frame is released
+  std::condition_variable cond_free_;
+  //@}
+
+  /// Output stream, used by the encoder thread
+  FILE* stream_;
+  int stream_width_;
+  int stream_height_;
+  /// Conversion buffer, used by the encoder thread
+  std::vector<unsigned char> row_buffer_;
+
+  std::thread encoder_;
+};
+
+
+#endif
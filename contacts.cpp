@@ -0,0 +1,166 @@
+#include <algorithm>
+#include <functional>
+#include "contacts.h"
+
+
+typedef std::pair<const btCollisionObject*, const btCollisionObject*> PairKey;
+
+/// Return an order-independent key of an event pair
+static PairKey pair_key(const ContactEvent& ev)
+{
+  if(std::less<const btCollisionObject*>()(ev.body_b, ev.body_a)) {
+    return PairKey(ev.body_b, ev.body_a);
+  }
+  return PairKey(ev.body_a, ev.body_b);
+}
+
+/// Sort event indexes by pair key, then by index
+static void sort_by_key(const std::vector<ContactEvent>& events, std::vector<size_t>& order)
+{
+  order.resize(events.size());
+  for(size_t i=0; i<order.size(); i++) {
+    order[i] = i;
+  }
+  std::sort(order.begin(), order.end(), [&](size_t i, size_t j) {
+    const PairKey ki = pair_key(events[i]);
+    const PairKey kj = pair_key(events[j]);
+    if(ki != kj) {
+      return std::less<PairKey>()(ki, kj);
+    }
+    return i < j;
+  });
+}
+
+
+void ContactTracker::subscribe(const btCollisionObject* co, ContactListener* listener, unsigned int flags)
+{
+  Subscription& sub = subscriptions_[co];
+  sub.listener = listener;
+  sub.flags = flags;
+}
+
+void ContactTracker::unsubscribe(const btCollisionObject* co)
+{
+  subscriptions_.erase(co);
+  // keep pairs still tracked for the other body
+  pairs_.erase(std::remove_if(pairs_.begin(), pairs_.end(), [&](const ContactEvent& ev) {
+    return (ev.body_a == co || ev.body_b == co) &&
+        !isSubscribed(ev.body_a == co ? ev.body_b : ev.body_a);
+  }), pairs_.end());
+}
+
+
+void ContactTracker::update(btDispatcher* dispatcher)
+{
+  if(subscriptions_.empty() && pairs_.empty()) {
+    return;
+  }
+
+  // collect pairs, in manifold order
+  new_pairs_.clear();
+  const int nmanifolds = dispatcher->getNumManifolds();
+  for(int i=0; i<nmanifolds; i++) {
+    const btPersistentManifold* manifold = dispatcher->getManifoldByIndexInternal(i);
+    const int npoints = manifold->getNumContacts();
+    if(npoints == 0) {
+      continue;
+    }
+    const btCollisionObject* a = static_cast<const btCollisionObject*>(manifold->getBody0());
+    const btCollisionObject* b = static_cast<const btCollisionObject*>(manifold->getBody1());
+    if(!isSubscribed(a) && !isSubscribed(b)) {
+      continue;
+    }
+    ContactEvent ev;
+    ev.type = ContactEvent::BEGIN;
+    ev.body_a = a;
+    ev.body_b = b;
+    ev.impulse = 0;
+    for(int j=0; j<npoints; j++) {
+      const btManifoldPoint& pt = manifold->getContactPoint(j);
+      if(j == 0 || pt.getDistance() < ev.distance) {
+        ev.point = pt.getPositionWorldOnB();
+        ev.normal = pt.m_normalWorldOnB;
+        ev.distance = pt.getDistance();
+      }
+      ev.impulse += pt.getAppliedImpulse();
+    }
+    new_pairs_.push_back(ev);
+  }
+
+  // merge pairs with several manifolds (e.g. compound shapes) into the
+  // first one, merged pairs are marked with a null type
+  sort_by_key(new_pairs_, order_);
+  size_t head = 0;
+  for(size_t i=1; i<order_.size(); i++) {
+    ContactEvent& first = new_pairs_[order_[head]];
+    ContactEvent& ev = new_pairs_[order_[i]];
+    if(pair_key(first) != pair_key(ev)) {
+      head = i;
+      continue;
+    }
+    if(ev.distance < first.distance) {
+      // keep first's orientation
+      if(first.body_a != ev.body_a) {
+        first.point = ev.point + ev.normal * ev.distance;
+        first.normal = -ev.normal;
+      } else {
+        first.point = ev.point;
+        first.normal = ev.normal;
+      }
+      first.distance = ev.distance;
+    }
+    first.impulse += ev.impulse;
+    ev.type = (ContactEvent::Type)0;
+  }
+  new_pairs_.erase(std::remove_if(new_pairs_.begin(), new_pairs_.end(), [](const ContactEvent& ev) {
+    return ev.type == 0;
+  }), new_pairs_.end());
+
+  // match with previous pairs
+  events_.clear();
+  sort_by_key(pairs_, order_);
+  std::vector<bool> found(pairs_.size(), false);
+  for(auto& ev : new_pairs_) {
+    const PairKey key = pair_key(ev);
+    auto it = std::lower_bound(order_.begin(), order_.end(), key, [&](size_t i, const PairKey& k) {
+      return std::less<PairKey>()(pair_key(pairs_[i]), k);
+    });
+    if(it != order_.end() && pair_key(pairs_[*it]) == key) {
+      ev.type = ContactEvent::PERSIST;
+      found[*it] = true;
+    } else {
+      ev.type = ContactEvent::BEGIN;
+    }
+    events_.push_back(ev);
+  }
+  for(size_t i=0; i<pairs_.size(); i++) {
+    if(!found[i]) {
+      events_.push_back(pairs_[i]);
+      events_.back().type = ContactEvent::END;
+    }
+  }
+  pairs_.swap(new_pairs_);
+
+  // listeners may change subscriptions, state must be up-to-date
+  for(auto& ev : events_) {
+    emit(ev);
+  }
+}
+
+
+void ContactTracker::emit(const ContactEvent& ev) const
+{
+  ContactListener* listener_a = NULL;
+  auto it = subscriptions_.find(ev.body_a);
+  if(it != subscriptions_.end() && (it->second.flags & ev.type)) {
+    listener_a = it->second.listener;
+    listener_a->onContact(ev);
+  }
+  // subscriptions may have been modified by the listener
+  it = subscriptions_.find(ev.body_b);
+  if(it != subscriptions_.end() && (it->second.flags & ev.type) &&
+     it->second.listener != listener_a) {
+    it->second.listener->onContact(ev);
+  }
+}
+
@@ -0,0 +1,132 @@
+#ifndef CONTACTS_H_
+#define CONTACTS_H_
+
+///@file
+
+#include <vector>
+#include <unordered_map>
+#include "smart.h"
+
+
+/** @brief Contact event between two bodies
+ *
+ * Point and normal are those of the deepest contact point of the pair.
+ * For end events, they are those of the last tick with contacts.
+ */
+struct ContactEvent
+{
+  /// Event types, usable as flags
+  enum Type {
+    BEGIN = 1,  ///< bodies started touching
+    PERSIST = 2,  ///< bodies are still touching
+    END = 4,  ///< bodies stopped touching
+  };
+  static const unsigned int ALL = BEGIN|PERSIST|END;
+
+  Type type;
+  const btCollisionObject* body_a;
+  const btCollisionObject* body_b;
+  /// Contact point on \e body_b, in world coordinates
+  btVector3 point;
+  /// Contact normal on \e body_b
+  btVector3 normal;
+  /// Distance between bodies, negative when penetrating
+  btScalar distance;
+  /// Sum of the impulses applied at contact points
+  btScalar impulse;
+};
+
+
+/** @brief Contact event listener
+ *
+ * @sa ContactTracker::subscribe()
+ */
+class ContactListener
+{
+ public:
+  virtual ~ContactListener() {}
+  /** @brief Called on contact events of a subscribed body
+   *
+   * Events are emitted at the end of each simulation substep. The listener
+   * must not add or remove bodies from the world.
+   *
+   * @note Bodies of end events may have been removed from the world since
+   * the previous substep. They must not be dereferenced.
+   */
+  virtual void onContact(const ContactEvent& ev) = 0;
+};
+
+
+/** @brief Contact listener storing events
+ *
+ * Events are accumulated until cleared.
+ */
+class ContactQueue: public ContactListener
+{
+ public:
+  virtual void onContact(const ContactEvent& ev) { events_.push_back(ev); }
+  const std::vector<ContactEvent>& getEvents() const { return events_; }
+  void clear() { events_.clear(); }
+
+ private:
+  std::vector<ContactEvent> events_;
+};
+
+
+/** @brief Track contacts of subscribed bodies
+ *
+ * Persistent manifolds are walked once per tick to compute contact pairs.
+ * Pairs are compared to those of the previous tick to emit begin, persist
+ * and end events to listeners of subscribed bodies.
+ *
+ * Only pairs with at least one subscribed body are considered; there is
+ * no cost if no body is subscribed. Events are emitted in a deterministic
+ * order which does not depend on body addresses.
+ */
+class ContactTracker
+{
+ public:
+  ContactTracker() {}
+
+  /** @brief Subscribe to contact events of a body
+   *
+   * @param co  subscribed body
+   * @param listener  listener to call
+   * @param flags  ContactEvent::Type values of events to emit
+   *
+   * A body has at most one listener, subscribing again replaces it.
+   */
+  void subscribe(const btCollisionObject* co, ContactListener* listener, unsigned int flags=ContactEvent::ALL);
+  /** @brief Unsubscribe a body
+   *
+   * Pairs of the body are forgotten, no end event is emitted.
+   */
+  void unsubscribe(const btCollisionObject* co);
+  bool isSubscribed(const btCollisionObject* co) const { return subscriptions_.count(co) != 0; }
+
+  /// Walk manifolds, emit events
+  void update(btDispatcher* dispatcher);
+  /// Forget current pairs without emitting events
+  void reset() { pairs_.clear(); }
+
+ private:
+  struct Subscription
+  {
+    ContactListener* listener;
+    unsigned int flags;
+  };
+
+  /// Emit an event to listeners of its bodies
+  void emit(const ContactEvent& ev) const;
+
+  std::unordered_map<const btCollisionObject*, Subscription> subscriptions_;
+  /// Pairs of the previous tick, in emission order
+  std::vector<ContactEvent> pairs_;
+  /// Buffers kept to avoid reallocations
+  std::vector<ContactEvent> new_pairs_;
+  std::vector<ContactEvent> events_;
+  std::vector<size_t> order_;
+};
+
+
+#endif
@@ -3,33 +3,75 @@
 #include <cstdio>
 #include <exception>
 #include <memory>
+#include <algorithm>
 #include <SDL/SDL_opengl.h>
-#include <png.h>
+#ifdef SIMULOTTER_OSMESA
+#include <GL/osmesa.h>
+#endif
 #include "display.h"
 #include "physics.h"
 #include "object.h"
+#include "glproc.h"
 #include "log.h"
 #include "icon.h"
 
 
+std::atomic<unsigned int> OSDMessage::next_version_(0);
+
 btScalar Display::draw_epsilon = 0.0005_m;
 unsigned int Display::draw_div = 20;
 unsigned int Display::antialias = 0;
+unsigned int Display::lod_levels = 3;
+float Display::lod_size = 64;
+
+/// Displays with a window, for releaseKey()
+struct DisplayRegistry
+{
+  std::mutex mutex;
+  std::set<Display*> displays;
+};
+
+/** @brief Get the display registry
+ *
+ * Never destroyed: static shapes may be released after static destruction.
+ */
+static DisplayRegistry& display_registry()
+{
+  static DisplayRegistry* registry = new DisplayRegistry();
+  return *registry;
+}
 
 
-Display::Display():
+Display::Display(bool offscreen):
   time_scale_(1.0), fps_(60.0),
-  paused_(false),
+  paused_(false), threaded_(false),
+  fast_(false), fast_fps_(10.0), max_steps_per_frame_(50),
   bg_color_(Color4(0.8)),
+  osd_rate_(10.0),
   camera_step_linear_(0.1_m),
   camera_mouse_coef_(0.01),
   screen_x_(800), screen_y_(600),
   fullscreen_(false),
-  is_running_(false)
+  is_running_(false),
+  offscreen_(offscreen), offscreen_ctx_(NULL),
+  buffer_objects_(false), dirty_(true),
+  lod_scale_(0), ordered_instances_(true), drawing_last_(false),
+  mesh_size_(0), mesh_budget_(64<<20), frame_(0),
+  released_count_(0), evicted_count_(0),
+  world_wanted_(false), physics_stop_(false), snapshot_wanted_(false),
+  snapshot_front_(0), snapshot_pending_(1), snapshot_back_(2),
+  snapshot_new_(false), draw_snapshot_(NULL)
 {
-  int argc = 1;
-  glutInit(&argc, NULL);
-
+#ifdef SIMULOTTER_OSMESA
+  // GL functions are provided by OSMesa, they cannot draw in a window
+  if(!offscreen_) {
+    throw(Error("windowed display not available, built for offscreen rendering"));
+  }
+#else
+  if(offscreen_) {
+    throw(Error("offscreen display not available"));
+  }
+#endif
   screen_ = NULL;
 
   handlerCamReset(this, NULL);
@@ -50,7 +92,7 @@ void Display::resize(int width, int height, int mode)
   }
 
   bool fullscreen;
-  if(mode == 0) {
+  if(offscreen_ || mode == 0) {
     fullscreen = false;
   } else if(mode > 0) {
     fullscreen = true;
@@ -61,15 +103,35 @@ void Display::resize(int width, int height, int mode)
   Uint32 flags = SDL_OPENGL;
   flags |= fullscreen ? SDL_FULLSCREEN : SDL_RESIZABLE;
 
-  // Delete display lists.
+  // Delete display lists, mesh and capture buffers.
   // On Windows setting the video mode resets the current OpenGL context.
   // We always reset display lists, it's safer.
+  if(capture_) {
+    capture_->releaseGL();
+  }
+  collectResources();
+  for(auto& entry : mesh_list_) {
+    entry.mesh->releaseGL();
+  }
+  instances_.releaseGL();
+  ordered_instances_.releaseGL();
+  text_.releaseGL();
   for(auto& it : display_lists_) {
     glDeleteLists(it.second, 1);
   }
   display_lists_.clear();
 
-  if(!(screen_ = SDL_SetVideoMode(width, height, 0, flags))) {
+  if(offscreen_) {
+#ifdef SIMULOTTER_OSMESA
+    // keep the previous buffer until the new one is bound
+    std::unique_ptr<unsigned char[]> buffer(new unsigned char[4*width*height]);
+    if(!OSMesaMakeCurrent(offscreen_ctx_, buffer.get(), GL_UNSIGNED_BYTE, width, height)) {
+      windowDestroy();
+      throw(Error("OSMesa: cannot bind context"));
+    }
+    offscreen_buffer_.swap(buffer);
+#endif
+  } else if(!(screen_ = SDL_SetVideoMode(width, height, 0, flags))) {
     windowDestroy();
     throw(Error("SDL: cannot change video mode"));
   }
@@ -78,7 +140,14 @@ void Display::resize(int width, int height, int mode)
   screen_y_ = height;
   fullscreen_ = fullscreen;
 
+  {
+    // resources may now be cached, keys must be queued
+    DisplayRegistry& registry = display_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.displays.insert(this);
+  }
   sceneInit();
+  dirty_ = true;
 }
 
 void Display::update()
@@ -90,6 +159,9 @@ void Display::update()
   if(!windowInitialized()) {
     resize(screen_x_, screen_y_, fullscreen_);
   }
+  frame_++;
+  dirty_ = false;
+  collectResources();
 
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -101,14 +173,10 @@ void Display::update()
   glMatrixMode(GL_MODELVIEW);
   glLoadIdentity();
 
+  const btTransform tr = getCameraTrans();
+  drawn_camera_ = DrawnCamera{tr, camera_.fov, camera_.z_near, camera_.z_far};
   {
     btScalar m[16];
-    btTransform tr;
-    if(!camera_.obj) {
-      tr = camera_.trans;
-    } else {
-      tr = camera_.obj->getTrans() * camera_.trans;
-    }
     tr.getOpenGLMatrix(m);
     m[12] = m[13] = m[14] = 0;  // no translation yet
     btglMultMatrix(m);
@@ -120,13 +188,13 @@ void Display::update()
   glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
   // Draw objects
-  const std::set<SmartPtr<Object>>& objs = physics_->getObjs();
-  for(auto& obj : objs) {
-    obj->draw(this);
-  }
-  for(auto& obj : objs) {
-    obj->drawLast(this);
+  setupFrustum(tr);
+  if(draw_snapshot_) {
+    drawObjects(draw_snapshot_->objs, tr);
+  } else {
+    drawObjects(physics_->getObjs(), tr);
   }
+  evictMeshes();
 
   glMatrixMode(GL_PROJECTION);
   glLoadIdentity();
@@ -135,13 +203,136 @@ void Display::update()
   glMatrixMode(GL_MODELVIEW);
   glLoadIdentity();
   // OSD
-  glDisable(GL_LIGHTING);
-  for(auto& osd : osds_) {
-    drawString(osd->getText(), osd->getX(), osd->getY(), osd->getColor(), GLUT_BITMAP_8_BY_13);
+  if(draw_snapshot_) {
+    for(auto& osd : draw_snapshot_->osds) {
+      drawText(osd.text, osd.x, osd.y, osd.color);
+    }
+  } else {
+    refreshOSDTexts();
+    for(auto& it : osd_texts_) {
+      const OSDText& osd = it.second;
+      drawText(osd.text, osd.x, osd.y, osd.color);
+    }
+  }
+  text_.flush();
+
+  if(capture_) {
+    capture_->readFrame(this, screen_x_, screen_y_);
+  }
+
+  if(offscreen_) {
+    // there is no buffer swap, wait for rendering to complete
+    glFinish();
+  } else {
+    SDL_GL_SwapBuffers();
+  }
+}
+
+btTransform Display::getCameraTrans() const
+{
+  if(!camera_.obj) {
+    return camera_.trans;
+  } else if(!draw_snapshot_) {
+    return camera_.obj->getTrans() * camera_.trans;
+  } else if(draw_snapshot_->camera_obj == camera_.obj) {
+    return draw_snapshot_->camera_trans * camera_.trans;
+  }
+  // camera object changed since the snapshot, the world may be stepped
+  const btCollisionObject* body = camera_.obj->getMainBody();
+  if(body) {
+    return getDrawTrans(body) * camera_.trans;
+  }
+  // keep the previous camera until the next snapshot
+  if(draw_snapshot_->camera_obj) {
+    return draw_snapshot_->camera_trans * camera_.trans;
+  }
+  return camera_.trans;
+}
+
+template <class C> void Display::drawObjects(const C& objs, const btTransform& camera)
+{
+  // the view matrix is the camera basis, axes are its rows
+  const btVector3 axis = -camera.getBasis().getRow(2);
+  opaque_queue_.clear();
+  transparent_queue_.clear();
+  btVector3 aabb_min, aabb_max;
+  for(auto& obj : objs) {
+    if(obj->getDrawAabb(this, aabb_min, aabb_max) && isCulled(aabb_min, aabb_max)) {
+      continue;
+    }
+    const btCollisionObject* body = obj->getMainBody();
+    RenderItem item{obj, typeid(*obj), body ? body->getCollisionShape() : NULL, 0};
+    opaque_queue_.push_back(item);
+    if(obj->isTransparent()) {
+      const btVector3 pos = body ? getDrawTrans(body).getOrigin() : obj->getPos();
+      item.depth = axis.dot(pos - camera.getOrigin());
+      transparent_queue_.push_back(item);
+    }
+  }
+
+  std::sort(opaque_queue_.begin(), opaque_queue_.end(),
+            [](const RenderItem& a, const RenderItem& b) {
+              return a.type != b.type ? a.type < b.type : a.shape < b.shape;
+            });
+  for(auto& item : opaque_queue_) {
+    item.obj->draw(this);
+  }
+  instances_.flush(this);
+
+  // farthest first
+  std::sort(transparent_queue_.begin(), transparent_queue_.end(),
+            [](const RenderItem& a, const RenderItem& b) { return a.depth > b.depth; });
+  drawing_last_ = true;
+  for(size_t i=0; i<transparent_queue_.size(); i++) {
+    const RenderItem& item = transparent_queue_[i];
+    // objects may also draw directly, keep the order of instances
+    if(i > 0 && (item.type != transparent_queue_[i-1].type || item.shape != transparent_queue_[i-1].shape)) {
+      ordered_instances_.flush(this);
+    }
+    item.obj->drawLast(this);
+  }
+  ordered_instances_.flush(this);
+  drawing_last_ = false;
+}
+
+void Display::setupFrustum(const btTransform& camera)
+{
+  // camera space planes: the camera looks along -z
+  const btScalar tan_v = btTan(camera_.fov*M_PI/360);
+  const btScalar tan_h = tan_v * screen_x_ / screen_y_;
+  const btVector3 normals[6] = {
+    btVector3(0, 0, -1), btVector3(0, 0, 1),
+    btVector3(1, 0, -tan_h).normalized(), btVector3(-1, 0, -tan_h).normalized(),
+    btVector3(0, 1, -tan_v).normalized(), btVector3(0, -1, -tan_v).normalized(),
+  };
+  const btScalar dists[6] = { -camera_.z_near, camera_.z_far, 0, 0, 0, 0 };
+
+  // the view matrix is the camera basis, its transpose brings planes back to
+  // world space
+  const btMatrix3x3 basis = camera.getBasis().transpose();
+  const btVector3& origin = camera.getOrigin();
+  for(int i=0; i<6; i++) {
+    frustum_normals_[i] = basis * normals[i];
+    frustum_dists_[i] = dists[i] - frustum_normals_[i].dot(origin);
   }
-  glEnable(GL_LIGHTING);
 
-  SDL_GL_SwapBuffers();
+  lod_origin_ = origin;
+  lod_scale_ = screen_y_ / (2*tan_v);
+}
+
+bool Display::isCulled(const btVector3& aabb_min, const btVector3& aabb_max) const
+{
+  for(int i=0; i<6; i++) {
+    const btVector3& n = frustum_normals_[i];
+    // AABB corner the farthest along the normal
+    const btVector3 p(n.x() > 0 ? aabb_max.x() : aabb_min.x(),
+                      n.y() > 0 ? aabb_max.y() : aabb_min.y(),
+                      n.z() > 0 ? aabb_max.z() : aabb_min.z());
+    if(n.dot(p) + frustum_dists_[i] < 0) {
+      return true;
+    }
+  }
+  return false;
 }
 
 void Display::close()
@@ -185,6 +376,86 @@ void Display::Camera::mouseMove(btScalar x, btScalar y)
 /// Internal exception class to abort
 class AbortException: public std::exception {};
 
+typedef std::chrono::duration<double> Seconds;
+
+/// Convert seconds to a clock duration
+static Display::Clock::duration toDuration(double seconds)
+{
+  return std::chrono::duration_cast<Display::Clock::duration>(Seconds(seconds));
+}
+
+/// Throw an error if the time scale would stall or break run() timings
+static void checkTimeScale(float time_scale)
+{
+  if(!(time_scale > 0)) {
+    throw(Error("invalid time scale: %f", time_scale));
+  }
+}
+
+/** @brief Return \e true if steps may have changed drawn objects
+ *
+ * @param physics  stepped world
+ * @param revision  world revision last checked, updated
+ */
+static bool isWorldMoving(Physics* physics, uint64_t& revision)
+{
+  // objects added or removed, tasks executed
+  if(physics->getRevision() != revision) {
+    revision = physics->getRevision();
+    return true;
+  }
+  // tick callbacks may change anything
+  if(!physics->getTickObjs().empty()) {
+    return true;
+  }
+  const btCollisionObjectArray& bodies = physics->getWorld()->getCollisionObjectArray();
+  for(int i=0; i<bodies.size(); i++) {
+    if(!bodies[i]->isStaticObject() && bodies[i]->isActive()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+bool Display::needsRedraw()
+{
+  // OSD texts of threaded runs come with snapshots
+  const bool osd_changed = !draw_snapshot_ && refreshOSDTexts();
+  if(dirty_ || osd_changed || capture_) {
+    return true;
+  }
+  const DrawnCamera& drawn = drawn_camera_;
+  return !(getCameraTrans() == drawn.trans) || camera_.fov != drawn.fov ||
+      camera_.z_near != drawn.z_near || camera_.z_far != drawn.z_far;
+}
+
+void Display::waitEvents(const Clock::time_point& until) const
+{
+  if(offscreen_) {
+    std::this_thread::sleep_until(until);
+    return;
+  }
+  // same loop as SDL_WaitEvent()
+  SDL_Event event;
+  for(;;) {
+    SDL_PumpEvents();
+    if(SDL_PeepEvents(&event, 1, SDL_PEEKEVENT, SDL_ALLEVENTS) != 0) {
+      return;
+    }
+    const Clock::time_point time = Clock::now();
+    if(time >= until) {
+      return;
+    }
+    std::this_thread::sleep_until(std::min(until, time + std::chrono::milliseconds(10)));
+  }
+}
+
+Display::Clock::duration Display::getIdleDelay() const
+{
+  return toDuration(osd_rate_ > 0 ? 1.0/osd_rate_ : 1.0);
+}
+
 
 void Display::run()
 {
@@ -199,32 +470,14 @@ void Display::run()
     resize(screen_x_, screen_y_, fullscreen_);
   }
 
-  unsigned int step_dt = (unsigned int)(1000.0*physics_->getStepDt());
-  unsigned long time;
-  unsigned long time_last_disp, time_step;
-  signed long time_wait;
-
+  run_stats_ = RunStats();
+  dirty_ = true;
   try {
     is_running_ = true;
-    time_last_disp = time_step = SDL_GetTicks();
-    for(;;) {
-      time = SDL_GetTicks();
-      while(time >= time_step) {
-        if(!paused_) {
-          physics_->step();
-        }
-        time_step += (unsigned long)(step_dt * time_scale_);
-      }
-      if(time - time_last_disp >= 1000.0/fps_) {
-        processEvents();
-        update();
-        time_last_disp = time;
-      }
-
-      time_wait = MIN(time_step-time, 1000.0/fps_);
-      if(time_wait > 0) {
-        SDL_Delay(time_wait);
-      }
+    if(threaded_) {
+      runThreaded();
+    } else {
+      runSingle();
     }
   } catch(const AbortException&) {
     is_running_ = false;
@@ -234,6 +487,99 @@ void Display::run()
   }
 }
 
+void Display::runSingle()
+{
+  const double step_dt = physics_->getStepDt();
+  // simulated time to step
+  double accumulator = 0;
+  unsigned int frame_steps = 0;
+  uint64_t revision = physics_->getRevision();
+  Clock::time_point time_last = Clock::now();
+  Clock::time_point time_disp = time_last;
+
+  for(;;) {
+    Clock::time_point time = Clock::now();
+    bool display = time >= time_disp;
+    bool capped = false;
+
+    if(paused_) {
+      accumulator = 0;
+    } else if(fast_) {
+      // ignore wall-clock, step until next frame
+      while(time < time_disp) {
+        physics_->step();
+        run_stats_.steps++;
+        frame_steps++;
+        time = Clock::now();
+      }
+      display = true;
+    } else {
+      checkTimeScale(time_scale_);
+      accumulator += Seconds(time - time_last).count() / time_scale_;
+      while(accumulator >= step_dt) {
+        if(max_steps_per_frame_ > 0 && frame_steps >= max_steps_per_frame_) {
+          // too slow, drop remaining time and display now
+          reportBehind(accumulator);
+          accumulator = 0;
+          display = capped = true;
+          break;
+        }
+        physics_->step();
+        run_stats_.steps++;
+        frame_steps++;
+        accumulator -= step_dt;
+      }
+    }
+    time_last = time;
+
+    if(display) {
+      if(!capped) {
+        run_stats_.behind = false;
+      }
+      processEvents();
+      if(frame_steps > 0 && isWorldMoving(physics_, revision)) {
+        dirty_ = true;
+      }
+      if(needsRedraw()) {
+        update();
+        run_stats_.frames++;
+      } else {
+        run_stats_.idle_frames++;
+      }
+      frame_steps = 0;
+      time_disp += toDuration(1.0/(fast_ ? fast_fps_ : fps_));
+      time = Clock::now();
+      if(time_disp < time) {
+        time_disp = time;  // late, don't try to catch up
+      }
+    }
+
+    if(paused_ && !dirty_ && !capture_) {
+      // idle, wait for events at most until the next change check
+      std::this_thread::sleep_until(time_disp);
+      waitEvents(time_disp + getIdleDelay());
+      time_disp = Clock::now();
+      continue;
+    }
+
+    // wait for next step or next frame
+    Clock::time_point time_wait = time_disp;
+    if(!paused_ && !fast_) {
+      time_wait = std::min(time_wait, time + toDuration((step_dt - accumulator) * time_scale_));
+    }
+    std::this_thread::sleep_until(time_wait);
+  }
+}
+
+void Display::reportBehind(double skipped)
+{
+  run_stats_.skipped += skipped;
+  if(!run_stats_.behind) {
+    LOG("simulation is behind real time, %g s skipped", skipped);
+    run_stats_.behind = true;
+  }
+}
+
 void Display::abort() const
 {
   if(!is_running_) {
@@ -243,109 +589,316 @@ void Display::abort() const
 }
 
 
-/** @name PNG related declarations
- */
-//@{
+void Display::runThreaded()
+{
+  // initial snapshot, the physics thread is not started yet
+  refreshOSDTexts();
+  captureSnapshot(snapshots_[snapshot_front_]);
+  draw_snapshot_ = &snapshots_[snapshot_front_];
+  snapshot_new_ = false;
+  snapshot_wanted_ = false;
+  physics_error_ = nullptr;
+  physics_stop_ = false;
+  physics_thread_ = std::thread(&Display::physicsMain, this);
 
-#define PNG_ERROR_SIZE  256
+  try {
+    Clock::time_point time_disp = Clock::now();
+    for(;;) {
+      {
+        world_wanted_ = true;
+        std::lock_guard<std::mutex> lock(world_mutex_);
+        world_wanted_ = false;
+        processEvents();
+        if(dirty_) {
+          // handlers may have modified the world, even if paused
+          snapshot_wanted_ = true;
+        }
+      }
+      if(snapshot_wanted_) {
+        physics_cv_.notify_one();
+      }
+      // read before acquiring, the flag is reset after publishing
+      const bool snapshot_waited = snapshot_wanted_;
+      if(acquireSnapshot()) {
+        dirty_ = true;
+      }
+      if(needsRedraw()) {
+        update();
+        run_stats_.frames++;
+      } else {
+        run_stats_.idle_frames++;
+      }
 
-typedef struct
+      time_disp += toDuration(1.0/(fast_ ? fast_fps_ : fps_));
+      const Clock::time_point time = Clock::now();
+      if(time < time_disp) {
+        std::this_thread::sleep_until(time_disp);
+      } else {
+        time_disp = time;  // late, don't try to catch up
+      }
+      if(paused_ && !snapshot_waited && !dirty_ && !capture_) {
+        // idle, wait for events at most until the next change check
+        waitEvents(time_disp + getIdleDelay());
+        time_disp = Clock::now();
+      }
+    }
+  } catch(...) {
+    stopPhysicsThread();
+    throw;
+  }
+}
+
+void Display::physicsMain()
 {
-  char msg[PNG_ERROR_SIZE];
-} png_error_data;
+  // publish only if what is drawn may have changed
+  uint64_t revision = physics_->getRevision();
+  auto publish = [this,&revision](bool stepped) {
+    const bool osd_changed = refreshOSDTexts();
+    if(snapshot_wanted_ || osd_changed || (stepped && isWorldMoving(physics_, revision))) {
+      publishSnapshot();
+      snapshot_wanted_ = false;
+    }
+  };
 
+  try {
+    const double step_dt = physics_->getStepDt();
+    Clock::time_point time_step = Clock::now();
+    for(;;) {
+      Clock::time_point time;
+      {
+        std::unique_lock<std::mutex> lock(world_mutex_);
+        if(physics_stop_) {
+          break;
+        }
+        time = Clock::now();
+        if(paused_) {
+          publish(false);
+          // wait for the display, or for the next change check
+          physics_cv_.wait_for(lock, getIdleDelay(), [this]() {
+            return physics_stop_ || !paused_ || snapshot_wanted_;
+          });
+          time_step = Clock::now();
+          continue;
+        } else if(fast_) {
+          physics_->step();
+          run_stats_.steps++;
+          time_step = time;
+          publish(true);
+        } else if(time >= time_step) {
+          checkTimeScale(time_scale_);
+          physics_->step();
+          run_stats_.steps++;
+          time_step += toDuration(step_dt * time_scale_);
+          // too slow, drop time late by more than a frame of steps
+          const double late = Seconds(time - time_step).count() / time_scale_;
+          if(max_steps_per_frame_ > 0 && late > max_steps_per_frame_ * step_dt) {
+            reportBehind(late);
+            time_step = time;
+          } else if(late <= 0) {
+            run_stats_.behind = false;
+          }
+          publish(true);
+        }
+      }
+      if(time_step > time) {
+        std::this_thread::sleep_until(time_step);
+      } else {
+        // let the display lock the world
+        while(world_wanted_ && !physics_stop_) {
+          std::this_thread::yield();
+        }
+      }
+    }
+  } catch(...) {
+    std::lock_guard<std::mutex> lock(snapshot_mutex_);
+    physics_error_ = std::current_exception();
+  }
+}
 
-static void png_handler_error(png_struct* png_ptr, const char* msg)
+void Display::captureSnapshot(Snapshot& snap)
 {
-  png_error_data* error = (png_error_data*)png_get_error_ptr(png_ptr);
-  strncpy(error->msg, msg, PNG_ERROR_SIZE);
-  error->msg[PNG_ERROR_SIZE-1] = '\0';
-  longjmp(png_jmpbuf(png_ptr), 1);
+  // previous references are released by the thread holding the world
+  const ObjectRegistry& objs = physics_->getObjs();
+  snap.objs.assign(objs.begin(), objs.end());
+
+  const btCollisionObjectArray& bodies = physics_->getWorld()->getCollisionObjectArray();
+  snap.bodies.clear();
+  for(int i=0; i<bodies.size(); i++) {
+    snap.bodies.push_back(std::make_pair(bodies[i], bodies[i]->getWorldTransform()));
+  }
+  std::sort(snap.bodies.begin(), snap.bodies.end(),
+            [](const std::pair<const btCollisionObject*, btTransform>& a,
+               const std::pair<const btCollisionObject*, btTransform>& b) {
+              return a.first < b.first;
+            });
+
+  snap.osds.clear();
+  for(auto& it : osd_texts_) {
+    snap.osds.push_back(it.second);
+  }
+
+  snap.camera_obj = camera_.obj;
+  if(camera_.obj) {
+    snap.camera_trans = camera_.obj->getTrans();
+  }
 }
 
-static void png_handler_warning(png_struct* /*png_ptr*/, const char* msg)
+void Display::publishSnapshot()
 {
-  LOG("PNG: warning: %s", msg);
+  captureSnapshot(snapshots_[snapshot_back_]);
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  std::swap(snapshot_back_, snapshot_pending_);
+  snapshot_new_ = true;
 }
 
-//@}
+bool Display::acquireSnapshot()
+{
+  std::lock_guard<std::mutex> lock(snapshot_mutex_);
+  if(physics_error_) {
+    std::rethrow_exception(physics_error_);
+  }
+  draw_snapshot_ = &snapshots_[snapshot_front_];
+  if(!snapshot_new_) {
+    return false;
+  }
+  std::swap(snapshot_front_, snapshot_pending_);
+  snapshot_new_ = false;
+  draw_snapshot_ = &snapshots_[snapshot_front_];
+  return true;
+}
 
-void Display::savePNGScreenshot(const std::string& filename)
+void Display::stopPhysicsThread()
 {
-  if(!screen_) {
-    throw(Error("display not opened"));
+  {
+    // the paused physics thread checks it before waiting
+    std::lock_guard<std::mutex> lock(world_mutex_);
+    physics_stop_ = true;
   }
+  physics_cv_.notify_one();
+  physics_thread_.join();
+  draw_snapshot_ = NULL;
+  physics_error_ = nullptr;
+  // release object references
+  for(auto& snap : snapshots_) {
+    snap.objs.clear();
+    snap.bodies.clear();
+    snap.osds.clear();
+  }
+}
 
-  try {
-    // Open output file
-    FILE* fp = fopen(filename.c_str(), "wb");
-    if(!fp) {
-      throw(Error("cannot open file '%s' for writing", filename.c_str()));
+const btTransform& Display::getDrawTrans(const btCollisionObject* o) const
+{
+  if(draw_snapshot_) {
+    auto& bodies = draw_snapshot_->bodies;
+    auto it = std::lower_bound(bodies.begin(), bodies.end(), o,
+                               [](const std::pair<const btCollisionObject*, btTransform>& a,
+                                  const btCollisionObject* b) {
+                                 return a.first < b;
+                               });
+    if(it != bodies.end() && it->first == o) {
+      return it->second;
     }
-    auto fp_deleter = [](FILE* fp) { fclose(fp); };
-    std::unique_ptr<FILE, decltype(fp_deleter)> fp_safe(fp, fp_deleter);
-
-    png_error_data error;
-
-    // PNG initializations
+  }
+  return o->getWorldTransform();
+}
 
-    png_structp png_ptr = png_create_write_struct(
-        PNG_LIBPNG_VER_STRING, &error,
-        png_handler_error, png_handler_warning
-        );
-    if(!png_ptr) {
-      throw(Error("png_create_write struct failed"));
-    }
 
-    png_infop info_ptr = png_create_info_struct(png_ptr);
-    if(!info_ptr) {
-      png_destroy_write_struct(&png_ptr, (png_infopp)NULL);
-      throw(Error("png_create_info_struct failed"));
-    }
+void Display::savePNGScreenshot(const std::string& filename)
+{
+  if(offscreen_ ? !offscreen_ctx_ : !screen_) {
+    throw(Error("display not opened"));
+  }
 
-    if(setjmp(png_jmpbuf(png_ptr))) {
-      png_destroy_write_struct(&png_ptr, &info_ptr);
-      throw(Error(error.msg));
+  try {
+    // Get pixels
+    glFlush();
+    if(offscreen_) {
+      glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    } else {
+      SDL_LockSurface(screen_);
+      glPixelStorei(GL_PACK_ALIGNMENT, 1);
+      SDL_UnlockSurface(screen_);
     }
 
-    png_init_io(png_ptr, fp);
+    std::unique_ptr<unsigned char[]> pixels(new unsigned char[3*screen_x_*screen_y_]);
+    glReadPixels(0, 0, screen_x_, screen_y_, GL_RGB, GL_UNSIGNED_BYTE, pixels.get());
+    writePNG(filename, screen_x_, screen_y_, pixels.get(), 3);
 
-    png_set_IHDR(png_ptr, info_ptr, screen_x_, screen_y_, 8, PNG_COLOR_TYPE_RGB,
-        PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
-        PNG_FILTER_TYPE_DEFAULT);
+  } catch(const Error& e) {
+    throw(Error("SDL: cannot save screenshot: %s", e.what()));
+  }
+}
 
-    // Get pixels, create pixel rows
-    glFlush();
-    SDL_LockSurface(screen_);
-    glPixelStorei(GL_PACK_ALIGNMENT, 1);
-    SDL_UnlockSurface(screen_);
 
-    std::unique_ptr<unsigned char[]> pixels(new unsigned char[4*screen_x_*screen_y_]);
-    glReadPixels(0, 0, screen_x_, screen_y_, GL_RGB, GL_UNSIGNED_BYTE, pixels.get());
-    std::unique_ptr<png_bytep[]> row_pointers(new png_bytep[screen_y_]);
-    for(int i=0; i<screen_y_; i++) {
-      row_pointers[screen_y_-i-1] = (png_bytep)&pixels[3*i*screen_x_];
-    }
-    png_set_rows(png_ptr, info_ptr, row_pointers.get());
+void Display::setCapture(FrameCapture* capture)
+{
+  // pending frames are read with the current context
+  if(capture_ && windowInitialized()) {
+    capture_->releaseGL();
+  }
+  capture_ = capture;
+}
 
-    // Write data
-    png_write_png(png_ptr, info_ptr, PNG_TRANSFORM_IDENTITY, NULL);
-    png_destroy_write_struct(&png_ptr, &info_ptr);
 
-  } catch(const Error& e) {
-    throw(Error("SDL: cannot save screenshot: %s", e.what()));
+void* Display::getProcAddress(const char* name) const
+{
+#ifdef SIMULOTTER_OSMESA
+  if(offscreen_) {
+    return reinterpret_cast<void*>(OSMesaGetProcAddress(name));
   }
+#endif
+  return SDL_GL_GetProcAddress(name);
 }
 
 
-void Display::drawString(const std::string& s, int x, int y, Color4 color, void* font)
+void Display::drawText(const std::string& s, int x, int y, const Color4& color)
+{
+  text_.add(s, x, screen_y_ - y, color);
+}
+
+bool Display::refreshOSDTexts()
 {
-  y = screen_y_ - y;
-  glColor4fv(color);
-  glRasterPos2f(x,y);
-  for(unsigned int i=0; i<s.size(); i++) {
-    glutBitmapCharacter(font, s[i]);
+  const Clock::time_point time = Clock::now();
+  const bool refresh = osd_rate_ > 0 && time >= osd_refresh_time_;
+  if(refresh) {
+    osd_refresh_time_ = time + toDuration(1.0/osd_rate_);
+  }
+
+  bool changed = false;
+  // both containers are sorted by address
+  auto it = osd_texts_.begin();
+  for(auto& osd : osds_) {
+    while(it != osd_texts_.end() && it->first < osd.get()) {
+      it = osd_texts_.erase(it);  // removed message
+      changed = true;
+    }
+    const bool added = it == osd_texts_.end() || it->first != osd.get();
+    if(added) {
+      it = osd_texts_.emplace_hint(it, osd.get(), OSDText());
+    }
+    OSDText& text = it->second;
+    if(added || refresh || text.version != osd->getVersion()) {
+      const std::string s = osd->getText();
+      const int x = osd->getX();
+      const int y = osd->getY();
+      const Color4 color = osd->getColor();
+      if(added || s != text.text || x != text.x || y != text.y ||
+         !std::equal((const GLfloat*)color, (const GLfloat*)color+4, (const GLfloat*)text.color)) {
+        text.text = s;
+        text.x = x;
+        text.y = y;
+        text.color = color;
+        changed = true;
+      }
+      text.version = osd->getVersion();
+    }
+    ++it;
   }
+  if(it != osd_texts_.end()) {
+    osd_texts_.erase(it, osd_texts_.end());
+    changed = true;
+  }
+  return changed;
 }
 
 
@@ -355,6 +908,24 @@ void Display::windowInit()
     throw(Error("window already initialized")); // should not happen
   }
 
+  if(offscreen_) {
+#ifdef SIMULOTTER_OSMESA
+    // SDL is still used for timings
+    if(SDL_Init(SDL_INIT_TIMER) < 0) {
+      throw(Error("SDL: initialization failed: %s", SDL_GetError()));
+    }
+    if(antialias > 0) {
+      LOG("multisampling is not supported by offscreen displays");
+    }
+    offscreen_ctx_ = OSMesaCreateContextExt(OSMESA_RGBA, 24, 0, 0, NULL);
+    if(!offscreen_ctx_) {
+      windowDestroy();
+      throw(Error("OSMesa: cannot create context"));
+    }
+#endif
+    return;
+  }
+
   if(SDL_Init(SDL_INIT_VIDEO) < 0) {
     windowDestroy();
     throw(Error("SDL: initialization failed: %s", SDL_GetError()));
@@ -384,6 +955,41 @@ void Display::windowInit()
 
 void Display::windowDestroy()
 {
+  {
+    DisplayRegistry& registry = display_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.displays.erase(this);
+    released_keys_.clear();
+  }
+  if(windowInitialized()) {
+    if(capture_) {
+      capture_->releaseGL();
+    }
+    collectResources();
+    for(auto& entry : mesh_list_) {
+      entry.mesh->releaseGL();
+    }
+    instances_.releaseGL();
+    ordered_instances_.releaseGL();
+    text_.releaseGL();
+  }
+  // display lists are destroyed with the context, meshes are dropped since
+  // their keys are not tracked anymore
+  display_lists_.clear();
+  released_lists_.clear();
+  instances_.clear();
+  ordered_instances_.clear();
+  meshes_.clear();
+  mesh_list_.clear();
+  released_meshes_.clear();
+  mesh_size_ = 0;
+#ifdef SIMULOTTER_OSMESA
+  if(offscreen_ctx_) {
+    OSMesaDestroyContext(offscreen_ctx_);
+    offscreen_ctx_ = NULL;
+  }
+  offscreen_buffer_.reset();
+#endif
   SDL_Quit();
 }
 
@@ -412,6 +1018,7 @@ void Display::sceneInit()
   glEnable(GL_COLOR_MATERIAL);
   glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
 
+  buffer_objects_ = glproc::loadBuffers(this);
 }
 
 void Display::sceneDestroy() {}
@@ -441,6 +1048,92 @@ void Display::endDisplayList()
 }
 
 
+Mesh* Display::getMesh(const MeshKey& key, const MeshBuilder& build)
+{
+  MeshContainer::iterator it = meshes_.find(key);
+  if(it != meshes_.end()) {
+    // move to front
+    mesh_list_.splice(mesh_list_.begin(), mesh_list_, it->second);
+  } else {
+    std::unique_ptr<Mesh> mesh(new Mesh());
+    build(*mesh);
+    const size_t size = mesh->getDataSize();
+    mesh_list_.push_front(MeshEntry{key, std::move(mesh), size, frame_});
+    mesh_size_ += size;
+    it = meshes_.insert(std::make_pair(key, mesh_list_.begin())).first;
+  }
+  MeshEntry& entry = *it->second;
+  entry.frame = frame_;
+  return entry.mesh.get();
+}
+
+void Display::drawMesh(const void* key, const MeshBuilder& build)
+{
+  getMesh(MeshKey(key, 0), build)->draw(this);
+}
+
+void Display::drawShape(const btCollisionShape* shape)
+{
+  drawMesh(shape, [shape](Mesh& mesh) { mesh.addShape(shape, draw_div); });
+}
+
+void Display::drawMeshInstance(const void* key, const MeshBuilder& build, const Color4& color, const btTransform& trans)
+{
+  (drawing_last_ ? ordered_instances_ : instances_).add(getMesh(MeshKey(key, 0), build), color, trans);
+}
+
+void Display::drawShapeInstance(const btCollisionShape* shape, const Color4& color, const btTransform& trans)
+{
+  const unsigned int level = getShapeLevel(shape, trans.getOrigin());
+  const unsigned int div = std::max(draw_div >> level, std::min(draw_div, 6u));
+  Mesh* mesh = getMesh(MeshKey(shape, level), [shape,div](Mesh& mesh) { mesh.addShape(shape, div); });
+  (drawing_last_ ? ordered_instances_ : instances_).add(mesh, color, trans);
+}
+
+/// Return \e true if a shape is tessellated
+static bool isRoundShape(const btCollisionShape* shape)
+{
+  switch(shape->getShapeType()) {
+    case SPHERE_SHAPE_PROXYTYPE:
+    case CAPSULE_SHAPE_PROXYTYPE:
+    case CYLINDER_SHAPE_PROXYTYPE:
+    case CONE_SHAPE_PROXYTYPE:
+      return true;
+    case COMPOUND_SHAPE_PROXYTYPE: {
+      const btCompoundShape* compound_shape = static_cast<const btCompoundShape*>(shape);
+      for(int i=0; i<compound_shape->getNumChildShapes(); i++) {
+        if(isRoundShape(compound_shape->getChildShape(i))) {
+          return true;
+        }
+      }
+      return false;
+    }
+    default:
+      return false;
+  }
+}
+
+unsigned int Display::getShapeLevel(const btCollisionShape* shape, const btVector3& pos) const
+{
+  if(lod_levels <= 1 || !isRoundShape(shape)) {
+    return 0;
+  }
+  btVector3 center;
+  btScalar radius;
+  shape->getBoundingSphere(center, radius);
+  const btScalar distance = (pos - lod_origin_).length();
+  if(distance <= radius) {
+    return 0;
+  }
+  const btScalar size = 2 * radius * lod_scale_ / distance;
+  unsigned int level = 0;
+  for(btScalar threshold=lod_size; level+1 < lod_levels && size < threshold; threshold /= 2) {
+    level++;
+  }
+  return level;
+}
+
+
 
 void Display::processEvents()
 {
@@ -448,8 +1141,13 @@ void Display::processEvents()
   EventHandlerContainer::iterator it_h;
 
   while(SDL_PollEvent(&event)) {
+    if(event.type == SDL_VIDEOEXPOSE) {
+      dirty_ = true;
+    }
     it_h = handlers_.find(event);
     if(it_h != handlers_.end()) {
+      // handlers may modify anything drawn
+      dirty_ = true;
       (*it_h).second(this, &event);
     }
   }
@@ -606,3 +1304,96 @@ bool Display::EventCmp::operator()(const SDL_Event& a, const SDL_Event& b)
 }
 
 
+void Display::releaseKey(const void* key)
+{
+  DisplayRegistry& registry = display_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for(auto d : registry.displays) {
+    d->released_keys_.insert(key);
+  }
+}
+
+void releaseShapeResources(const btCollisionShape* shape)
+{
+  Display::releaseKey(shape);
+}
+
+Display::ResourceStats Display::getResourceStats() const
+{
+  ResourceStats stats;
+  stats.display_lists = display_lists_.size();
+  stats.meshes = meshes_.size();
+  stats.mesh_size = mesh_size_;
+  stats.released = released_count_;
+  stats.evicted = evicted_count_;
+  return stats;
+}
+
+void Display::releaseResources(const void* key)
+{
+  DisplayListContainer::iterator it_list = display_lists_.find(key);
+  if(it_list != display_lists_.end()) {
+    released_lists_.push_back(it_list->second);
+    display_lists_.erase(it_list);
+    released_count_++;
+  }
+  // all tessellation levels
+  MeshContainer::iterator it_mesh = meshes_.lower_bound(MeshKey(key, 0));
+  while(it_mesh != meshes_.end() && it_mesh->first.first == key) {
+    MeshEntry& entry = *it_mesh->second;
+    // queued instances may still use the mesh, keep it until collected
+    released_meshes_.push_back(std::move(entry.mesh));
+    mesh_size_ -= entry.size;
+    mesh_list_.erase(it_mesh->second);
+    it_mesh = meshes_.erase(it_mesh);
+    released_count_++;
+  }
+}
+
+void Display::collectResources()
+{
+  {
+    std::lock_guard<std::mutex> lock(display_registry().mutex);
+    collected_keys_.swap(released_keys_);
+  }
+  for(auto key : collected_keys_) {
+    releaseResources(key);
+  }
+  collected_keys_.clear();
+
+  for(auto id : released_lists_) {
+    glDeleteLists(id, 1);
+  }
+  released_lists_.clear();
+  if(!released_meshes_.empty()) {
+    // instance batches refer to meshes
+    instances_.clear();
+    ordered_instances_.clear();
+    for(auto& mesh : released_meshes_) {
+      mesh->releaseGL();
+    }
+    released_meshes_.clear();
+  }
+}
+
+void Display::evictMeshes()
+{
+  bool evicted = false;
+  while(mesh_budget_ > 0 && mesh_size_ > mesh_budget_) {
+    MeshEntry& entry = mesh_list_.back();
+    if(entry.frame == frame_) {
+      break;  // don't evict meshes drawn in the current frame
+    }
+    entry.mesh->releaseGL();
+    mesh_size_ -= entry.size;
+    meshes_.erase(entry.key);
+    mesh_list_.pop_back();
+    evicted_count_++;
+    evicted = true;
+  }
+  if(evicted) {
+    instances_.clear();
+    ordered_instances_.clear();
+  }
+}
+
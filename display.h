@@ -4,24 +4,48 @@
 ///@file
 
 #include <SDL/SDL.h>
-#include <GL/glut.h>
+#include <SDL/SDL_opengl.h>
 #include <string>
 #include <map>
+#include <list>
+#include <vector>
 #include <set>
+#include <unordered_set>
+#include <memory>
 #include <functional>
+#include <typeindex>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <exception>
 #include "smart.h"
 #include "physics.h"
 #include "colors.h"
+#include "capture.h"
+#include "mesh.h"
+#include "instancing.h"
+#include "text.h"
 
 class Physics;
 class Object;
 class Display;
 class OSDMessage;
+struct osmesa_context;
 
 
 /** @brief Display and interface events
  *
  * Display is not needed for the simulation to run.
+ *
+ * An offscreen display renders into a memory buffer using a software OpenGL
+ * context (OSMesa), without window nor windowing system. It can be used on
+ * headless nodes to save screenshots. Offscreen displays are only available
+ * if built with \e SIMULOTTER_OSMESA.
+ *
+ * Builds with \e SIMULOTTER_OSMESA are offscreen only: GL functions are
+ * resolved to OSMesa, windowed displays cannot be created.
  */
 class Display: public SmartObject
 {
@@ -29,22 +53,39 @@ class Display: public SmartObject
   /** @name Configuration values
    *
    * @note Changing some values may not have any effect on already drawn
-   * objects due to usage of display lists.
+   * objects due to usage of display lists and cached meshes.
    */
   //@{
 
   /// Gap between contiguous surfaces
   static btScalar draw_epsilon;
-  /// Slices and stacks for GLUT geometry objects
+  /// Slices and stacks for round geometry objects
   static unsigned int draw_div;
   /// Multisampling count (0 to disable)
   static unsigned int antialias;
+  /** @brief Number of tessellation levels of round shapes
+   *
+   * Each level halves the slices and stacks of the previous one, starting at
+   * draw_div. Levels are used for instances of round shapes (spheres,
+   * cylinders, cones, capsules), depending on their size on screen.
+   */
+  static unsigned int lod_levels;
+  /** @brief On screen size, in pixels, under which the next level is used
+   *
+   * The threshold is halved for each level.
+   */
+  static float lod_size;
 
   //@}
 
-  Display();
+  /** @brief Constructor
+   * @param offscreen  render into a memory buffer instead of a window
+   */
+  Display(bool offscreen=false);
   virtual ~Display();
 
+  bool isOffscreen() const { return offscreen_; }
+
   SmartPtr<Physics> physics_; ///< Currently drawn Physics
  public:
   Physics* getPhysics() const { return physics_; }
@@ -62,17 +103,51 @@ class Display: public SmartObject
    *
    * If greater than 1, slow down the simulation.
    * If less than 1, speed up the simulation.
+   * It must be positive, run() fails otherwise (use fast_ to step as fast as
+   * possible).
    */
   float time_scale_;
   /** @brief Display rate
-   * @note It also defines the event handling rate.
+   * @note It also defines the event handling rate, unless run() is idle.
    */
   float fps_;
   /// If true, simulation is not stepped in run()
   bool paused_;
+  /** @brief If true, run() steps the simulation in a separate thread
+   *
+   * Physics is stepped as fast as timings allow, independently from the
+   * display rate.
+   *
+   * @note It is read when run() is called.
+   */
+  bool threaded_;
+  /** @brief If true, step the simulation as fast as possible
+   *
+   * Wall-clock and time_scale_ are ignored, frames are displayed at
+   * fast_fps_.
+   */
+  bool fast_;
+  /// Display rate when fast_ is set
+  float fast_fps_;
+  /** @brief Maximum number of steps between two frames, 0 for no limit
+   *
+   * When stepping is slower than real time, simulation time which would
+   * require more steps is skipped (see RunStats). This keeps the display
+   * and event handling responsive.
+   */
+  unsigned int max_steps_per_frame_;
 
   Color4 bg_color_;
 
+  /** @brief OSD texts refresh rate
+   *
+   * OSD messages are queried at most this number of times per second, and
+   * when marked dirty. If 0, they are only queried when marked dirty.
+   *
+   * It is also the rate at which an idle run() checks for changes.
+   */
+  float osd_rate_;
+
   /// Step for camera linear moves
   float camera_step_linear_;
   /// Coefficient for mouse camera moves
@@ -94,23 +169,55 @@ class Display: public SmartObject
   /// Update display
   void update();
 
-  /// Close display window
+  /// Close display window (or destroy the offscreen context)
   void close();
 
   /** @brief Run simulation display
    *
    * Initialize the display (if needed) and display simulation.
    * Timings are given by fps and time_scale_ fields.
+   *
+   * Frames are only drawn when the image may have changed, see setDirty().
+   *
+   * @sa threaded_
    */
   void run();
 
   /// Abort a current call to run()
   void abort() const;
 
+  /// Clock used for run() timings
+  typedef std::chrono::steady_clock Clock;
+
+  /// Counters of the current or last call to run()
+  struct RunStats
+  {
+    RunStats(): frames(0), idle_frames(0), steps(0), skipped(0), behind(false) {}
+    unsigned int frames;  ///< displayed frames
+    unsigned int idle_frames;  ///< frames not redrawn, nothing changed
+    unsigned long steps;  ///< simulation steps
+    double skipped;  ///< simulation time skipped due to max_steps_per_frame_, in seconds
+    bool behind;  ///< true if simulation is currently behind real time
+  };
+  RunStats getRunStats() const { return run_stats_; }
+
 
   /// Save a PNG screenshot into a file
   void savePNGScreenshot(const std::string& filename);
 
+  /** @brief Capture displayed frames
+   *
+   * Frames are captured by update(). Set to \e NULL to stop capturing.
+   * The previous capture is not closed.
+   */
+  void setCapture(FrameCapture* capture);
+  FrameCapture* getCapture() const { return capture_; }
+
+  /// Get an OpenGL function of the display's context
+  void* getProcAddress(const char* name) const;
+  /// Return \e true if the context supports vertex buffer objects
+  bool hasBufferObjects() const { return buffer_objects_; }
+
  private:
   SDL_Surface* screen_;
 
@@ -119,20 +226,83 @@ class Display: public SmartObject
   bool fullscreen_;
 
   bool is_running_;  ///< True if run() is being called
+  RunStats run_stats_;
+  /// Record skipped simulation time, log when falling behind real time
+  void reportBehind(double skipped);
 
-  bool windowInitialized() const { return SDL_WasInit(SDL_INIT_VIDEO) != 0; }
+  const bool offscreen_;
+  /// Offscreen OpenGL context, \e NULL if not created
+  osmesa_context* offscreen_ctx_;
+  /// Offscreen color buffer, RGBA
+  std::unique_ptr<unsigned char[]> offscreen_buffer_;
+
+  SmartPtr<FrameCapture> capture_;
+  /// Set by sceneInit()
+  bool buffer_objects_;
+
+  bool windowInitialized() const
+  {
+    return offscreen_ ? offscreen_ctx_ != NULL : SDL_WasInit(SDL_INIT_VIDEO) != 0;
+  }
   void windowInit();
   void windowDestroy();
   void sceneInit();
   void sceneDestroy();
 
 
+  /** @name Idle rendering
+   *
+   * run() only redraws when the image may have changed: simulation steps
+   * moving bodies, calling tick callbacks or changing the world revision
+   * (see Physics::getRevision()), handled events, camera moves, resizes and
+   * OSD text changes. Frames are always drawn while capturing.
+   *
+   * When paused and nothing changes, run() waits for SDL events instead of
+   * polling them at fps_, and checks for other changes at osd_rate_.
+   */
+  //@{
+ public:
+  /** @brief Redraw on next frame of run()
+   *
+   * Changes done outside of event handlers and of the simulation (e.g. from
+   * another thread) are not tracked, call it to get them displayed.
+   */
+  void setDirty() { dirty_ = true; }
+
+ private:
+  /// Return \e true if a frame has to be drawn, refresh OSD texts
+  bool needsRedraw();
+  /// Compute the camera transform of the next frame
+  btTransform getCameraTrans() const;
+  /** @brief Wait until an SDL event is pending or a given time
+   *
+   * SDL 1.2 has no timed wait, SDL_WaitEvent() is mimicked.
+   */
+  void waitEvents(const Clock::time_point& until) const;
+  /// Delay between two change checks when idle, from osd_rate_
+  Clock::duration getIdleDelay() const;
+
+  /// Set when the drawn image is outdated, reset by update()
+  std::atomic<bool> dirty_;
+  /// Camera of the last drawn frame
+  struct DrawnCamera
+  {
+    btTransform trans;
+    float fov;
+    float z_near;
+    float z_far;
+  };
+  DrawnCamera drawn_camera_;
+
+  //@}
+
+
   /** @name Display lists
    *
    * Display lists are stored in an associative map whose keys are typically
    * pointers to elements drawn by the display list.
    *
-   * @todo Allow an object to destroy its display list.
+   * @sa releaseKey()
    */
   //@{
  public:
@@ -155,6 +325,272 @@ class Display: public SmartObject
 
   //@}
 
+  /** @name Meshes
+   *
+   * Meshes are cached like display lists. Geometry is kept in vertex buffer
+   * objects and drawn in a single call. Unlike display lists, it survives
+   * context resets: only buffers are released and uploaded again.
+   *
+   * Mesh geometry must not depend on the GL state (e.g. colors are not
+   * stored).
+   */
+  //@{
+ public:
+
+  /// Mesh building callback
+  typedef std::function<void (Mesh&)> MeshBuilder;
+
+  /** @brief Draw a cached mesh
+   *
+   * If there is no mesh for the given key, it is created and built using
+   * \e build.
+   */
+  void drawMesh(const void* key, const MeshBuilder& build);
+  /** @brief Draw a collision shape
+   *
+   * The shape is used as mesh key, its mesh is shared by all objects
+   * using it.
+   */
+  void drawShape(const btCollisionShape* shape);
+
+  /** @brief Draw an instance of a cached mesh
+   *
+   * The instance is drawn at the end of the current drawing pass (draw() or
+   * drawLast() calls), batched with other instances of the same mesh and
+   * color. In drawLast() calls, only instances of consecutive calls are
+   * batched, to keep the back to front order.
+   *
+   * @param key  mesh key, see drawMesh()
+   * @param build  mesh building callback
+   * @param color  instance color
+   * @param trans  instance transform, relative to the world (the current GL
+   *               matrix is ignored)
+   */
+  void drawMeshInstance(const void* key, const MeshBuilder& build, const Color4& color, const btTransform& trans);
+  /** @brief Draw an instance of a collision shape, see drawMeshInstance()
+   *
+   * Round shapes are tessellated according to their size on screen, see
+   * lod_levels.
+   */
+  void drawShapeInstance(const btCollisionShape* shape, const Color4& color, const btTransform& trans);
+
+ private:
+  /// Mesh key and tessellation level
+  typedef std::pair<const void*, unsigned int> MeshKey;
+
+  /// Get a cached mesh, build it if needed
+  Mesh* getMesh(const MeshKey& key, const MeshBuilder& build);
+  /// Get the tessellation level of a shape drawn at a given position
+  unsigned int getShapeLevel(const btCollisionShape* shape, const btVector3& pos) const;
+
+  struct MeshEntry
+  {
+    MeshKey key;
+    std::unique_ptr<Mesh> mesh;
+    size_t size;
+    /// Last frame the mesh has been drawn
+    unsigned int frame;
+  };
+  /// Meshes, most recently drawn first
+  typedef std::list<MeshEntry> MeshList;
+  MeshList mesh_list_;
+  typedef std::map<MeshKey, MeshList::iterator> MeshContainer;
+  MeshContainer meshes_;
+  InstanceRenderer instances_;
+
+  //@}
+
+  /** @name Render queues
+   *
+   * Objects are classified once per frame. Objects outside the camera
+   * frustum are skipped (see Object::getDrawAabb()). Opaque parts are drawn
+   * first, sorted by object type and shape to group similar state changes.
+   * Then, transparent objects (see Object::isTransparent()) are drawn back
+   * to front.
+   */
+  //@{
+  struct RenderItem
+  {
+    const Object* obj;
+    std::type_index type;
+    const btCollisionShape* shape;
+    /// Distance along the camera axis, for transparent objects
+    btScalar depth;
+  };
+  /// Draw objects, \e camera is the camera transform
+  template <class C> void drawObjects(const C& objs, const btTransform& camera);
+  /// Set frustum planes and LOD parameters from the camera transform
+  void setupFrustum(const btTransform& camera);
+  /// Return \e true if an AABB is outside the camera frustum
+  bool isCulled(const btVector3& aabb_min, const btVector3& aabb_max) const;
+
+  /// Frustum planes, normals point inside
+  btVector3 frustum_normals_[6];
+  btScalar frustum_dists_[6];
+  /// Camera position
+  btVector3 lod_origin_;
+  /// Size on screen, in pixels, of a unit length at unit distance
+  btScalar lod_scale_;
+
+  /// Queues, kept between frames to reuse allocated memory
+  std::vector<RenderItem> opaque_queue_;
+  std::vector<RenderItem> transparent_queue_;
+  /// Instances drawn by drawLast(), in order
+  InstanceRenderer ordered_instances_;
+  /// True while calling drawLast()
+  bool drawing_last_;
+
+  //@}
+
+  /** @name Cached resources
+   *
+   * Display lists and meshes are identified by a key, typically the address
+   * of the object or shape they draw. They are released with their key: when
+   * an object is removed from its world, or when a shape is deleted. Thus, a
+   * new element allocated at the same address does not reuse them.
+   *
+   * Meshes are also evicted, least recently drawn first, when their total
+   * size exceeds a budget. Evicted meshes are rebuilt when drawn again.
+   */
+  //@{
+ public:
+  /// Resource counters
+  struct ResourceStats
+  {
+    unsigned int display_lists;  ///< cached display lists
+    unsigned int meshes;  ///< cached meshes
+    size_t mesh_size;  ///< size of cached meshes, in bytes
+    unsigned int released;  ///< resources released with their key
+    unsigned int evicted;  ///< meshes evicted due to the budget
+  };
+
+  /** @brief Release resources of a key, in all displays
+   *
+   * Resources are released on next update (the context may not be current).
+   * Displays without window hold no resources and are skipped. It can be
+   * called from any thread.
+   */
+  static void releaseKey(const void* key);
+
+  /// Set the mesh size budget in bytes, 0 for no limit
+  void setMeshBudget(size_t size) { mesh_budget_ = size; }
+  size_t getMeshBudget() const { return mesh_budget_; }
+
+  ResourceStats getResourceStats() const;
+
+ private:
+  /// Detach resources of a key
+  void releaseResources(const void* key);
+  /// Release queued keys and delete resources, the context must be current
+  void collectResources();
+  /// Evict least recently drawn meshes exceeding the budget
+  void evictMeshes();
+
+  size_t mesh_size_;
+  size_t mesh_budget_;
+  /// Current frame number, for mesh eviction
+  unsigned int frame_;
+  std::vector<GLuint> released_lists_;
+  std::vector<std::unique_ptr<Mesh>> released_meshes_;
+  unsigned int released_count_;
+  unsigned int evicted_count_;
+  /// Keys queued by releaseKey(), protected by the display registry mutex
+  std::unordered_set<const void*> released_keys_;
+  std::unordered_set<const void*> collected_keys_;
+
+  //@}
+
+  /** @name Threaded run
+   *
+   * When run() is threaded, physics is stepped by a dedicated thread. After
+   * each step which may have changed it, it publishes a snapshot of the
+   * world: drawn objects, collision object transforms and OSD texts. The
+   * display draws the latest snapshot at its own rate.
+   *
+   * While paused, the physics thread waits and only publishes snapshots
+   * requested by the display after handling events, or on OSD changes.
+   *
+   * Snapshots are double-buffered: the physics thread fills a back buffer
+   * which is then swapped with a pending one, the display takes the pending
+   * buffer when it starts a frame. Neither thread waits for the other.
+   *
+   * The world is locked while stepping and while processing events, thus
+   * event handlers can safely modify it. Objects must use getDrawTrans() to
+   * get the transform to draw; other object data is read while the world is
+   * being stepped.
+   */
+  //@{
+ public:
+  /** @brief Get the transform to draw a collision object
+   *
+   * Return the snapshot transform when drawing a threaded run, the current
+   * transform otherwise.
+   */
+  const btTransform& getDrawTrans(const btCollisionObject* o) const;
+
+ private:
+  /// Cached OSD message
+  struct OSDText
+  {
+    std::string text;
+    int x, y;
+    Color4 color;
+    /// Message version, see OSDMessage::setDirty()
+    unsigned int version;
+  };
+  struct Snapshot
+  {
+    /// Drawn objects, referenced until the buffer is refilled
+    std::vector<SmartPtr<Object>> objs;
+    /// Collision object transforms, sorted by address
+    std::vector<std::pair<const btCollisionObject*, btTransform>> bodies;
+    std::vector<OSDText> osds;
+    /// Camera reference object, and its transform
+    const Object* camera_obj;
+    btTransform camera_trans;
+  };
+
+  /// Main loop of run(), physics is stepped between frames
+  void runSingle();
+  /// Main loop of threaded run()
+  void runThreaded();
+  /// Physics thread main loop
+  void physicsMain();
+  /** @brief Fill a snapshot with the current state, the world must be locked
+   * @note OSD texts are not refreshed.
+   */
+  void captureSnapshot(Snapshot& snap);
+  /// Capture the back buffer and make it pending, called by the physics thread
+  void publishSnapshot();
+  /// Take the pending buffer, if any, and draw it, return \e true if it is new
+  bool acquireSnapshot();
+  /// Stop and join the physics thread, drop snapshots
+  void stopPhysicsThread();
+
+  std::thread physics_thread_;
+  /// Locked while stepping and processing events
+  std::mutex world_mutex_;
+  /// Set by the display before locking the world, the physics thread yields
+  std::atomic<bool> world_wanted_;
+  std::atomic<bool> physics_stop_;
+  /// Set by the display to get a snapshot while paused
+  std::atomic<bool> snapshot_wanted_;
+  /// Wake the paused physics thread, used with world_mutex_
+  std::condition_variable physics_cv_;
+  /// Exception raised by the physics thread, protected by snapshot_mutex_
+  std::exception_ptr physics_error_;
+
+  Snapshot snapshots_[3];
+  unsigned int snapshot_front_;  ///< drawn buffer
+  unsigned int snapshot_pending_;  ///< latest published buffer
+  unsigned int snapshot_back_;  ///< buffer filled by the physics thread
+  bool snapshot_new_;  ///< true if the pending buffer has not been taken
+  std::mutex snapshot_mutex_;
+  /// Snapshot being drawn, \e NULL if not drawing a threaded run
+  const Snapshot* draw_snapshot_;
+
+  //@}
+
  public:
 
   /** @brief Camera
@@ -262,15 +698,28 @@ class Display: public SmartObject
 
  public:
 
-  /** @brief Draw a text string using given font
+  /** @brief Draw a text string using the built-in font
+   *
+   * Texts are batched and drawn at the end of update(), above everything
+   * else. It is available offscreen.
+   *
    * @note y=0 is the top of the screen
    */
-  void drawString(const std::string& s, int x, int y, Color4 color, void* font);
+  void drawText(const std::string& s, int x, int y, const Color4& color);
   std::set<SmartPtr<OSDMessage>>& getOsds() { return osds_; }
 
  private:
+  /** @brief Update cached OSD texts, query dirty messages or all if refresh is due
+   * @return \e true if a cached text changed.
+   */
+  bool refreshOSDTexts();
+
   /// Displayed OSDs
   std::set<SmartPtr<OSDMessage>> osds_;
+  /// Cached OSD texts, in osds_ order
+  std::map<const OSDMessage*, OSDText> osd_texts_;
+  Clock::time_point osd_refresh_time_;
+  TextRenderer text_;
 
   //@}
 };
@@ -279,13 +728,20 @@ class Display: public SmartObject
 /** @brief OSD messages interface
  *
  * Base class for text messages displayed on screen.
+ *
+ * Displays cache message values and query them at a limited rate (see
+ * Display::osd_rate_). Call setDirty() to have them queried on next update.
  */
 class OSDMessage: public SmartObject
 {
  public:
-  OSDMessage() {}
+  OSDMessage(): version_(next_version_++) {}
   virtual ~OSDMessage() {}
 
+  /// Mark the message as changed
+  void setDirty() { version_ = next_version_++; }
+  unsigned int getVersion() const { return version_; }
+
   /** @name Common accessors
    */
   //@{
@@ -294,6 +750,11 @@ class OSDMessage: public SmartObject
   virtual int getY() = 0;
   virtual Color4 getColor() = 0;
   //@}
+
+ private:
+  unsigned int version_;
+  /// Versions are unique, a new message never matches a cached one
+  static std::atomic<unsigned int> next_version_;
 };
 
 
@@ -0,0 +1,198 @@
+/* Fixed 8x13 bitmap font, ISO 8859-1 (X11 misc-fixed, public domain)
+ *
+ * Glyphs are stored in character order, one byte per row (most significant
+ * bit on the left), rows from bottom to top.
+ */
+static struct {
+  unsigned int  width;
+  unsigned int  height;
+  unsigned int  baseline; /* rows below the baseline */
+  unsigned char data[256 * 13 + 1];
+} font_8x13 = {
+  8, 13, 2,
+  "\000\000\252\000\202\000\202\000\202\000\252\000\000\000\000\000\020\070"
+  "\174\376\174\070\020\000\000\000\252\125\252\125\252\125\252\125\252\125"
+  "\252\125\252\000\000\004\004\004\004\256\240\340\240\240\000\000\000\000"
+  "\010\010\014\010\216\200\300\200\340\000\000\000\000\012\012\014\012\154"
+  "\200\200\200\140\000\000\000\000\010\010\014\010\356\200\200\200\200\000"
+  "\000\000\000\000\000\000\000\000\030\044\044\030\000\000\000\000\000\174"
+  "\000\020\020\174\020\020\000\000\000\000\000\016\010\010\010\250\240\240"
+  "\240\300\000\000\000\000\004\004\004\004\056\120\120\210\210\000\000\000"
+  "\000\000\000\000\000\360\020\020\020\020\020\020\020\020\020\020\020\020"
+  "\360\000\000\000\000\000\000\020\020\020\020\020\020\037\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\037\020\020\020\020\020\020\020\020\020"
+  "\020\020\020\377\020\020\020\020\020\020\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\377\000\000\000\000\000\000\000\000\000\377\000\000\000"
+  "\000\000\000\000\000\000\377\000\000\000\000\000\000\000\000\000\377\000"
+  "\000\000\000\000\000\000\000\000\377\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\020\020\020\020\020\020\037\020\020\020\020\020\020\020\020"
+  "\020\020\020\020\360\020\020\020\020\020\020\000\000\000\000\000\000\377"
+  "\020\020\020\020\020\020\020\020\020\020\020\020\377\000\000\000\000\000"
+  "\000\020\020\020\020\020\020\020\020\020\020\020\020\020\000\000\376\000"
+  "\016\060\300\060\016\000\000\000\000\000\000\376\000\340\030\006\030\340"
+  "\000\000\000\000\000\000\104\104\104\104\104\376\000\000\000\000\000\000"
+  "\000\040\040\176\020\010\176\004\004\000\000\000\000\000\334\142\040\040"
+  "\040\160\040\042\034\000\000\000\000\000\000\000\000\030\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\020"
+  "\000\020\020\020\020\020\020\020\000\000\000\000\000\000\000\000\000\000"
+  "\044\044\044\000\000\000\000\000\044\044\176\044\176\044\044\000\000\000"
+  "\000\000\020\170\024\024\070\120\120\074\020\000\000\000\000\104\052\044"
+  "\020\010\010\044\122\042\000\000\000\000\072\104\112\060\110\110\060\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\100\060\070\000\000\000\000"
+  "\004\010\010\020\020\020\010\010\004\000\000\000\000\040\020\020\010\010"
+  "\010\020\020\040\000\000\000\000\000\000\044\030\176\030\044\000\000\000"
+  "\000\000\000\000\000\020\020\174\020\020\000\000\000\000\000\100\060\070"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\176\000\000"
+  "\000\000\000\000\000\020\070\020\000\000\000\000\000\000\000\000\000\000"
+  "\000\200\200\100\040\020\010\004\002\002\000\000\000\000\030\044\102\102"
+  "\102\102\102\044\030\000\000\000\000\174\020\020\020\020\020\120\060\020"
+  "\000\000\000\000\176\100\040\030\004\002\102\102\074\000\000\000\000\074"
+  "\102\002\002\034\010\004\002\176\000\000\000\000\004\004\176\104\104\044"
+  "\024\014\004\000\000\000\000\074\102\002\002\142\134\100\100\176\000\000"
+  "\000\000\074\102\102\142\134\100\100\040\034\000\000\000\000\040\040\020"
+  "\020\010\010\004\002\176\000\000\000\000\074\102\102\102\074\102\102\102"
+  "\074\000\000\000\000\070\004\002\002\072\106\102\102\074\000\000\000\020"
+  "\070\020\000\000\020\070\020\000\000\000\000\000\100\060\070\000\000\020"
+  "\070\020\000\000\000\000\000\000\002\004\010\020\040\020\010\004\002\000"
+  "\000\000\000\000\000\176\000\000\176\000\000\000\000\000\000\000\100\040"
+  "\020\010\004\010\020\040\100\000\000\000\000\010\000\010\010\004\002\102"
+  "\102\074\000\000\000\000\074\100\112\126\122\116\102\102\074\000\000\000"
+  "\000\102\102\102\176\102\102\102\044\030\000\000\000\000\374\102\102\102"
+  "\174\102\102\102\374\000\000\000\000\074\102\100\100\100\100\100\102\074"
+  "\000\000\000\000\374\102\102\102\102\102\102\102\374\000\000\000\000\176"
+  "\100\100\100\170\100\100\100\176\000\000\000\000\100\100\100\100\170\100"
+  "\100\100\176\000\000\000\000\072\106\102\116\100\100\100\102\074\000\000"
+  "\000\000\102\102\102\102\176\102\102\102\102\000\000\000\000\174\020\020"
+  "\020\020\020\020\020\174\000\000\000\000\070\104\004\004\004\004\004\004"
+  "\037\000\000\000\000\102\104\110\120\140\120\110\104\102\000\000\000\000"
+  "\176\100\100\100\100\100\100\100\100\000\000\000\000\202\202\202\222\222"
+  "\252\306\202\202\000\000\000\000\102\102\102\106\112\122\142\102\102\000"
+  "\000\000\000\074\102\102\102\102\102\102\102\074\000\000\000\000\100\100"
+  "\100\100\174\102\102\102\174\000\000\000\002\074\112\122\102\102\102\102"
+  "\102\074\000\000\000\000\102\104\110\120\174\102\102\102\174\000\000\000"
+  "\000\074\102\002\002\074\100\100\102\074\000\000\000\000\020\020\020\020"
+  "\020\020\020\020\376\000\000\000\000\074\102\102\102\102\102\102\102\102"
+  "\000\000\000\000\020\050\050\050\104\104\104\202\202\000\000\000\000\104"
+  "\252\222\222\222\202\202\202\202\000\000\000\000\202\202\104\050\020\050"
+  "\104\202\202\000\000\000\000\020\020\020\020\020\050\104\202\202\000\000"
+  "\000\000\176\100\100\040\020\010\004\002\176\000\000\000\000\074\040\040"
+  "\040\040\040\040\040\074\000\000\000\000\002\002\004\010\020\040\100\200"
+  "\200\000\000\000\000\170\010\010\010\010\010\010\010\170\000\000\000\000"
+  "\000\000\000\000\000\000\104\050\020\000\000\000\376\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\004\030\070\000"
+  "\000\000\000\072\106\102\076\002\074\000\000\000\000\000\000\000\134\142"
+  "\102\102\142\134\100\100\100\000\000\000\000\074\102\100\100\102\074\000"
+  "\000\000\000\000\000\000\072\106\102\102\106\072\002\002\002\000\000\000"
+  "\000\074\102\100\176\102\074\000\000\000\000\000\000\000\040\040\040\040"
+  "\174\040\040\042\034\000\000\074\102\074\100\070\104\104\072\000\000\000"
+  "\000\000\000\000\102\102\102\102\142\134\100\100\100\000\000\000\000\174"
+  "\020\020\020\020\060\000\020\000\000\000\070\104\104\004\004\004\004\014"
+  "\000\004\000\000\000\000\000\102\104\110\160\110\104\100\100\100\000\000"
+  "\000\000\174\020\020\020\020\020\020\020\060\000\000\000\000\202\222\222"
+  "\222\222\354\000\000\000\000\000\000\000\102\102\102\102\142\134\000\000"
+  "\000\000\000\000\000\074\102\102\102\102\074\000\000\000\000\000\100\100"
+  "\100\134\142\102\142\134\000\000\000\000\000\002\002\002\072\106\102\106"
+  "\072\000\000\000\000\000\000\000\040\040\040\040\042\134\000\000\000\000"
+  "\000\000\000\074\102\014\060\102\074\000\000\000\000\000\000\000\034\042"
+  "\040\040\040\174\040\040\000\000\000\000\000\072\104\104\104\104\104\000"
+  "\000\000\000\000\000\000\020\050\050\104\104\104\000\000\000\000\000\000"
+  "\000\104\252\222\222\202\202\000\000\000\000\000\000\000\102\044\030\030"
+  "\044\102\000\000\000\000\000\074\102\002\072\106\102\102\102\000\000\000"
+  "\000\000\000\000\176\040\020\010\004\176\000\000\000\000\000\000\000\016"
+  "\020\020\010\060\010\020\020\016\000\000\000\000\020\020\020\020\020\020"
+  "\020\020\020\000\000\000\000\160\010\010\020\014\020\010\010\160\000\000"
+  "\000\000\000\000\000\000\000\000\110\124\044\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\000\000\020\020\020\020\020\020\020\000\020\000\000"
+  "\000\000\000\020\070\124\120\120\124\070\020\000\000\000\000\334\142\040"
+  "\040\040\160\040\042\034\000\000\000\000\000\102\074\044\044\074\102\000"
+  "\000\000\000\000\000\020\020\174\020\174\050\104\202\202\000\000\000\000"
+  "\020\020\020\020\000\020\020\020\020\000\000\000\000\030\044\004\030\044"
+  "\044\030\040\044\030\000\000\000\000\000\000\000\000\000\000\000\154\000"
+  "\000\000\000\000\070\104\222\252\242\252\222\104\070\000\000\000\000\000"
+  "\174\000\074\104\074\004\070\000\000\000\000\000\022\044\110\220\110\044"
+  "\022\000\000\000\000\000\000\002\002\002\176\000\000\000\000\000\000\000"
+  "\000\000\000\000\000\074\000\000\000\000\000\000\000\000\000\070\104\252"
+  "\262\252\252\222\104\070\000\000\000\000\000\000\000\000\000\000\000\176"
+  "\000\000\000\000\000\000\000\000\000\030\044\044\030\000\000\000\000\000"
+  "\174\000\020\020\174\020\020\000\000\000\000\000\000\000\000\000\170\100"
+  "\060\010\110\060\000\000\000\000\000\000\000\060\110\010\020\110\060\000"
+  "\000\000\000\000\000\000\000\000\000\000\020\010\000\000\100\132\146\102"
+  "\102\102\102\000\000\000\000\000\000\000\024\024\024\024\064\164\164\164"
+  "\076\000\000\000\000\000\000\000\000\030\000\000\000\000\000\000\030\010"
+  "\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\000\160"
+  "\040\040\040\140\040\000\000\000\000\000\000\170\000\060\110\110\060\000"
+  "\000\000\000\000\220\110\044\022\044\110\220\000\000\000\000\000\006\032"
+  "\022\012\346\102\100\100\300\100\000\000\000\036\020\014\002\362\114\100"
+  "\100\300\100\000\000\000\006\032\022\012\146\222\020\040\220\140\000\000"
+  "\000\074\102\102\100\040\020\020\000\020\000\000\000\000\102\102\176\102"
+  "\102\044\030\000\010\020\000\000\000\102\102\176\102\102\044\030\000\020"
+  "\010\000\000\000\102\102\176\102\102\044\030\000\044\030\000\000\000\102"
+  "\102\176\102\102\044\030\000\114\062\000\000\000\102\102\176\102\102\044"
+  "\030\000\044\044\000\000\000\102\102\176\102\102\044\030\030\044\030\000"
+  "\000\000\236\220\220\360\234\220\220\220\156\000\000\020\010\074\102\100"
+  "\100\100\100\100\102\074\000\000\000\000\176\100\100\170\100\100\176\000"
+  "\010\020\000\000\000\176\100\100\170\100\100\176\000\020\010\000\000\000"
+  "\176\100\100\170\100\100\176\000\044\030\000\000\000\176\100\100\170\100"
+  "\100\176\000\044\044\000\000\000\174\020\020\020\020\020\174\000\020\040"
+  "\000\000\000\174\020\020\020\020\020\174\000\020\010\000\000\000\174\020"
+  "\020\020\020\020\174\000\044\030\000\000\000\174\020\020\020\020\020\174"
+  "\000\050\050\000\000\000\170\104\102\102\342\102\102\104\170\000\000\000"
+  "\000\202\206\212\222\242\302\202\000\230\144\000\000\000\174\202\202\202"
+  "\202\202\174\000\020\040\000\000\000\174\202\202\202\202\202\174\000\020"
+  "\010\000\000\000\174\202\202\202\202\202\174\000\044\030\000\000\000\174"
+  "\202\202\202\202\202\174\000\230\144\000\000\000\174\202\202\202\202\202"
+  "\174\000\050\050\000\000\000\000\102\044\030\030\044\102\000\000\000\000"
+  "\000\100\074\142\122\122\122\112\112\106\074\002\000\000\000\074\102\102"
+  "\102\102\102\102\000\010\020\000\000\000\074\102\102\102\102\102\102\000"
+  "\020\010\000\000\000\074\102\102\102\102\102\102\000\044\030\000\000\000"
+  "\074\102\102\102\102\102\102\000\044\044\000\000\000\020\020\020\020\050"
+  "\104\104\000\020\010\000\000\000\100\100\100\174\102\102\102\174\100\000"
+  "\000\000\000\134\102\102\114\120\110\104\104\070\000\000\000\000\072\106"
+  "\102\076\002\074\000\000\010\020\000\000\000\072\106\102\076\002\074\000"
+  "\000\010\004\000\000\000\072\106\102\076\002\074\000\000\044\030\000\000"
+  "\000\072\106\102\076\002\074\000\000\114\062\000\000\000\072\106\102\076"
+  "\002\074\000\000\044\044\000\000\000\072\106\102\076\002\074\000\030\044"
+  "\030\000\000\000\154\222\220\174\022\154\000\000\000\000\000\020\010\074"
+  "\102\100\100\102\074\000\000\000\000\000\000\000\074\102\100\176\102\074"
+  "\000\000\010\020\000\000\000\074\102\100\176\102\074\000\000\020\010\000"
+  "\000\000\074\102\100\176\102\074\000\000\044\030\000\000\000\074\102\100"
+  "\176\102\074\000\000\044\044\000\000\000\174\020\020\020\020\060\000\000"
+  "\020\040\000\000\000\174\020\020\020\020\060\000\000\040\020\000\000\000"
+  "\174\020\020\020\020\060\000\000\110\060\000\000\000\174\020\020\020\020"
+  "\060\000\000\050\050\000\000\000\074\102\102\102\102\074\004\050\030\044"
+  "\000\000\000\102\102\102\102\142\134\000\000\114\062\000\000\000\074\102"
+  "\102\102\102\074\000\000\020\040\000\000\000\074\102\102\102\102\074\000"
+  "\000\020\010\000\000\000\074\102\102\102\102\074\000\000\044\030\000\000"
+  "\000\074\102\102\102\102\074\000\000\114\062\000\000\000\074\102\102\102"
+  "\102\074\000\000\044\044\000\000\000\000\020\020\000\174\000\020\020\000"
+  "\000\000\000\100\074\142\122\112\106\074\002\000\000\000\000\000\000\072"
+  "\104\104\104\104\104\000\000\020\040\000\000\000\072\104\104\104\104\104"
+  "\000\000\020\010\000\000\000\072\104\104\104\104\104\000\000\044\030\000"
+  "\000\000\072\104\104\104\104\104\000\000\050\050\000\074\102\002\072\106"
+  "\102\102\102\000\000\020\010\000\100\100\134\142\102\102\142\134\100\100"
+  "\000\000\000\074\102\002\072\106\102\102\102\000\000\044\044\000"
+};
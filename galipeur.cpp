@@ -1,6 +1,5 @@
 #include "galipeur.h"
 #include "display.h"
-#include "graphics.h"
 #include "physics.h"
 #include "sensors.h"
 #include "log.h"
@@ -88,7 +87,7 @@ Galipeur::~Galipeur()
 
 void Galipeur::addToWorld(Physics* physics)
 {
-  physics->getWorld()->addRigidBody(body_);
+  addBodyToWorld(physics, body_);
   Robot::addToWorld(physics);
   target_a_ = getAngle(); // init target angle
   //XXX find a better place to do this
@@ -101,111 +100,117 @@ void Galipeur::removeFromWorld()
   ph_bak->getWorld()->removeRigidBody(body_);
 }
 
+void Galipeur::saveState(StateBuffer& buf) const
+{
+  Robot::saveState(buf);
+  buf.writeVector(checkpoints_);
+  buf.write(current_checkpoint());
+  // Quadramp only contains scalar values
+  buf.write(ramp_xy_);
+  buf.write(ramp_a_);
+  buf.write(v_steering_);
+  buf.write(va_steering_);
+  buf.write(threshold_steering_);
+  buf.write(v_stop_);
+  buf.write(va_stop_);
+  buf.write(threshold_stop_);
+  buf.write(target_a_);
+  buf.write(ramp_last_t_);
+  buf.write(threshold_a_);
+}
+
+void Galipeur::restoreState(StateBuffer& buf)
+{
+  Robot::restoreState(buf);
+  buf.readVector(checkpoints_);
+  size_t ckpt;
+  buf.read(ckpt);
+  ckpt_ = checkpoints_.begin() + ckpt;
+  buf.read(ramp_xy_);
+  buf.read(ramp_a_);
+  buf.read(v_steering_);
+  buf.read(va_steering_);
+  buf.read(threshold_steering_);
+  buf.read(v_stop_);
+  buf.read(va_stop_);
+  buf.read(threshold_stop_);
+  buf.read(target_a_);
+  buf.read(ramp_last_t_);
+  buf.read(threshold_a_);
+}
+
+
 void Galipeur::draw(Display* d) const
 {
   glColor4fv(color_);
 
   glPushMatrix();
-  drawTransform(body_->getCenterOfMassTransform());
+  drawTransform(d->getDrawTrans(body_));
   btglRotate(-ANGLE_OFFSET*180.0f/M_PI, 0.0f, 0.0f, 1.0f);
 
-  if(d->callOrCreateDisplayList(this)) {
-    glPushMatrix();
-
-    btglTranslate(0, 0, -Z_MASS);
+  // geometry only depends on constants, the mesh is shared
+  d->drawMesh(&body_shape_, [](Mesh& mesh) {
+    mesh.translate(btVector3(0, 0, -Z_MASS));
 
     // Faces
 
-    glPushMatrix();
-
-    btglTranslate(0, 0, GROUND_CLEARANCE);
-
-    btglScale(RADIUS, RADIUS, HEIGHT);
-    btVector2 v;
-
+    const btTransform base_trans = mesh.getTransform();
+    mesh.translate(btVector3(0, 0, GROUND_CLEARANCE));
 
-    glBegin(GL_QUADS);
-
-    v = btVector2(1,0).rotated(-A_WHEEL/2);
+    const btScalar z0 = 0, z1 = HEIGHT;
+    btVector2 v = btVector2(RADIUS,0).rotated(-A_WHEEL/2);
     btVector2 n(1,0); // normal vector
+    btVector3 bottom[6], top[6];
     for(int i=0; i<3; i++) {
       // wheel side
-      btglNormal3(n.x(), n.y(), 0.0);
+      const btVector2 v1 = v.rotated(A_WHEEL);
+      mesh.addQuad(btVector3(v.x(), v.y(), z0), btVector3(v1.x(), v1.y(), z0),
+                   btVector3(v1.x(), v1.y(), z1), btVector3(v.x(), v.y(), z1),
+                   btVector3(n.x(), n.y(), 0));
       n.rotate(M_PI/3);
 
-      btglVertex3(v.x(), v.y(), 0.0);
-      btglVertex3(v.x(), v.y(), 1.0);
-      v.rotate(A_WHEEL);
-      btglVertex3(v.x(), v.y(), 1.0);
-      btglVertex3(v.x(), v.y(), 0.0);
-
       // triangle side
-      btglNormal3(n.x(), n.y(), 0.0);
+      const btVector2 v2 = v1.rotated(A_SIDE);
+      mesh.addQuad(btVector3(v1.x(), v1.y(), z0), btVector3(v2.x(), v2.y(), z0),
+                   btVector3(v2.x(), v2.y(), z1), btVector3(v1.x(), v1.y(), z1),
+                   btVector3(n.x(), n.y(), 0));
       n.rotate(M_PI/3);
 
-      btglVertex3(v.x(), v.y(), 0.0);
-      btglVertex3(v.x(), v.y(), 1.0);
-      v.rotate(A_SIDE);
-      btglVertex3(v.x(), v.y(), 1.0);
-      btglVertex3(v.x(), v.y(), 0.0);
+      // bottom is reversed to face -z
+      bottom[5-2*i] = btVector3(v.x(), v.y(), z0);
+      bottom[4-2*i] = btVector3(v1.x(), v1.y(), z0);
+      top[2*i] = btVector3(v.x(), v.y(), z1);
+      top[2*i+1] = btVector3(v1.x(), v1.y(), z1);
+      v = v2;
     }
 
-    glEnd();
+    // Bottom, Top
+    mesh.addPolygon(bottom, 6, btVector3(0, 0, -1));
+    mesh.addPolygon(top, 6, btVector3(0, 0, 1));
 
-    // Bottom
-    glBegin(GL_POLYGON);
-    btglNormal3(0.0, 0.0, -1.0);
-    v = btVector2(1,0).rotated(-A_WHEEL/2);
-    for(int i=0; i<3; i++) {
-      btglVertex3(v.x(), v.y(), 0.0);
-      v.rotate(A_WHEEL);
-      btglVertex3(v.x(), v.y(), 0.0);
-      v.rotate(A_SIDE);
-    }
-    glEnd();
-
-    // Top
-    glBegin(GL_POLYGON);
-    btglNormal3(0.0, 0.0, 1.0);
-    v = btVector2(1,0).rotated(-A_WHEEL/2);
-    for(int i=0; i<3; i++) {
-      btglVertex3(v.x(), v.y(), 1.0);
-      v.rotate(A_WHEEL);
-      btglVertex3(v.x(), v.y(), 1.0);
-      v.rotate(A_SIDE);
-    }
-    glEnd();
-
-    glPopMatrix();
+    mesh.setTransform(base_trans);
 
     // Wheels (box shapes, but drawn using cylinders)
-    btglTranslate(0, 0, R_WHEEL);
-    btglRotate(90.0f, 0.0f, 1.0f, 0.0f);
+    mesh.translate(btVector3(0, 0, R_WHEEL));
+    mesh.transform(btTransform(btQuaternion(btVector3(0,1,0), M_PI/2)));
+    const btTransform wheels_trans = mesh.getTransform();
     btVector2 vw( D_WHEEL, 0 );
 
-    glPushMatrix();
-    btglTranslate(0, vw.y(), vw.x());
-    graphics::drawClosedCylinder(R_WHEEL, H_WHEEL, Display::draw_div);
-    glPopMatrix();
+    mesh.translate(btVector3(0, vw.y(), vw.x()));
+    mesh.addClosedCylinder(R_WHEEL, H_WHEEL, Display::draw_div);
+    mesh.setTransform(wheels_trans);
 
-    glPushMatrix();
     vw.rotate(2*M_PI/3);
-    btglTranslate(0, vw.y(), vw.x());
-    btglRotate(-120.0f, 1.0f, 0.0f, 0.0f);
-    graphics::drawClosedCylinder(R_WHEEL, H_WHEEL, Display::draw_div);
-    glPopMatrix();
+    mesh.translate(btVector3(0, vw.y(), vw.x()));
+    mesh.transform(btTransform(btQuaternion(btVector3(1,0,0), -2*M_PI/3)));
+    mesh.addClosedCylinder(R_WHEEL, H_WHEEL, Display::draw_div);
+    mesh.setTransform(wheels_trans);
 
-    glPushMatrix();
     vw.rotate(-4*M_PI/3);
-    btglTranslate(0, vw.y(), vw.x());
-    btglRotate(120.0f, 1.0f, 0.0f, 0.0f);
-    graphics::drawClosedCylinder(R_WHEEL, H_WHEEL, Display::draw_div);
-    glPopMatrix();
-
-    glPopMatrix();
-
-    d->endDisplayList();
-  }
+    mesh.translate(btVector3(0, vw.y(), vw.x()));
+    mesh.transform(btTransform(btQuaternion(btVector3(1,0,0), 2*M_PI/3)));
+    mesh.addClosedCylinder(R_WHEEL, H_WHEEL, Display::draw_div);
+  });
 
   glPopMatrix();
 }
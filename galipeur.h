@@ -22,6 +22,8 @@ class Galipeur: public Robot
 
   virtual void addToWorld(Physics* physics);
   virtual void removeFromWorld();
+  virtual void saveState(StateBuffer& buf) const;
+  virtual void restoreState(StateBuffer& buf);
 
   Color4 getColor() const { return color_; }
   void setColor(const Color4& color) { color_ = color; }
@@ -34,7 +36,8 @@ class Galipeur: public Robot
   virtual void draw(Display* d) const;
 
   virtual const btTransform getTrans() const { return body_->getCenterOfMassTransform(); }
-  virtual void setTrans(const btTransform& tr) { body_->setCenterOfMassTransform(tr); }
+  virtual void setTrans(const btTransform& tr) { body_->setCenterOfMassTransform(tr); markMoved(); }
+  virtual const btCollisionObject* getMainBody() const { return body_; }
 
   /** @brief Place above (not on or in) the ground
    *
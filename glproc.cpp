@@ -0,0 +1,185 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <mutex>
+#include "glproc.h"
+#include "display.h"
+#include "log.h"
+
+namespace glproc {
+
+
+PFNGLGENBUFFERSARBPROC GenBuffers = NULL;
+PFNGLDELETEBUFFERSARBPROC DeleteBuffers = NULL;
+PFNGLBINDBUFFERARBPROC BindBuffer = NULL;
+PFNGLBUFFERDATAARBPROC BufferData = NULL;
+PFNGLMAPBUFFERARBPROC MapBuffer = NULL;
+PFNGLUNMAPBUFFERARBPROC UnmapBuffer = NULL;
+
+PFNGLCREATESHADERPROC CreateShader = NULL;
+PFNGLDELETESHADERPROC DeleteShader = NULL;
+PFNGLSHADERSOURCEPROC ShaderSource = NULL;
+PFNGLCOMPILESHADERPROC CompileShader = NULL;
+PFNGLGETSHADERIVPROC GetShaderiv = NULL;
+PFNGLGETSHADERINFOLOGPROC GetShaderInfoLog = NULL;
+PFNGLCREATEPROGRAMPROC CreateProgram = NULL;
+PFNGLDELETEPROGRAMPROC DeleteProgram = NULL;
+PFNGLATTACHSHADERPROC AttachShader = NULL;
+PFNGLBINDATTRIBLOCATIONPROC BindAttribLocation = NULL;
+PFNGLLINKPROGRAMPROC LinkProgram = NULL;
+PFNGLGETPROGRAMIVPROC GetProgramiv = NULL;
+PFNGLGETPROGRAMINFOLOGPROC GetProgramInfoLog = NULL;
+PFNGLUSEPROGRAMPROC UseProgram = NULL;
+PFNGLENABLEVERTEXATTRIBARRAYPROC EnableVertexAttribArray = NULL;
+PFNGLDISABLEVERTEXATTRIBARRAYPROC DisableVertexAttribArray = NULL;
+PFNGLVERTEXATTRIBPOINTERPROC VertexAttribPointer = NULL;
+
+PFNGLDRAWELEMENTSINSTANCEDARBPROC DrawElementsInstanced = NULL;
+PFNGLVERTEXATTRIBDIVISORARBPROC VertexAttribDivisor = NULL;
+
+
+/// Protect loading, and context type
+static std::mutex load_mutex;
+/// Context type functions are loaded from, -1 if none, 1 if offscreen
+static int load_offscreen = -1;
+
+/// Function set loading state, functions are loaded once
+struct LoadState
+{
+  bool loaded;
+  bool available;
+};
+static LoadState buffers_state = {false, false};
+static LoadState shaders_state = {false, false};
+static LoadState instancing_state = {false, false};
+
+/** @brief Start loading a function set, load_mutex must be locked
+ *
+ * @return \e true if functions must be loaded.
+ */
+static bool startLoad(const Display* d, const LoadState& state)
+{
+  const int offscreen = d->isOffscreen() ? 1 : 0;
+  if(load_offscreen == -1) {
+    load_offscreen = offscreen;
+  } else if(load_offscreen != offscreen) {
+    throw(Error("GL functions already loaded from another context type"));
+  }
+  return !state.loaded;
+}
+
+
+/// Get a function, try the ARB name if the core one is not found
+template <class T> static bool load(const Display* d, T& f, const char* name)
+{
+  f = reinterpret_cast<T>(d->getProcAddress(name));
+  if(!f) {
+    const std::string arb_name = std::string(name) + "ARB";
+    f = reinterpret_cast<T>(d->getProcAddress(arb_name.c_str()));
+  }
+  return f != NULL;
+}
+
+
+bool loadBuffers(const Display* d)
+{
+  std::lock_guard<std::mutex> lock(load_mutex);
+  if(!startLoad(d, buffers_state)) {
+    return buffers_state.available;
+  }
+  buffers_state.loaded = true;
+  if(!hasExtension("GL_ARB_vertex_buffer_object") && !hasVersion(1, 5)) {
+    return false;
+  }
+  buffers_state.available =
+      load(d, GenBuffers, "glGenBuffers") &&
+      load(d, DeleteBuffers, "glDeleteBuffers") &&
+      load(d, BindBuffer, "glBindBuffer") &&
+      load(d, BufferData, "glBufferData") &&
+      load(d, MapBuffer, "glMapBuffer") &&
+      load(d, UnmapBuffer, "glUnmapBuffer");
+  return buffers_state.available;
+}
+
+
+bool loadShaders(const Display* d)
+{
+  std::lock_guard<std::mutex> lock(load_mutex);
+  if(!startLoad(d, shaders_state)) {
+    return shaders_state.available;
+  }
+  shaders_state.loaded = true;
+  // ARB_shader_objects functions have different names, only use core ones
+  if(!hasVersion(2, 0)) {
+    return false;
+  }
+  shaders_state.available =
+      load(d, CreateShader, "glCreateShader") &&
+      load(d, DeleteShader, "glDeleteShader") &&
+      load(d, ShaderSource, "glShaderSource") &&
+      load(d, CompileShader, "glCompileShader") &&
+      load(d, GetShaderiv, "glGetShaderiv") &&
+      load(d, GetShaderInfoLog, "glGetShaderInfoLog") &&
+      load(d, CreateProgram, "glCreateProgram") &&
+      load(d, DeleteProgram, "glDeleteProgram") &&
+      load(d, AttachShader, "glAttachShader") &&
+      load(d, BindAttribLocation, "glBindAttribLocation") &&
+      load(d, LinkProgram, "glLinkProgram") &&
+      load(d, GetProgramiv, "glGetProgramiv") &&
+      load(d, GetProgramInfoLog, "glGetProgramInfoLog") &&
+      load(d, UseProgram, "glUseProgram") &&
+      load(d, EnableVertexAttribArray, "glEnableVertexAttribArray") &&
+      load(d, DisableVertexAttribArray, "glDisableVertexAttribArray") &&
+      load(d, VertexAttribPointer, "glVertexAttribPointer");
+  return shaders_state.available;
+}
+
+
+bool loadInstancing(const Display* d)
+{
+  std::lock_guard<std::mutex> lock(load_mutex);
+  if(!startLoad(d, instancing_state)) {
+    return instancing_state.available;
+  }
+  instancing_state.loaded = true;
+  if(!hasVersion(3, 3) && !(
+      hasExtension("GL_ARB_draw_instanced") &&
+      hasExtension("GL_ARB_instanced_arrays"))) {
+    return false;
+  }
+  instancing_state.available =
+      load(d, DrawElementsInstanced, "glDrawElementsInstanced") &&
+      load(d, VertexAttribDivisor, "glVertexAttribDivisor");
+  return instancing_state.available;
+}
+
+
+bool hasExtension(const char* name)
+{
+  const char* exts = (const char*)glGetString(GL_EXTENSIONS);
+  if(!exts) {
+    return false;
+  }
+  // match whole names only
+  const size_t len = strlen(name);
+  for(const char* p=exts; (p=strstr(p, name)) != NULL; p+=len) {
+    if((p == exts || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0')) {
+      return true;
+    }
+  }
+  return false;
+}
+
+
+bool hasVersion(int major, int minor)
+{
+  const char* version = (const char*)glGetString(GL_VERSION);
+  int v_major, v_minor;
+  if(!version || sscanf(version, "%d.%d", &v_major, &v_minor) != 2) {
+    return false;
+  }
+  return v_major > major || (v_major == major && v_minor >= minor);
+}
+
+
+}
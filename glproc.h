@@ -0,0 +1,95 @@
+#ifndef GLPROC_H_
+#define GLPROC_H_
+
+///@file
+
+#include <SDL/SDL_opengl.h>
+
+class Display;
+
+
+/** @brief OpenGL functions loaded at runtime
+ *
+ * Functions introduced after OpenGL 1.1 cannot be linked directly on all
+ * platforms (e.g. Windows). They are retrieved from the display's context
+ * and are \e NULL until loaded.
+ *
+ * Functions are shared by all displays and loaded once. Entry points are
+ * valid for all contexts of a same type, but not for contexts of another
+ * type: loading functions from both windowed and offscreen displays is an
+ * error.
+ */
+namespace glproc {
+
+/** @name Buffer objects (OpenGL 1.5 or ARB_vertex_buffer_object)
+ */
+//@{
+extern PFNGLGENBUFFERSARBPROC GenBuffers;
+extern PFNGLDELETEBUFFERSARBPROC DeleteBuffers;
+extern PFNGLBINDBUFFERARBPROC BindBuffer;
+extern PFNGLBUFFERDATAARBPROC BufferData;
+extern PFNGLMAPBUFFERARBPROC MapBuffer;
+extern PFNGLUNMAPBUFFERARBPROC UnmapBuffer;
+
+/** @brief Load buffer object functions
+ *
+ * The display's context must be current. It can be called from any thread.
+ *
+ * @return \e true if all functions are available.
+ */
+bool loadBuffers(const Display* d);
+//@}
+
+/** @name Shaders (OpenGL 2.0)
+ */
+//@{
+extern PFNGLCREATESHADERPROC CreateShader;
+extern PFNGLDELETESHADERPROC DeleteShader;
+extern PFNGLSHADERSOURCEPROC ShaderSource;
+extern PFNGLCOMPILESHADERPROC CompileShader;
+extern PFNGLGETSHADERIVPROC GetShaderiv;
+extern PFNGLGETSHADERINFOLOGPROC GetShaderInfoLog;
+extern PFNGLCREATEPROGRAMPROC CreateProgram;
+extern PFNGLDELETEPROGRAMPROC DeleteProgram;
+extern PFNGLATTACHSHADERPROC AttachShader;
+extern PFNGLBINDATTRIBLOCATIONPROC BindAttribLocation;
+extern PFNGLLINKPROGRAMPROC LinkProgram;
+extern PFNGLGETPROGRAMIVPROC GetProgramiv;
+extern PFNGLGETPROGRAMINFOLOGPROC GetProgramInfoLog;
+extern PFNGLUSEPROGRAMPROC UseProgram;
+extern PFNGLENABLEVERTEXATTRIBARRAYPROC EnableVertexAttribArray;
+extern PFNGLDISABLEVERTEXATTRIBARRAYPROC DisableVertexAttribArray;
+extern PFNGLVERTEXATTRIBPOINTERPROC VertexAttribPointer;
+
+/** @brief Load shader functions
+ *
+ * The display's context must be current. It can be called from any thread.
+ *
+ * @return \e true if all functions are available.
+ */
+bool loadShaders(const Display* d);
+//@}
+
+/** @name Instanced drawing (OpenGL 3.3 or ARB_draw_instanced and ARB_instanced_arrays)
+ */
+//@{
+extern PFNGLDRAWELEMENTSINSTANCEDARBPROC DrawElementsInstanced;
+extern PFNGLVERTEXATTRIBDIVISORARBPROC VertexAttribDivisor;
+
+/** @brief Load instanced drawing functions
+ *
+ * The display's context must be current. It can be called from any thread.
+ *
+ * @return \e true if all functions are available.
+ */
+bool loadInstancing(const Display* d);
+//@}
+
+/// Return \e true if the current context supports an extension
+bool hasExtension(const char* name);
+/// Return \e true if the current context version is at least major.minor
+bool hasVersion(int major, int minor);
+
+}
+
+#endif
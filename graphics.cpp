@@ -1,4 +1,4 @@
-#include <GL/glut.h>
+#include <SDL/SDL_opengl.h>
 #include "graphics.h"
 
 namespace graphics {
@@ -78,4 +78,84 @@ void drawClosedCylinder(btScalar r, btScalar h, unsigned int slices)
 }
 
 
+/// Cube vertices, indexed by face
+static const GLfloat cube_vertices[6][4][3] = {
+  {{ 1,-1,-1}, { 1, 1,-1}, { 1, 1, 1}, { 1,-1, 1}},
+  {{-1,-1,-1}, {-1,-1, 1}, {-1, 1, 1}, {-1, 1,-1}},
+  {{-1, 1,-1}, {-1, 1, 1}, { 1, 1, 1}, { 1, 1,-1}},
+  {{-1,-1,-1}, { 1,-1,-1}, { 1,-1, 1}, {-1,-1, 1}},
+  {{-1,-1, 1}, { 1,-1, 1}, { 1, 1, 1}, {-1, 1, 1}},
+  {{-1,-1,-1}, {-1, 1,-1}, { 1, 1,-1}, { 1,-1,-1}},
+};
+static const GLfloat cube_normals[6][3] = {
+  { 1, 0, 0}, {-1, 0, 0}, { 0, 1, 0}, { 0,-1, 0}, { 0, 0, 1}, { 0, 0,-1},
+};
+
+void drawCube(btScalar size)
+{
+  const btScalar h = size/2;
+  glBegin(GL_QUADS);
+  for(unsigned int i=0; i<6; ++i) {
+    glNormal3fv(cube_normals[i]);
+    for(unsigned int j=0; j<4; ++j) {
+      const GLfloat* v = cube_vertices[i][j];
+      btglVertex3(v[0]*h, v[1]*h, v[2]*h);
+    }
+  }
+  glEnd();
+}
+
+void drawWireCube(btScalar size)
+{
+  const btScalar h = size/2;
+  for(unsigned int i=0; i<6; ++i) {
+    glNormal3fv(cube_normals[i]);
+    glBegin(GL_LINE_LOOP);
+    for(unsigned int j=0; j<4; ++j) {
+      const GLfloat* v = cube_vertices[i][j];
+      btglVertex3(v[0]*h, v[1]*h, v[2]*h);
+    }
+    glEnd();
+  }
+}
+
+void drawCone(btScalar r, btScalar h, unsigned int slices, unsigned int stacks)
+{
+  btScalar vcos[slices+1];
+  btScalar vsin[slices+1];
+  const btScalar a = 2*M_PI/slices;
+  for(unsigned int i=0; i<=slices; ++i) {
+    vcos[i] = btCos(i*a);
+    vsin[i] = btSin(i*a);
+  }
+
+  // base
+  btglNormal3(0, 0, -1);
+  glBegin(GL_TRIANGLE_FAN);
+  btglVertex3(0, 0, 0);
+  for(unsigned int i=slices+1; i-->0; ) {
+    btglVertex3(vcos[i]*r, vsin[i]*r, 0);
+  }
+  glEnd();
+
+  // side, normals are constant along generatrices
+  const btScalar l = btSqrt(r*r + h*h);
+  const btScalar nz = r/l;
+  const btScalar nr = h/l;
+  for(unsigned int j=0; j<stacks; ++j) {
+    const btScalar r0 = r*(stacks-j)/stacks;
+    const btScalar r1 = r*(stacks-j-1)/stacks;
+    const btScalar z0 = h*j/stacks;
+    const btScalar z1 = h*(j+1)/stacks;
+    glBegin(GL_QUAD_STRIP);
+    for(unsigned int i=0; i<=slices; ++i) {
+      btglNormal3(vcos[i]*nr, vsin[i]*nr, nz);
+      btglVertex3(vcos[i]*r0, vsin[i]*r0, z0);
+      btglVertex3(vcos[i]*r1, vsin[i]*r1, z1);
+    }
+    glEnd();
+  }
+}
+
+
 }
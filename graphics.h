@@ -19,6 +19,19 @@ void drawDisk(btScalar r0, btScalar r1, btScalar z, unsigned int slices, btScala
 /// Draw a cylinder with bottom and bottom faces
 void drawClosedCylinder(btScalar r, btScalar h, unsigned int slices);
 
+/** @name GLUT-like geometry
+ *
+ * Same geometry as GLUT functions.
+ */
+//@{
+/// Draw a cube centered on the origin
+void drawCube(btScalar size);
+/// Draw cube edges
+void drawWireCube(btScalar size);
+/// Draw a closed cone, base at z=0, apex at z=h
+void drawCone(btScalar r, btScalar h, unsigned int slices, unsigned int stacks);
+//@}
+
 }
 
 #endif
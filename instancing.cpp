@@ -0,0 +1,256 @@
+#include "instancing.h"
+#include "mesh.h"
+#include "display.h"
+#include "glproc.h"
+#include "log.h"
+
+
+/** @brief Vertex shader of instanced drawing
+ *
+ * Lighting is the same as the fixed-function one set by the display:
+ * directional light 0, ambient and diffuse material from the current color,
+ * no specular.
+ */
+static const char* instance_vertex_shader =
+    "#version 120\n"
+    "attribute mat4 instance_transform;\n"
+    "void main()\n"
+    "{\n"
+    "  gl_Position = gl_ModelViewProjectionMatrix * (instance_transform * gl_Vertex);\n"
+    "  vec3 normal = normalize(gl_NormalMatrix * (mat3(instance_transform) * gl_Normal));\n"
+    "  vec3 light = normalize(gl_LightSource[0].position.xyz);\n"
+    "  float diffuse = max(dot(normal, light), 0.0);\n"
+    "  vec3 color = gl_Color.rgb * (gl_LightModel.ambient.rgb + gl_LightSource[0].ambient.rgb\n"
+    "                               + diffuse * gl_LightSource[0].diffuse.rgb);\n"
+    "  gl_FrontColor = vec4(color, gl_Color.a);\n"
+    "}\n";
+
+static const char* instance_fragment_shader =
+    "#version 120\n"
+    "void main()\n"
+    "{\n"
+    "  gl_FragColor = gl_Color;\n"
+    "}\n";
+
+
+/// Compile a shader, return 0 on error
+static GLuint compileShader(GLenum type, const char* source)
+{
+  GLuint shader = glproc::CreateShader(type);
+  glproc::ShaderSource(shader, 1, &source, NULL);
+  glproc::CompileShader(shader);
+  GLint status;
+  glproc::GetShaderiv(shader, GL_COMPILE_STATUS, &status);
+  if(!status) {
+    char msg[512];
+    glproc::GetShaderInfoLog(shader, sizeof(msg), NULL, msg);
+    LOG("cannot compile instancing shader: %s", msg);
+    glproc::DeleteShader(shader);
+    return 0;
+  }
+  return shader;
+}
+
+
+InstanceRenderer::InstanceRenderer(bool ordered):
+    ordered_(ordered), batch_count_(0), instance_count_(0),
+    instancing_support_(-1), program_(0), buffer_(0)
+{
+}
+
+InstanceRenderer::~InstanceRenderer()
+{
+  // resources cannot be deleted without the context, see releaseGL()
+}
+
+
+void InstanceRenderer::add(Mesh* mesh, const Color4& color, const btTransform& trans)
+{
+  const BatchKey key(mesh, color.r(), color.g(), color.b(), color.a());
+  size_t index;
+  if(ordered_) {
+    // only group with the previous instance
+    if(batch_count_ == 0 || key != batchKey(batches_[batch_count_-1])) {
+      nextBatch(mesh, color);
+    }
+    index = batch_count_-1;
+  } else {
+    auto it = batch_index_.find(key);
+    if(it == batch_index_.end()) {
+      it = batch_index_.insert(std::make_pair(key, nextBatch(mesh, color))).first;
+    }
+    index = it->second;
+  }
+  btScalar m[16];
+  trans.getOpenGLMatrix(m);
+  std::vector<GLfloat>& transforms = batches_[index].transforms;
+  transforms.insert(transforms.end(), m, m+16);
+  instance_count_++;
+}
+
+void InstanceRenderer::flush(const Display* d)
+{
+  if(instance_count_ == 0) {
+    return;
+  }
+  if(instancing_support_ < 0) {
+    instancing_support_ = initGL(d);
+    if(!instancing_support_) {
+      LOG("instanced drawing not supported, instances are drawn one by one");
+    }
+  }
+  if(instancing_support_) {
+    flushInstanced(d);
+  } else {
+    flushFallback(d);
+  }
+  // batches are reassigned on next pass, keys not drawn anymore are dropped
+  for(size_t i=0; i<batch_count_; i++) {
+    batches_[i].transforms.clear();
+  }
+  batch_index_.clear();
+  batch_count_ = 0;
+  instance_count_ = 0;
+}
+
+void InstanceRenderer::clear()
+{
+  batches_.clear();
+  batch_index_.clear();
+  batch_count_ = 0;
+  instance_count_ = 0;
+}
+
+InstanceRenderer::BatchKey InstanceRenderer::batchKey(const Batch& batch)
+{
+  const Color4& color = batch.color;
+  return BatchKey(batch.mesh, color.r(), color.g(), color.b(), color.a());
+}
+
+size_t InstanceRenderer::nextBatch(Mesh* mesh, const Color4& color)
+{
+  if(batch_count_ == batches_.size()) {
+    batches_.push_back(Batch{mesh, color, {}});
+  } else {
+    batches_[batch_count_].mesh = mesh;
+    batches_[batch_count_].color = color;
+  }
+  return batch_count_++;
+}
+
+void InstanceRenderer::releaseGL()
+{
+  if(instancing_support_ > 0) {
+    glproc::DeleteProgram(program_);
+    glproc::DeleteBuffers(1, &buffer_);
+  }
+  program_ = 0;
+  buffer_ = 0;
+  instancing_support_ = -1;
+}
+
+
+bool InstanceRenderer::initGL(const Display* d)
+{
+  if(!d->hasBufferObjects() || !glproc::loadShaders(d) || !glproc::loadInstancing(d)) {
+    return false;
+  }
+
+  GLuint vs = compileShader(GL_VERTEX_SHADER, instance_vertex_shader);
+  GLuint fs = compileShader(GL_FRAGMENT_SHADER, instance_fragment_shader);
+  if(!vs || !fs) {
+    if(vs) {
+      glproc::DeleteShader(vs);
+    }
+    if(fs) {
+      glproc::DeleteShader(fs);
+    }
+    return false;
+  }
+  program_ = glproc::CreateProgram();
+  glproc::AttachShader(program_, vs);
+  glproc::AttachShader(program_, fs);
+  glproc::BindAttribLocation(program_, ATTRIB_TRANSFORM, "instance_transform");
+  glproc::LinkProgram(program_);
+  // shaders are deleted with the program
+  glproc::DeleteShader(vs);
+  glproc::DeleteShader(fs);
+  GLint status;
+  glproc::GetProgramiv(program_, GL_LINK_STATUS, &status);
+  if(!status) {
+    char msg[512];
+    glproc::GetProgramInfoLog(program_, sizeof(msg), NULL, msg);
+    LOG("cannot link instancing program: %s", msg);
+    glproc::DeleteProgram(program_);
+    program_ = 0;
+    return false;
+  }
+
+  glproc::GenBuffers(1, &buffer_);
+  return true;
+}
+
+void InstanceRenderer::flushInstanced(const Display* d)
+{
+  // gather transforms, upload them at once
+  transforms_.clear();
+  for(size_t b=0; b<batch_count_; b++) {
+    const Batch& batch = batches_[b];
+    transforms_.insert(transforms_.end(), batch.transforms.begin(), batch.transforms.end());
+  }
+  glproc::BindBuffer(GL_ARRAY_BUFFER_ARB, buffer_);
+  glproc::BufferData(GL_ARRAY_BUFFER_ARB, transforms_.size()*sizeof(GLfloat), transforms_.data(), GL_STREAM_DRAW_ARB);
+
+  glproc::UseProgram(program_);
+  for(GLuint i=0; i<4; i++) {
+    glproc::EnableVertexAttribArray(ATTRIB_TRANSFORM+i);
+    glproc::VertexAttribDivisor(ATTRIB_TRANSFORM+i, 1);
+  }
+
+  size_t offset = 0;
+  for(size_t b=0; b<batch_count_; b++) {
+    const Batch& batch = batches_[b];
+    const GLsizei count = batch.transforms.size()/16;
+    if(count == 0) {
+      continue;
+    }
+    // one attribute per matrix column
+    glproc::BindBuffer(GL_ARRAY_BUFFER_ARB, buffer_);
+    for(GLuint i=0; i<4; i++) {
+      const GLvoid* ptr = reinterpret_cast<const GLvoid*>((offset+4*i)*sizeof(GLfloat));
+      glproc::VertexAttribPointer(ATTRIB_TRANSFORM+i, 4, GL_FLOAT, GL_FALSE, 16*sizeof(GLfloat), ptr);
+    }
+    glColor4fv(batch.color);
+    batch.mesh->bind(d);
+    batch.mesh->drawBoundInstanced(count);
+    batch.mesh->unbind();
+    offset += batch.transforms.size();
+  }
+
+  for(GLuint i=0; i<4; i++) {
+    glproc::VertexAttribDivisor(ATTRIB_TRANSFORM+i, 0);
+    glproc::DisableVertexAttribArray(ATTRIB_TRANSFORM+i);
+  }
+  glproc::UseProgram(0);
+}
+
+void InstanceRenderer::flushFallback(const Display* d)
+{
+  for(size_t b=0; b<batch_count_; b++) {
+    const Batch& batch = batches_[b];
+    const size_t count = batch.transforms.size()/16;
+    if(count == 0) {
+      continue;
+    }
+    glColor4fv(batch.color);
+    batch.mesh->bind(d);
+    for(size_t i=0; i<count; i++) {
+      glPushMatrix();
+      glMultMatrixf(&batch.transforms[16*i]);
+      batch.mesh->drawBound();
+      glPopMatrix();
+    }
+    batch.mesh->unbind();
+  }
+}
+
@@ -0,0 +1,98 @@
+#ifndef INSTANCING_H_
+#define INSTANCING_H_
+
+///@file
+
+#include <map>
+#include <tuple>
+#include <vector>
+#include <SDL/SDL_opengl.h>
+#include "bullet.h"
+#include "colors.h"
+
+class Display;
+class Mesh;
+
+
+/** @brief Batched drawing of mesh instances
+ *
+ * Instances are queued during a drawing pass, then drawn grouped by mesh and
+ * color. Transforms of all instances are gathered in a single buffer.
+ *
+ * An ordered renderer preserves the order in which instances are queued
+ * (e.g. for back-to-front drawing of transparent objects): only consecutive
+ * instances of the same mesh and color are grouped.
+ *
+ * With instanced arrays, each group is drawn in a single call, transforms
+ * being per-instance vertex attributes. Lighting is then done by a shader
+ * which reproduces the fixed-function lighting used by the display.
+ * Otherwise, instances are drawn one by one, mesh arrays being bound once per
+ * group.
+ *
+ * @sa Display::drawMeshInstance()
+ */
+class InstanceRenderer
+{
+ public:
+  InstanceRenderer(bool ordered=false);
+  ~InstanceRenderer();
+
+  /// Queue an instance, \e trans is relative to the world
+  void add(Mesh* mesh, const Color4& color, const btTransform& trans);
+
+  /** @brief Draw queued instances
+   *
+   * The display's context must be current, with the camera as modelview
+   * matrix.
+   */
+  void flush(const Display* d);
+
+  /// Drop queued instances and groups, must be called before deleting meshes
+  void clear();
+  /// Release OpenGL resources
+  void releaseGL();
+
+ private:
+  /// Generic attribute location of the instance transform (4 locations)
+  static const GLuint ATTRIB_TRANSFORM = 4;
+
+  /// Group of instances drawn in a single call
+  struct Batch
+  {
+    Mesh* mesh;
+    Color4 color;
+    /// Column-major instance transforms
+    std::vector<GLfloat> transforms;
+  };
+  /// Batch keys, colors are compared component-wise
+  typedef std::tuple<const Mesh*, GLfloat, GLfloat, GLfloat, GLfloat> BatchKey;
+
+  static BatchKey batchKey(const Batch& batch);
+  /// Use the next batch of the current pass, return its index
+  size_t nextBatch(Mesh* mesh, const Color4& color);
+
+  /// Initialize instanced drawing, return \e false if not supported
+  bool initGL(const Display* d);
+  void flushInstanced(const Display* d);
+  void flushFallback(const Display* d);
+
+  const bool ordered_;
+  /// Batches, kept between passes to reuse allocated memory
+  std::vector<Batch> batches_;
+  /// Batch of each key in the current pass, not used if ordered
+  std::map<BatchKey, size_t> batch_index_;
+  /// Number of batches used in the current pass
+  size_t batch_count_;
+  size_t instance_count_;
+
+  /// -1 if unknown, 0 if not supported
+  int instancing_support_;
+  GLuint program_;
+  /// Transform buffer
+  GLuint buffer_;
+  /// Transforms of all batches, in batch order
+  std::vector<GLfloat> transforms_;
+};
+
+
+#endif
@@ -0,0 +1,370 @@
+#include <cstddef>
+#include "mesh.h"
+#include "display.h"
+#include "glproc.h"
+#include "log.h"
+
+
+/// Compute cos/sin values of a full turn
+static void computeSlices(unsigned int slices, std::vector<btScalar>& vcos, std::vector<btScalar>& vsin)
+{
+  vcos.resize(slices+1);
+  vsin.resize(slices+1);
+  const btScalar a = 2*M_PI/slices;
+  for(unsigned int i=0; i<=slices; ++i) {
+    vcos[i] = btCos(i*a);
+    vsin[i] = btSin(i*a);
+  }
+}
+
+/** @brief Get the rotation bringing z on a shape's up axis
+ *
+ * Same rotations as the ones used to draw shapes with the GL matrix.
+ */
+static btMatrix3x3 upAxisBasis(int axis)
+{
+  switch(axis) {
+    case 0: return btMatrix3x3(btQuaternion(btVector3(0,1,0), -M_PI/2));
+    case 1: return btMatrix3x3(btQuaternion(btVector3(1,0,0), -M_PI/2));
+    case 2: return btMatrix3x3::getIdentity();
+    default:
+      throw(Error("invalid shape up axis"));
+  }
+}
+
+
+Mesh::Mesh():
+    trans_(btTransform::getIdentity()),
+    bound_indices_(NULL), bound_buffers_(false)
+{
+  buffers_[0] = buffers_[1] = 0;
+}
+
+Mesh::~Mesh()
+{
+  // buffers cannot be deleted without the context, see releaseGL()
+}
+
+
+GLuint Mesh::addVertex(const btVector3& pos, const btVector3& normal)
+{
+  const btVector3 p = trans_(pos);
+  const btVector3 n = trans_.getBasis() * normal;
+  Vertex v = {
+    { (GLfloat)p.x(), (GLfloat)p.y(), (GLfloat)p.z() },
+    { (GLfloat)n.x(), (GLfloat)n.y(), (GLfloat)n.z() },
+  };
+  vertices_.push_back(v);
+  return vertices_.size()-1;
+}
+
+void Mesh::addTriangle(GLuint i0, GLuint i1, GLuint i2)
+{
+  indices_.push_back(i0);
+  indices_.push_back(i1);
+  indices_.push_back(i2);
+}
+
+void Mesh::addQuad(const btVector3& v0, const btVector3& v1, const btVector3& v2, const btVector3& v3, const btVector3& normal)
+{
+  const GLuint i = addVertex(v0, normal);
+  addVertex(v1, normal);
+  addVertex(v2, normal);
+  addVertex(v3, normal);
+  addTriangle(i, i+1, i+2);
+  addTriangle(i, i+2, i+3);
+}
+
+void Mesh::addPolygon(const btVector3* v, unsigned int n, const btVector3& normal)
+{
+  if(n < 3) {
+    return;
+  }
+  const GLuint i0 = addVertex(v[0], normal);
+  for(unsigned int i=1; i<n; ++i) {
+    addVertex(v[i], normal);
+  }
+  for(unsigned int i=1; i<n-1; ++i) {
+    addTriangle(i0, i0+i, i0+i+1);
+  }
+}
+
+
+void Mesh::addCylinder(btScalar r, btScalar h, unsigned int slices, bool inside)
+{
+  std::vector<btScalar> vcos, vsin;
+  computeSlices(slices, vcos, vsin);
+  const btScalar sign = inside ? -1 : 1;
+
+  // bottom and top vertices alternate
+  const GLuint i0 = vertices_.size();
+  for(unsigned int i=0; i<=slices; ++i) {
+    const btVector3 normal(sign*vcos[i], sign*vsin[i], 0);
+    addVertex(btVector3(vcos[i]*r, vsin[i]*r, 0), normal);
+    addVertex(btVector3(vcos[i]*r, vsin[i]*r, h), normal);
+  }
+  for(unsigned int i=0; i<slices; ++i) {
+    const GLuint b0 = i0+2*i, t0 = b0+1, b1 = b0+2, t1 = b0+3;
+    if(inside) {
+      addTriangle(b0, t1, b1);
+      addTriangle(b0, t0, t1);
+    } else {
+      addTriangle(b0, b1, t1);
+      addTriangle(b0, t1, t0);
+    }
+  }
+}
+
+void Mesh::addDisk(btScalar r0, btScalar r1, btScalar z, unsigned int slices, bool down)
+{
+  std::vector<btScalar> vcos, vsin;
+  computeSlices(slices, vcos, vsin);
+  const btVector3 normal(0, 0, down ? -1 : 1);
+
+  if(r0 == 0) {
+    const GLuint c = addVertex(btVector3(0, 0, z), normal);
+    for(unsigned int i=0; i<=slices; ++i) {
+      addVertex(btVector3(vcos[i]*r1, vsin[i]*r1, z), normal);
+    }
+    for(unsigned int i=0; i<slices; ++i) {
+      if(down) {
+        addTriangle(c, c+i+2, c+i+1);
+      } else {
+        addTriangle(c, c+i+1, c+i+2);
+      }
+    }
+  } else {
+    // inner and outer vertices alternate
+    const GLuint i0 = vertices_.size();
+    for(unsigned int i=0; i<=slices; ++i) {
+      addVertex(btVector3(vcos[i]*r0, vsin[i]*r0, z), normal);
+      addVertex(btVector3(vcos[i]*r1, vsin[i]*r1, z), normal);
+    }
+    for(unsigned int i=0; i<slices; ++i) {
+      const GLuint a0 = i0+2*i, b0 = a0+1, a1 = a0+2, b1 = a0+3;
+      if(down) {
+        addTriangle(a0, b1, b0);
+        addTriangle(a0, a1, b1);
+      } else {
+        addTriangle(a0, b0, b1);
+        addTriangle(a0, b1, a1);
+      }
+    }
+  }
+}
+
+void Mesh::addClosedCylinder(btScalar r, btScalar h, unsigned int slices)
+{
+  addCylinder(r, h, slices);
+  addDisk(0, r, 0, slices, true);
+  addDisk(0, r, h, slices);
+}
+
+void Mesh::addSphere(btScalar r, unsigned int slices, unsigned int stacks)
+{
+  std::vector<btScalar> vcos, vsin;
+  computeSlices(slices, vcos, vsin);
+
+  // rows from bottom to top
+  const GLuint i0 = vertices_.size();
+  for(unsigned int j=0; j<=stacks; ++j) {
+    const btScalar angle = j*M_PI/stacks;
+    const btScalar z = -btCos(angle);
+    const btScalar rz = btSin(angle);
+    for(unsigned int i=0; i<=slices; ++i) {
+      const btVector3 normal(vcos[i]*rz, vsin[i]*rz, z);
+      addVertex(normal*r, normal);
+    }
+  }
+  const GLuint row = slices+1;
+  for(unsigned int j=0; j<stacks; ++j) {
+    for(unsigned int i=0; i<slices; ++i) {
+      const GLuint a0 = i0+j*row+i, a1 = a0+1, b0 = a0+row, b1 = b0+1;
+      // skip degenerated triangles on poles
+      if(j > 0) {
+        addTriangle(a0, a1, b1);
+      }
+      if(j < stacks-1) {
+        addTriangle(a0, b1, b0);
+      }
+    }
+  }
+}
+
+void Mesh::addBox(const btVector3& half_extents)
+{
+  for(int axis=0; axis<3; ++axis) {
+    for(int sign=-1; sign<=1; sign+=2) {
+      btVector3 n(0,0,0), u(0,0,0), v(0,0,0);
+      n[axis] = sign;
+      // (u, v, n) is direct
+      u[(axis+(sign>0?1:2))%3] = 1;
+      v[(axis+(sign>0?2:1))%3] = 1;
+      const btVector3 c = n * half_extents;
+      u *= half_extents;
+      v *= half_extents;
+      addQuad(c-u-v, c+u-v, c+u+v, c-u+v, n);
+    }
+  }
+}
+
+void Mesh::addCone(btScalar r, btScalar h, unsigned int slices, unsigned int stacks)
+{
+  std::vector<btScalar> vcos, vsin;
+  computeSlices(slices, vcos, vsin);
+
+  addDisk(0, r, 0, slices, true);
+
+  // side, normals are constant along generatrices
+  const btScalar l = btSqrt(r*r + h*h);
+  const btScalar nz = r/l;
+  const btScalar nr = h/l;
+  const GLuint i0 = vertices_.size();
+  for(unsigned int j=0; j<=stacks; ++j) {
+    const btScalar rj = r*(stacks-j)/stacks;
+    const btScalar zj = h*j/stacks;
+    for(unsigned int i=0; i<=slices; ++i) {
+      addVertex(btVector3(vcos[i]*rj, vsin[i]*rj, zj), btVector3(vcos[i]*nr, vsin[i]*nr, nz));
+    }
+  }
+  const GLuint row = slices+1;
+  for(unsigned int j=0; j<stacks; ++j) {
+    for(unsigned int i=0; i<slices; ++i) {
+      const GLuint a0 = i0+j*row+i, a1 = a0+1, b0 = a0+row, b1 = b0+1;
+      addTriangle(a0, a1, b1);
+      // skip degenerated triangles on the apex
+      if(j < stacks-1) {
+        addTriangle(a0, b1, b0);
+      }
+    }
+  }
+}
+
+
+void Mesh::addShape(const btCollisionShape* shape, unsigned int div)
+{
+  const btTransform saved_trans = trans_;
+  switch(shape->getShapeType()) {
+    case COMPOUND_SHAPE_PROXYTYPE: {
+      const btCompoundShape* compound_shape = static_cast<const btCompoundShape*>(shape);
+      for(int i=compound_shape->getNumChildShapes()-1; i>=0; i--) {
+        trans_ = saved_trans * compound_shape->getChildTransform(i);
+        addShape(compound_shape->getChildShape(i), div);
+      }
+    } break;
+
+    case SPHERE_SHAPE_PROXYTYPE: {
+      const btSphereShape* sphere_shape = static_cast<const btSphereShape*>(shape);
+      addSphere(sphere_shape->getRadius(), div, div);
+    } break;
+
+    case BOX_SHAPE_PROXYTYPE: {
+      const btBoxShape* box_shape = static_cast<const btBoxShape*>(shape);
+      addBox(box_shape->getHalfExtentsWithMargin());
+    } break;
+
+    case CAPSULE_SHAPE_PROXYTYPE: {
+      const btCapsuleShape* capsule_shape = static_cast<const btCapsuleShape*>(shape);
+      const btScalar r = capsule_shape->getRadius();
+      const btScalar len = capsule_shape->getHalfHeight();
+      transform(btTransform(upAxisBasis(capsule_shape->getUpAxis())));
+      translate(btVector3(0, 0, -len));
+      addCylinder(r, 2*len, div);
+      addSphere(r, div, div);
+      translate(btVector3(0, 0, 2*len));
+      addSphere(r, div, div);
+    } break;
+
+    case CYLINDER_SHAPE_PROXYTYPE: {
+      const btCylinderShape* cylinder_shape = static_cast<const btCylinderShape*>(shape);
+      const int axis = cylinder_shape->getUpAxis();
+      const btScalar r = cylinder_shape->getRadius();
+      // there is not a getHalfHeight() function
+      const btScalar len = cylinder_shape->getHalfExtentsWithMargin()[axis];
+      transform(btTransform(upAxisBasis(axis)));
+      translate(btVector3(0, 0, -len));
+      addClosedCylinder(r, 2*len, div);
+    } break;
+
+    case CONE_SHAPE_PROXYTYPE: {
+      const btConeShape* cone_shape = static_cast<const btConeShape*>(shape);
+      const btScalar r = cone_shape->getRadius();
+      const btScalar h = cone_shape->getHeight();
+      transform(btTransform(upAxisBasis(cone_shape->getConeUpIndex())));
+      translate(btVector3(0, 0, -h/2));
+      addCone(r, h, div, div);
+    } break;
+
+    default:
+      throw(Error("drawing not supported for this geometry class"));
+      break;
+  }
+  trans_ = saved_trans;
+}
+
+
+void Mesh::draw(const Display* d)
+{
+  if(indices_.empty()) {
+    return;
+  }
+  bind(d);
+  drawBound();
+  unbind();
+}
+
+void Mesh::bind(const Display* d)
+{
+  const char* vertex_data = reinterpret_cast<const char*>(vertices_.data());
+  bound_indices_ = indices_.data();
+  bound_buffers_ = d != NULL && d->hasBufferObjects() && !indices_.empty();
+  if(bound_buffers_) {
+    if(buffers_[0] == 0) {
+      glproc::GenBuffers(2, buffers_);
+      glproc::BindBuffer(GL_ARRAY_BUFFER_ARB, buffers_[0]);
+      glproc::BufferData(GL_ARRAY_BUFFER_ARB, vertices_.size()*sizeof(Vertex), vertex_data, GL_STATIC_DRAW_ARB);
+      glproc::BindBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, buffers_[1]);
+      glproc::BufferData(GL_ELEMENT_ARRAY_BUFFER_ARB, indices_.size()*sizeof(GLuint), bound_indices_, GL_STATIC_DRAW_ARB);
+    } else {
+      glproc::BindBuffer(GL_ARRAY_BUFFER_ARB, buffers_[0]);
+      glproc::BindBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, buffers_[1]);
+    }
+    // pointers are offsets in bound buffers
+    vertex_data = NULL;
+    bound_indices_ = NULL;
+  }
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_NORMAL_ARRAY);
+  glVertexPointer(3, GL_FLOAT, sizeof(Vertex), vertex_data + offsetof(Vertex, pos));
+  glNormalPointer(GL_FLOAT, sizeof(Vertex), vertex_data + offsetof(Vertex, normal));
+}
+
+void Mesh::drawBound() const
+{
+  glDrawElements(GL_TRIANGLES, indices_.size(), GL_UNSIGNED_INT, bound_indices_);
+}
+
+void Mesh::drawBoundInstanced(GLsizei count) const
+{
+  glproc::DrawElementsInstanced(GL_TRIANGLES, indices_.size(), GL_UNSIGNED_INT, bound_indices_, count);
+}
+
+void Mesh::unbind() const
+{
+  glDisableClientState(GL_NORMAL_ARRAY);
+  glDisableClientState(GL_VERTEX_ARRAY);
+  if(bound_buffers_) {
+    glproc::BindBuffer(GL_ARRAY_BUFFER_ARB, 0);
+    glproc::BindBuffer(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+  }
+}
+
+void Mesh::releaseGL()
+{
+  if(buffers_[0] != 0) {
+    glproc::DeleteBuffers(2, buffers_);
+    buffers_[0] = buffers_[1] = 0;
+  }
+}
+
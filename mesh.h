@@ -0,0 +1,127 @@
+#ifndef MESH_H_
+#define MESH_H_
+
+///@file
+
+#include <vector>
+#include <SDL/SDL_opengl.h>
+#include "bullet.h"
+
+class Display;
+
+
+/** @brief Indexed triangle mesh
+ *
+ * Geometry is built once, then uploaded into vertex buffer objects on first
+ * draw and drawn with a single call. Client-side vertex arrays are used if
+ * buffer objects are not supported.
+ *
+ * Building methods mimic the graphics functions. Added geometry is
+ * transformed by the current transform, which plays the role of the
+ * OpenGL modelview matrix.
+ *
+ * @sa Display::drawMesh()
+ */
+class Mesh
+{
+ public:
+  struct Vertex
+  {
+    GLfloat pos[3];
+    GLfloat normal[3];
+  };
+
+  Mesh();
+  ~Mesh();
+
+  /** @name Geometry building
+   */
+  //@{
+  const btTransform& getTransform() const { return trans_; }
+  void setTransform(const btTransform& tr) { trans_ = tr; }
+  /// Apply a transform to the current transform
+  void transform(const btTransform& tr) { trans_ *= tr; }
+  /// Translate the current transform
+  void translate(const btVector3& v) { trans_ *= btTransform(btMatrix3x3::getIdentity(), v); }
+
+  /// Add a vertex, return its index
+  GLuint addVertex(const btVector3& pos, const btVector3& normal);
+  /// Add a triangle from vertex indexes, counter-clockwise
+  void addTriangle(GLuint i0, GLuint i1, GLuint i2);
+  /// Add a flat quad, counter-clockwise
+  void addQuad(const btVector3& v0, const btVector3& v1, const btVector3& v2, const btVector3& v3, const btVector3& normal);
+  /// Add a flat convex polygon, counter-clockwise
+  void addPolygon(const btVector3* v, unsigned int n, const btVector3& normal);
+
+  /** @brief Add a cylinder side
+   *
+   * Cylinder is centered around z axis, from z=0 to z=h. If \e inside is
+   * \e true, normals point inside.
+   */
+  void addCylinder(btScalar r, btScalar h, unsigned int slices, bool inside=false);
+  /// Add a disk facing z, or -z if \e down is \e true
+  void addDisk(btScalar r0, btScalar r1, btScalar z, unsigned int slices, bool down=false);
+  /// Add a cylinder with bottom and top faces
+  void addClosedCylinder(btScalar r, btScalar h, unsigned int slices);
+  /// Add a sphere centered on the origin
+  void addSphere(btScalar r, unsigned int slices, unsigned int stacks);
+  /// Add a box centered on the origin
+  void addBox(const btVector3& half_extents);
+  /// Add a closed cone, base at z=0, apex at z=h
+  void addCone(btScalar r, btScalar h, unsigned int slices, unsigned int stacks);
+
+  /** @brief Add a collision shape
+   *
+   * Children of compound shapes are added to the mesh.
+   *
+   * @param shape  shape to add
+   * @param div  slices and stacks of round shapes
+   */
+  void addShape(const btCollisionShape* shape, unsigned int div);
+  //@}
+
+  size_t getVertexCount() const { return vertices_.size(); }
+  size_t getTriangleCount() const { return indices_.size()/3; }
+  /// Size of vertex and index data, in bytes
+  size_t getDataSize() const { return vertices_.size()*sizeof(Vertex) + indices_.size()*sizeof(GLuint); }
+
+  /** @brief Draw the mesh
+   *
+   * Upload the mesh if needed. The display's context must be current.
+   * If \e d is \e NULL, client-side arrays are used (e.g. to compile the
+   * mesh into a display list).
+   */
+  void draw(const Display* d);
+
+  /** @name Repeated drawing
+   *
+   * Vertex arrays are set by bind(), the mesh can then be drawn several
+   * times (e.g. with different transforms) until unbind() is called.
+   */
+  //@{
+  /// Set vertex arrays, parameters are the same as draw()
+  void bind(const Display* d);
+  /// Draw the bound mesh
+  void drawBound() const;
+  /// Draw instances of the bound mesh, instanced drawing must be supported
+  void drawBoundInstanced(GLsizei count) const;
+  void unbind() const;
+  //@}
+
+  /// Release OpenGL resources, the mesh is uploaded again on next draw
+  void releaseGL();
+
+ private:
+  std::vector<Vertex> vertices_;
+  std::vector<GLuint> indices_;
+  btTransform trans_;
+
+  /// Vertex and index buffers, 0 if not uploaded
+  GLuint buffers_[2];
+  /// Set by bind(), \e NULL if buffers are used
+  const GLvoid* bound_indices_;
+  bool bound_buffers_;
+};
+
+
+#endif
@@ -60,11 +60,11 @@ void ODispenser::fill(Object* o, btScalar z)
   o->setPos(pos);
 }
 
-void ODispenser::drawLast(Display*) const
+void ODispenser::drawLast(Display* d) const
 {
   glColor4fv(color_);
   glPushMatrix();
-  drawTransform(m_worldTransform);
+  drawTransform(d->getDrawTrans(this));
   glTranslatef(0, 0, -HEIGHT/2);
   graphics::drawCylinder(RADIUS, HEIGHT, Display::draw_div);
   glPopMatrix();
@@ -220,12 +220,7 @@ bool Galipeur2009::Pachev::checkCollideWithOverride(btCollisionObject* co)
           btTransform tr = o->getCenterOfMassTransform().inverseTimes(getCenterOfMassTransform());
           tr.setOrigin( btVector3(0,0,tr.getOrigin().getZ()) );
 
-          btGeneric6DofConstraint* constraint = new btGeneric6DofConstraint(
-              *this, *o, btTransform::getIdentity(), tr, false);
-          for(int i=0; i<6; i++) {
-            constraint->setLimit(i, 0, 0);
-          }
-          robot_->physics_->getWorld()->addConstraint(constraint, true);
+          grabObject(o, tr);
           return false;
         }
       } break;
@@ -248,6 +243,16 @@ bool Galipeur2009::Pachev::checkCollideWithOverride(btCollisionObject* co)
   return btRigidBody::checkCollideWithOverride(co);
 }
 
+void Galipeur2009::Pachev::grabObject(btRigidBody* o, const btTransform& tr)
+{
+  btGeneric6DofConstraint* constraint = new btGeneric6DofConstraint(
+      *this, *o, btTransform::getIdentity(), tr, false);
+  for(int i=0; i<6; i++) {
+    constraint->setLimit(i, 0, 0);
+  }
+  robot_->physics_->getWorld()->addConstraint(constraint, true);
+}
+
 void Galipeur2009::addToWorld(Physics* physics)
 {
   physics->getWorld()->addRigidBody(pachev_);
@@ -264,14 +269,75 @@ void Galipeur2009::removeFromWorld()
   ph_bak->getWorld()->removeRigidBody(pachev_);
 }
 
+void Galipeur2009::saveState(StateBuffer& buf) const
+{
+  Galipeur::saveState(buf);
+  buf.write(target_pachev_pos_);
+  buf.write(pachev_state_);
+  buf.write(pachev_moving_);
+  buf.write(pachev_v_);
+  buf.write(threshold_pachev_);
+  // caught objects
+  std::vector<btGeneric6DofConstraint*> grabs;
+  getGrabs(grabs);
+  buf.write(grabs.size());
+  for(auto grab : grabs) {
+    buf.writeBody(&grab->getRigidBodyB());
+    buf.write(grab->getFrameOffsetB());
+  }
+}
+
+void Galipeur2009::restoreState(StateBuffer& buf)
+{
+  Galipeur::restoreState(buf);
+  buf.read(target_pachev_pos_);
+  buf.read(pachev_state_);
+  buf.read(pachev_moving_);
+  buf.read(pachev_v_);
+  buf.read(threshold_pachev_);
+
+  size_t n;
+  buf.read(n);
+  std::vector<std::pair<btRigidBody*, btTransform>> objects(n);
+  for(size_t i=0; i<n; i++) {
+    objects[i].first = static_cast<btRigidBody*>(buf.readBody());
+    buf.read(objects[i].second);
+  }
+
+  // only grab objects again if they changed
+  std::vector<btGeneric6DofConstraint*> grabs;
+  getGrabs(grabs);
+  bool changed = grabs.size() != n;
+  for(size_t i=0; !changed && i<n; i++) {
+    changed = &grabs[i]->getRigidBodyB() != objects[i].first ||
+        !(grabs[i]->getFrameOffsetB() == objects[i].second);
+  }
+  if(changed) {
+    releaseObjects();
+    for(auto& o : objects) {
+      pachev_->grabObject(o.first, o.second);
+    }
+  }
+}
+
+void Galipeur2009::getGrabs(std::vector<btGeneric6DofConstraint*>& grabs) const
+{
+  for(int i=0; i < pachev_->getNumConstraintRefs(); i++) {
+    btTypedConstraint* constraint = pachev_->getConstraintRef(i);
+    if(constraint != pachev_link_) {
+      grabs.push_back(static_cast<btGeneric6DofConstraint*>(constraint));
+    }
+  }
+}
+
 void Galipeur2009::draw(Display* d) const
 {
   Galipeur::draw(d);
 
   glPushMatrix();
-  drawTransform(pachev_->getCenterOfMassTransform());
+  drawTransform(d->getDrawTrans(pachev_));
   btglScale(Pachev::WIDTH, Pachev::WIDTH, Pachev::HEIGHT);
-  glutWireCube(1.0);
+  graphics::drawWireCube(1.0);
   glPopMatrix();
 }
 
@@ -280,6 +346,7 @@ void Galipeur2009::setTrans(const btTransform& tr)
 {
   body_->setCenterOfMassTransform(tr);
   pachev_->resetTrans();
+  markMoved();
 }
 
 void Galipeur2009::Pachev::resetTrans()
@@ -55,6 +55,7 @@ class ODispenser: public OSimple
 
   void draw(Display*) const {}
   void drawLast(Display* d) const;
+  bool isTransparent() const { return true; }
 
   /** @brief Collision check to disable collision with stored items
    *
@@ -111,6 +112,8 @@ class Galipeur2009: public Galipeur
 
   virtual void addToWorld(Physics* physics);
   virtual void removeFromWorld();
+  virtual void saveState(StateBuffer& buf) const;
+  virtual void restoreState(StateBuffer& buf);
 
   /** @brief Draw the robot
    *
@@ -118,6 +121,8 @@ class Galipeur2009: public Galipeur
    * world's Z axis).
    */
   virtual void draw(Display* d) const;
+  /// Pàchev is drawn apart from the main body
+  virtual bool getDrawAabb(const Display*, btVector3&, btVector3&) const { return false; }
 
   virtual void setTrans(const btTransform& tr);
 
@@ -174,6 +179,12 @@ class Galipeur2009: public Galipeur
    protected:
     /// Reset pàchev's transform according to robot's transform
     void resetTrans();
+    /** @brief Constrain a caught object
+     *
+     * @param o   caught object
+     * @param tr  pàchev transform in the object's referential
+     */
+    void grabObject(btRigidBody* o, const btTransform& tr);
 
    private:
     static btBoxShape shape_;
@@ -185,6 +196,8 @@ class Galipeur2009: public Galipeur
 
   /// Release constraints on caught objects
   void releaseObjects();
+  /// Get constraints on caught objects
+  void getGrabs(std::vector<btGeneric6DofConstraint*>& grabs) const;
 
   /// Pachev states
   enum PachevState {
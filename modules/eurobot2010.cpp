@@ -69,7 +69,7 @@ ORaisedZone::ORaisedZone()
 void ORaisedZone::draw(Display* d) const
 {
   glPushMatrix();
-  drawTransform(getTrans());
+  drawTransform(d->getDrawTrans(this));
 
   if(d->callOrCreateDisplayList(this)) {
     // There should not have several instances, thus we do not really need to
@@ -1,6 +1,8 @@
 #include <cassert>
+#include <algorithm>
 #include "modules/eurobot2011.h"
 #include "display.h"
+#include "physics.h"
 #include "log.h"
 
 namespace eurobot2011 {
@@ -97,6 +99,7 @@ void OGround2011::drawDisplayList() const
 
 const btScalar Magnet::RADIUS = 0.02_m; //note: must be < MagnetPawn::HEIGHT/2
 btSphereShape Magnet::shape_(RADIUS);
+const CollisionFilterInt Magnet::COLLISION_FILTER = COLLISION_MAGNET;
 // User defined constraint type for magnet joints.
 #define EUROBOT2011_MAGNET_CONSTRAINT_TYPE  (0x20110001)
 
@@ -125,6 +128,7 @@ void Magnet::enable(Physics* ph)
     throw(Error("magnet is already enabled"));
   }
   physics_ = ph;
+  physics_->getContacts().subscribe(this, this, ContactEvent::BEGIN|ContactEvent::PERSIST);
 }
 
 void Magnet::disable()
@@ -140,44 +144,108 @@ void Magnet::disable()
       delete constraint;
     }
   }
+  physics_->getContacts().unsubscribe(this);
   physics_ = NULL;
 }
 
-bool Magnet::checkCollideWithOverride(btCollisionObject* co)
+void Magnet::onContact(const ContactEvent& ev)
 {
   if(!enabled()) {
-    return false;
+    return;
   }
-
-  //XXX use collision flags or something to avoid dynamic_cast
-  //XXX This callback is used to detect magnets close from each other, not to
-  // known whether an object should collide. They may be a more appropriated
-  // way to do this.
-  Magnet* o = dynamic_cast<Magnet*>(co);
-  if(!o || !o->enabled()) {
-    return false;
+  // magnets share their shape, use it to identify them
+  const btCollisionObject* co = ev.body_a == this ? ev.body_b : ev.body_a;
+  if(co->getCollisionShape() != &shape_) {
+    return;
+  }
+  Magnet* o = static_cast<Magnet*>(const_cast<btCollisionObject*>(co));
+  if(!o->enabled()) {
+    return;
   }
   // check if objects are close enough
   const btScalar d = (getCenterOfMassTransform().getOrigin() - o->getCenterOfMassTransform().getOrigin()).length();
   if(d > 2*RADIUS) {
-    return false;
+    return;
   }
 
   // check if object is already constrained
   for(int i=0; i < getNumConstraintRefs(); i++) {
     btTypedConstraint* constraint = getConstraintRef(i);
     if(o == &constraint->getRigidBodyA() || o == &constraint->getRigidBodyB()) {
-      return false;
+      return;
     }
   }
 
-  // new constraint
+  link(o);
+}
+
+void Magnet::link(Magnet* o)
+{
   btGeneric6DofConstraint* constraint = new btGeneric6DofConstraint(
       *this, *o, btTransform::getIdentity(), btTransform::getIdentity(), true);
   constraint->setUserConstraintType(EUROBOT2011_MAGNET_CONSTRAINT_TYPE);
   physics_->getWorld()->addConstraint(constraint, true);
+}
+
+void Magnet::saveState(StateBuffer& buf) const
+{
+  buf.write(enabled());
+  // grabbed magnets, only constraints created by this magnet are saved
+  std::vector<const btCollisionObject*> linked;
+  Magnet* self = const_cast<Magnet*>(this);
+  for(int i=0; i < getNumConstraintRefs(); i++) {
+    btTypedConstraint* constraint = self->getConstraintRef(i);
+    if(constraint->getUserConstraintType() == EUROBOT2011_MAGNET_CONSTRAINT_TYPE &&
+       &constraint->getRigidBodyA() == this) {
+      linked.push_back(&constraint->getRigidBodyB());
+    }
+  }
+  buf.write(linked.size());
+  for(auto co : linked) {
+    buf.writeBody(co);
+  }
+}
+
+void Magnet::restoreState(StateBuffer& buf)
+{
+  bool enabled;
+  buf.read(enabled);
+  size_t n;
+  buf.read(n);
+  std::vector<Magnet*> linked(n);
+  for(size_t i=0; i<n; i++) {
+    linked[i] = static_cast<Magnet*>(buf.readBody());
+  }
+
+  // release objects which were not grabbed, keep the other links
+  // only links which actually changed are updated (restore is called often
+  // when replaying a journal)
+  Physics* ph = buf.getPhysics();
+  for(int i=getNumConstraintRefs()-1; i>=0; i--) {
+    btTypedConstraint* constraint = getConstraintRef(i);
+    if(constraint->getUserConstraintType() == EUROBOT2011_MAGNET_CONSTRAINT_TYPE &&
+       &constraint->getRigidBodyA() == this) {
+      auto it = std::find(linked.begin(), linked.end(), &constraint->getRigidBodyB());
+      if(it != linked.end()) {
+        linked.erase(it);
+      } else {
+        ph->getWorld()->removeConstraint(constraint);
+        delete constraint;
+      }
+    }
+  }
 
-  return false;
+  if(enabled != this->enabled()) {
+    if(enabled) {
+      ph->getContacts().subscribe(this, this, ContactEvent::BEGIN|ContactEvent::PERSIST);
+    } else {
+      ph->getContacts().unsubscribe(this);
+    }
+  }
+  physics_ = enabled ? ph : NULL;
+  for(auto o : linked) {
+    link(o);
+  }
 }
 
 
@@ -197,7 +265,7 @@ void MagnetPawn::addToWorld(Physics* physics)
 {
   OSimple::addToWorld(physics);
   for(int i=0; i<2; i++) {
-    physics_->getWorld()->addRigidBody(&magnets_[i]);
+    physics_->getWorld()->addRigidBody(&magnets_[i], Magnet::COLLISION_FILTER, Magnet::COLLISION_FILTER);
     btTransform tr = btTransform::getIdentity();
     tr.getOrigin().setZ( (i==0 ? +1 : -1) * HEIGHT/2 );
     magnet_links_[i] = new btGeneric6DofConstraint(*this, magnets_[i], tr, btTransform::getIdentity(), true);
@@ -218,6 +286,20 @@ void MagnetPawn::removeFromWorld()
   OSimple::removeFromWorld();
 }
 
+void MagnetPawn::saveState(StateBuffer& buf) const
+{
+  OSimple::saveState(buf);
+  magnets_[0].saveState(buf);
+  magnets_[1].saveState(buf);
+}
+
+void MagnetPawn::restoreState(StateBuffer& buf)
+{
+  OSimple::restoreState(buf);
+  magnets_[0].restoreState(buf);
+  magnets_[1].restoreState(buf);
+}
+
 void MagnetPawn::setTrans(const btTransform& tr)
 {
   OSimple::setTrans(tr);
@@ -264,6 +346,24 @@ void Galipeur2011::removeFromWorld()
   Galipeur::removeFromWorld();
 }
 
+void Galipeur2011::saveState(StateBuffer& buf) const
+{
+  Galipeur::saveState(buf);
+  buf.write(arm_av_);
+  for(unsigned int i=0; i<GALIPEUR2011_ARM_NB; i++) {
+    arms_[i]->magnet_.saveState(buf);
+  }
+}
+
+void Galipeur2011::restoreState(StateBuffer& buf)
+{
+  Galipeur::restoreState(buf);
+  buf.read(arm_av_);
+  for(unsigned int i=0; i<GALIPEUR2011_ARM_NB; i++) {
+    arms_[i]->magnet_.restoreState(buf);
+  }
+}
+
 
 void Galipeur2011::draw(Display* d) const
 {
@@ -382,11 +482,8 @@ void Galipeur2011::PawnArm::asserv()
 void Galipeur2011::PawnArm::draw(Display* d) const
 {
   glPushMatrix();
-  drawTransform(getCenterOfMassTransform());
-  if(d->callOrCreateDisplayList(&PawnArm::shape_)) {
-    Object::drawShape(&PawnArm::shape_);
-    d->endDisplayList();
-  }
+  drawTransform(d->getDrawTrans(this));
+  d->drawShape(&PawnArm::shape_);
   glPopMatrix();
 }
 
@@ -405,7 +502,7 @@ void Galipeur2011::PawnArm::addToWorld()
 {
   btDynamicsWorld* world = robot_->physics_->getWorld();
   world->addRigidBody(this);
-  world->addRigidBody(&magnet_);
+  world->addRigidBody(&magnet_, Magnet::COLLISION_FILTER, Magnet::COLLISION_FILTER);
   world->addConstraint(robot_link_, true);
   world->addConstraint(magnet_link_, true);
   magnet_.enable(robot_->physics_);
@@ -7,6 +7,7 @@
 
 #include "object.h"
 #include "galipeur.h"
+#include "contacts.h"
 
 namespace eurobot2011 {
 
@@ -29,13 +30,19 @@ class OGround2011: public OGroundSquareStart
 /** @brief Pawn magnet
  *
  * Physics provided to enable() is only used to store the physical world of
- * constraints in order to create or release them.
+ * constraints in order to create or release them, and to subscribe to
+ * contact events.
  * Enabling or disabling the magnet does not add or remove it from the world.
+ *
+ * Magnets only collide with other magnets, using a dedicated collision
+ * filter group. They link when they touch.
  */
-class Magnet: public btRigidBody
+class Magnet: public btRigidBody, public ContactListener
 {
  public:
   static const btScalar RADIUS;
+  /// Collision filter group and mask of magnets
+  static const CollisionFilterInt COLLISION_FILTER;
 
   Magnet();
   ~Magnet();
@@ -46,8 +53,19 @@ class Magnet: public btRigidBody
   /// Release all objects, disable object grabbing
   void disable();
 
-  virtual bool checkCollideWithOverride(btCollisionObject* co);
+  /// Link to enabled magnets in contact
+  virtual void onContact(const ContactEvent& ev);
+
+  /** @brief Save magnet state, for snapshots
+   *
+   * Save whether the magnet is enabled and objects it grabbed.
+   */
+  void saveState(StateBuffer& buf) const;
+  void restoreState(StateBuffer& buf);
  protected:
+  /// Grab another magnet
+  void link(Magnet* o);
+
   static btSphereShape shape_;
   Physics* physics_; ///< Physical world, \e NULL if disabled
 };
@@ -69,6 +87,8 @@ class MagnetPawn: public OSimple
   virtual ~MagnetPawn();
   virtual void addToWorld(Physics* physics);
   virtual void removeFromWorld();
+  virtual void saveState(StateBuffer& buf) const;
+  virtual void restoreState(StateBuffer& buf);
   virtual void setTrans(const btTransform& tr);
  private:
   Magnet magnets_[2];
@@ -90,7 +110,11 @@ class Galipeur2011: public Galipeur
 
   virtual void addToWorld(Physics* physics);
   virtual void removeFromWorld();
+  virtual void saveState(StateBuffer& buf) const;
+  virtual void restoreState(StateBuffer& buf);
   virtual void draw(Display* d) const;
+  /// Arms are drawn apart from the main body
+  virtual bool getDrawAabb(const Display*, btVector3&, btVector3&) const { return false; }
   virtual void setTrans(const btTransform& tr);
   /// Handle arm moves
   virtual void asserv();
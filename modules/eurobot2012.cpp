@@ -134,7 +134,7 @@ void OBullion::draw(Display* d) const
 {
   glColor4fv(color_);
   glPushMatrix();
-  drawTransform(m_worldTransform);
+  drawTransform(d->getDrawTrans(this));
 
   if(d->callOrCreateDisplayList(m_collisionShape)) {
     // same values as in constructor
@@ -218,31 +218,17 @@ OCoin::OCoin(bool white)
 
 void OCoin::draw(Display* d) const
 {
-  glPushMatrix();
-
-  drawTransform(m_worldTransform);
-  glColor4fv(color_);
-
-  if(d->callOrCreateDisplayList(m_collisionShape)) {
+  d->drawMeshInstance(m_collisionShape, [](Mesh& mesh) {
     // disc: outer/inner cylinders, bottom/bottom disks
-    btglTranslate(0, 0, -DISC_HEIGHT/2);
-    GLUquadric* quadric = gluNewQuadric();
-    gluCylinder(quadric, RADIUS, RADIUS, DISC_HEIGHT, Display::draw_div, 1);
-    gluQuadricOrientation(quadric, GLU_INSIDE);
-    gluCylinder(quadric, INNER_RADIUS, INNER_RADIUS, DISC_HEIGHT, Display::draw_div/2, 1);
-    gluDisk(quadric, INNER_RADIUS, RADIUS, Display::draw_div, 1);
-    gluQuadricOrientation(quadric, GLU_OUTSIDE);
-    btglTranslate(0, 0, DISC_HEIGHT);
-    gluDisk(quadric, INNER_RADIUS, RADIUS, Display::draw_div, 1);
-    gluDeleteQuadric(quadric);
+    mesh.translate(btVector3(0, 0, -DISC_HEIGHT/2));
+    mesh.addCylinder(RADIUS, DISC_HEIGHT, Display::draw_div);
+    mesh.addCylinder(INNER_RADIUS, DISC_HEIGHT, Display::draw_div/2, true);
+    mesh.addDisk(INNER_RADIUS, RADIUS, 0, Display::draw_div, true);
+    mesh.addDisk(INNER_RADIUS, RADIUS, DISC_HEIGHT, Display::draw_div);
     // cube
-    btglTranslate(CUBE_OFFSET+CUBE_SIZE/2, 0, -DISC_HEIGHT-CUBE_SIZE/2);
-    glutSolidCube(CUBE_SIZE);
-
-    d->endDisplayList();
-  }
-
-  glPopMatrix();
+    mesh.translate(btVector3(CUBE_OFFSET+CUBE_SIZE/2, 0, -CUBE_SIZE/2));
+    mesh.addBox(btVector3(CUBE_SIZE, CUBE_SIZE, CUBE_SIZE)/2);
+  }, color_, d->getDrawTrans(this));
 }
 
 
@@ -164,7 +164,7 @@ OCake::OCake()
 void OCake::draw(Display* d) const
 {
   glPushMatrix();
-  drawTransform(m_worldTransform);
+  drawTransform(d->getDrawTrans(this));
 
   if(d->callOrCreateDisplayList(this)) {
     glColor4fv(color_); // color should not change, ok to be in display list
@@ -232,7 +232,7 @@ void OCake::draw(Display* d) const
 void OCake::drawLast(Display* d) const
 {
   glPushMatrix();
-  drawTransform(m_worldTransform);
+  drawTransform(d->getDrawTrans(this));
 
   if(d->callOrCreateDisplayList(&shape_basket_)) {
     glColor4fv(Color4::plexi);
@@ -396,39 +396,20 @@ OGlass::OGlass()
 
 void OGlass::draw(Display* d) const
 {
-  glPushMatrix();
-  drawTransform(m_worldTransform);
-
-  if(d->callOrCreateDisplayList(&shape_bottom_)) {
-    glColor4fv(Color4::black);
-    btglTranslate(0, 0, (BOTTOM_HEIGHT-HEIGHT)/2);
-    drawShape(&shape_bottom_);
-
-    d->endDisplayList();
-  }
-
-  glPopMatrix();
+  const btTransform bottom_trans(btMatrix3x3::getIdentity(), btVector3(0, 0, (BOTTOM_HEIGHT-HEIGHT)/2));
+  d->drawShapeInstance(&shape_bottom_, Color4::black, d->getDrawTrans(this) * bottom_trans);
 }
 
 void OGlass::drawLast(Display* d) const
 {
-  glPushMatrix();
-  drawTransform(m_worldTransform);
-
-  if(d->callOrCreateDisplayList(shape_)) {
-    glColor4fv(Color4::plexi);
-    btglTranslate(0, 0, -(HEIGHT-BOTTOM_HEIGHT)/2);
-    drawShape(&shape_bottom_);
-
+  d->drawMeshInstance(shape_, [](Mesh& mesh) {
+    mesh.translate(btVector3(0, 0, -(HEIGHT-BOTTOM_HEIGHT)/2));
+    mesh.addShape(&shape_bottom_, Display::draw_div);
     // outer / inner / top
-    graphics::drawCylinder(RADIUS, HEIGHT, Display::draw_div);
-    graphics::drawCylinder(INNER_RADIUS, HEIGHT, Display::draw_div);
-    graphics::drawDisk(INNER_RADIUS, RADIUS, HEIGHT, Display::draw_div);
-
-    d->endDisplayList();
-  }
-
-  glPopMatrix();
+    mesh.addCylinder(RADIUS, HEIGHT, Display::draw_div);
+    mesh.addCylinder(INNER_RADIUS, HEIGHT, Display::draw_div, true);
+    mesh.addDisk(INNER_RADIUS, RADIUS, HEIGHT, Display::draw_div);
+  }, Color4::plexi, d->getDrawTrans(this));
 }
 
 
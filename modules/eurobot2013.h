@@ -56,6 +56,7 @@ class OCake: public OSimple
   OCake();
   virtual void draw(Display* d) const;
   virtual void drawLast(Display* d) const;
+  virtual bool isTransparent() const { return true; }
 
  private:
   static SmartPtr<btCompoundShape> shape_;
@@ -95,6 +96,8 @@ class OGiftSupport: public OSimple
   virtual void addToWorld(Physics* physics);
   virtual void removeFromWorld();
   virtual void draw(Display* d) const;
+  /// Gifts are drawn with the support
+  virtual bool getDrawAabb(const Display*, btVector3&, btVector3&) const { return false; }
 
  private:
   static SmartPtr<btCompoundShape> shape_;
@@ -122,6 +125,7 @@ class OGlass: public OSimple
 
   virtual void draw(Display* d) const;
   virtual void drawLast(Display* d) const;
+  virtual bool isTransparent() const { return true; }
 
  private:
   static SmartPtr<btCompoundShape> shape_;
@@ -157,6 +161,8 @@ class OCandle: public OSimple
   virtual void addToWorld(Physics* physics);
   virtual void removeFromWorld();
   virtual void draw(Display* d) const;
+  /// Flame is drawn with the candle
+  virtual bool getDrawAabb(const Display*, btVector3&, btVector3&) const { return false; }
 
  private:
   static SmartPtr<btCylinderShapeZ> shape_;
@@ -15,87 +15,15 @@ void Object::drawTransform(const btTransform& transform)
 
 void Object::drawShape(const btCollisionShape* shape)
 {
-  glPushMatrix();
-  switch(shape->getShapeType()) {
-    case COMPOUND_SHAPE_PROXYTYPE: {
-      const btCompoundShape* compound_shape = static_cast<const btCompoundShape*>(shape);
-      for(int i=compound_shape->getNumChildShapes()-1; i>=0; i--) {
-        glPushMatrix();
-        drawTransform(compound_shape->getChildTransform(i));
-        drawShape(compound_shape->getChildShape(i));
-        glPopMatrix();
-      }
-    } break;
-
-    case SPHERE_SHAPE_PROXYTYPE: {
-      const btSphereShape* sphere_shape = static_cast<const btSphereShape*>(shape);
-      glutSolidSphere(sphere_shape->getRadius(), Display::draw_div, Display::draw_div);
-    } break;
-
-    case BOX_SHAPE_PROXYTYPE: {
-      const btBoxShape* box_shape = static_cast<const btBoxShape*>(shape);
-      const btVector3& size = box_shape->getHalfExtentsWithMargin();
-      btglScale(2*size[0], 2*size[1], 2*size[2]);
-      glutSolidCube(1.0);
-    } break;
-
-    case CAPSULE_SHAPE_PROXYTYPE: {
-      const btCapsuleShape* capsule_shape = static_cast<const btCapsuleShape*>(shape);
-      switch(capsule_shape->getUpAxis()) {
-        case 0: btglRotate(-90.0, 0.0, 1.0, 0.0); break;
-        case 1: btglRotate(-90.0, 1.0, 0.0, 0.0); break;
-        case 2: break;
-        default:
-          throw(Error("invalid capsule up axis"));
-      }
-      const btScalar r = capsule_shape->getRadius();
-      const btScalar len = capsule_shape->getHalfHeight();
-      btglTranslate(0, 0, -len);
-      graphics::drawCylinder(r, 2*len, Display::draw_div);
-      glutSolidSphere(r, Display::draw_div, Display::draw_div);
-      btglTranslate(0, 0, 2*len);
-      glutSolidSphere(r, Display::draw_div, Display::draw_div);
-    } break;
-
-    case CYLINDER_SHAPE_PROXYTYPE: {
-      const btCylinderShape* cylinder_shape = static_cast<const btCylinderShape*>(shape);
-      const int axis = cylinder_shape->getUpAxis();
-      const btScalar r = cylinder_shape->getRadius();
-      // there is not a getHalfHeight() function
-      const btVector3& size = cylinder_shape->getHalfExtentsWithMargin();
-      const btScalar len = size[axis];
-      switch(axis) {
-        case 0: btglRotate(-90.0, 0.0, 1.0, 0.0); break;
-        case 1: btglRotate(-90.0, 1.0, 0.0, 0.0); break;
-        case 2: break;
-        default:
-          throw(Error("invalid cylinder up axis"));
-      }
-      btglTranslate(0, 0, -len);
-      graphics::drawClosedCylinder(r, 2*len, Display::draw_div);
-    } break;
-
-    case CONE_SHAPE_PROXYTYPE: {
-      const btConeShape* cone_shape = static_cast<const btConeShape*>(shape);
-      const int axis = cone_shape->getConeUpIndex();
-      const btScalar r = cone_shape->getRadius();
-      const btScalar h = cone_shape->getHeight();
-      switch(axis) {
-        case 0: btglRotate(-90.0, 0.0, 1.0, 0.0); break;
-        case 1: btglRotate(-90.0, 1.0, 0.0, 0.0); break;
-        case 2: break;
-        default:
-          throw(Error("invalid cone up axis"));
-      }
-      btglTranslate(0, 0, -h/2);
-      glutSolidCone(r, h, Display::draw_div, Display::draw_div);
-    } break;
-
-    default:
-      throw(Error("drawing not supported for this geometry class"));
-      break;
-  }
-  glPopMatrix();
+  Mesh mesh;
+  mesh.addShape(shape, Display::draw_div);
+  mesh.draw(NULL);
+}
+
+Object::~Object()
+{
+  // it may still have been drawn after its removal (e.g. threaded run)
+  Display::releaseKey(this);
 }
 
 void Object::addToWorld(Physics* physics)
@@ -104,10 +32,12 @@ void Object::addToWorld(Physics* physics)
   if(physics_) {
     throw(Error("object is already in a world"));
   }
-  if(physics->getObjs().insert(this).second == false) {
+  if(world_handle_.valid()) {
     throw(Error("object added to the world twice"));
   }
+  world_handle_ = physics->getObjs().add(this);
   physics_ = physics;
+  physics->markModified();
 }
 
 void Object::removeFromWorld()
@@ -116,8 +46,57 @@ void Object::removeFromWorld()
     throw(Error("object is not in a world"));
   }
   disableTickCallback();
-  physics_->getObjs().erase(this); // should return 1
+  if(getMainBody()) {
+    physics_->getContacts().unsubscribe(getMainBody());
+  }
+  Display::releaseKey(this);
+  Physics* physics = physics_;
   physics_ = NULL;
+  physics->markModified();
+  physics->releaseProfiledObject(this);
+  // may delete the object, must be last
+  physics->getObjs().remove(world_handle_);
+}
+
+void Object::setCollisionFilter(CollisionFilterInt group, CollisionFilterInt mask)
+{
+  collision_filter_ = true;
+  collision_group_ = group;
+  collision_mask_ = mask;
+  if(physics_) {
+    const btCollisionObject* body = getMainBody();
+    if(body) {
+      physics_->setBodyCollisionFilter(const_cast<btCollisionObject*>(body), group, mask);
+    }
+    // ray filter of sensors may have changed
+    physics_->getRays().invalidate();
+  }
+}
+
+void Object::addBodyToWorld(Physics* physics, btRigidBody* body)
+{
+  if(collision_filter_) {
+    physics->getWorld()->addRigidBody(body, collision_group_, collision_mask_);
+  } else {
+    physics->getWorld()->addRigidBody(body);
+  }
+}
+
+void Object::markMoved()
+{
+  if(physics_) {
+    physics_->markModified();
+  }
+}
+
+bool Object::getDrawAabb(const Display* d, btVector3& aabb_min, btVector3& aabb_max) const
+{
+  const btCollisionObject* body = getMainBody();
+  if(body == NULL) {
+    return false;
+  }
+  body->getCollisionShape()->getAabb(d->getDrawTrans(body), aabb_min, aabb_max);
+  return true;
 }
 
 void Object::tickCallback()
@@ -130,7 +109,9 @@ void Object::enableTickCallback()
   if(!physics_) {
     throw(Error("object is not in a world"));
   }
-  physics_->getTickObjs().insert(this);
+  if(!tick_handle_.valid()) {
+    tick_handle_ = physics_->getTickObjs().add(this);
+  }
 }
 
 void Object::disableTickCallback()
@@ -138,7 +119,7 @@ void Object::disableTickCallback()
   if(!physics_) {
     throw(Error("object is not in a world"));
   }
-  physics_->getTickObjs().erase(this);
+  physics_->getTickObjs().remove(tick_handle_);
 }
 
 
@@ -200,7 +181,7 @@ void OSimple::addToWorld(Physics* physics)
   if(!isInitialized()) {
     throw(Error("object must be initialized to be added to a world"));
   }
-  physics->getWorld()->addRigidBody(this);
+  addBodyToWorld(physics, this);
   Object::addToWorld(physics);
 }
 
@@ -236,16 +217,7 @@ void OSimple::drawLast(Display* d) const
 
 void OSimple::drawObject(Display* d) const
 {
-  glColor4fv(color_);
-  glPushMatrix();
-  drawTransform(m_worldTransform);
-
-  if(d->callOrCreateDisplayList(m_collisionShape)) {
-    drawShape(m_collisionShape);
-    d->endDisplayList();
-  }
-
-  glPopMatrix();
+  d->drawShapeInstance(m_collisionShape, color_, d->getDrawTrans(this));
 }
 
 
@@ -266,7 +238,7 @@ void OGround::draw(Display* d) const
 {
   glPushMatrix();
 
-  drawTransform(m_worldTransform);
+  drawTransform(d->getDrawTrans(this));
 
   if(d->callOrCreateDisplayList(this)) {
     // Their should be only one ground instance, thus we create one display
@@ -284,7 +256,7 @@ void OGround::drawDisplayList() const
 
   glColor4fv(color_);
   btglScale(size_[0], size_[1], size_[2]);
-  glutSolidCube(1.0);
+  graphics::drawCube(1.0);
 
   glPopMatrix();
 }
@@ -5,9 +5,29 @@
 
 #include "smart.h"
 #include "colors.h"
+#include "registry.h"
 
 class Physics;
 class Display;
+class StateBuffer;
+
+
+/** @brief Collision filter groups
+ *
+ * The first groups are those of Bullet (see btBroadphaseProxy), next ones
+ * are used by simulotter. Groups from COLLISION_USER are free.
+ */
+enum CollisionGroup {
+  COLLISION_DEFAULT = btBroadphaseProxy::DefaultFilter,
+  COLLISION_STATIC = btBroadphaseProxy::StaticFilter,
+  COLLISION_KINEMATIC = btBroadphaseProxy::KinematicFilter,
+  COLLISION_DEBRIS = btBroadphaseProxy::DebrisFilter,
+  COLLISION_SENSOR_TRIGGER = btBroadphaseProxy::SensorTrigger,
+  COLLISION_CHARACTER = btBroadphaseProxy::CharacterFilter,
+  COLLISION_MAGNET = 0x40,  ///< magnets of Eurobot 2011 pawns and arms
+  COLLISION_USER = 0x100,  ///< first free group
+  COLLISION_ALL = btBroadphaseProxy::AllFilter,
+};
 
 
 /** @brief Object abstract class
@@ -15,9 +35,10 @@ class Display;
 class Object: public SmartObject
 {
  protected:
-  Object(): physics_(NULL) {}
+  Object(): physics_(NULL), collision_filter_(false),
+      collision_group_(COLLISION_DEFAULT), collision_mask_(COLLISION_ALL) {}
  public:
-  virtual ~Object() {}
+  virtual ~Object();
 
   /** @brief Add an object to a physical world
    *
@@ -36,6 +57,7 @@ class Object: public SmartObject
    * Object is removed from the physics object array, an exception is raised if
    * was not in a world array.
    * The \e physics_ member is resetted to \e NULL.
+   * Contact events of the main body are unsubscribed.
    *
    * @note Overload functions should call this parent function.
    */
@@ -48,14 +70,75 @@ class Object: public SmartObject
    * The callback is disabled until enableTickCallback() is called.
    */
   virtual void tickCallback();
+  /// Return \e true if the tick callback is enabled
+  bool isTickEnabled() const { return tick_handle_.valid(); }
+
+  /** @brief Save object internal state, for snapshots
+   *
+   * States of bodies and constraints in the world are saved by Physics.
+   * Objects only have to save additional values (e.g. asserv state) and
+   * handle constraints they may create or remove during the simulation.
+   *
+   * @note Overload functions should call this parent function.
+   * @sa Physics::snapshot()
+   */
+  virtual void saveState(StateBuffer&) const {}
+  /** @brief Restore object internal state saved with saveState()
+   *
+   * @note Overload functions should call this parent function.
+   */
+  virtual void restoreState(StateBuffer&) {}
+
+  /** @brief Return the main body of the object, or \e NULL
+   *
+   * The main body identifies the object in the world (e.g. in recorded
+   * journals). Objects with a state must define one.
+   */
+  virtual const btCollisionObject* getMainBody() const { return NULL; }
+
+  /** @name Collision filtering
+   *
+   * Two bodies collide if the group of each one matches the mask of the
+   * other. Filtering is done by the broadphase: filtered pairs have no
+   * narrowphase cost.
+   *
+   * The filter applies to the main body. Unless set, Bullet's defaults are
+   * used (e.g. static bodies do not collide together).
+   * For ray sensors, the filter applies to the rays.
+   */
+  //@{
+  /** @brief Set collision group and mask
+   *
+   * If the object is in a world, the new filter is applied to its main body
+   * immediately.
+   */
+  void setCollisionFilter(CollisionFilterInt group, CollisionFilterInt mask);
+  bool hasCollisionFilter() const { return collision_filter_; }
+  CollisionFilterInt getCollisionGroup() const { return collision_group_; }
+  CollisionFilterInt getCollisionMask() const { return collision_mask_; }
+  //@}
 
   /// Draw the whole object
   virtual void draw(Display* d) const = 0;
   /** @brief Draw last object parts
    *
    * This is used for transparent parts which have to be drawn last.
+   * It is only called if isTransparent() returns \e true.
    */
   virtual void drawLast(Display*) const {}
+  /** @brief Return true if the object has parts drawn by drawLast()
+   *
+   * Transparent objects are drawn back to front.
+   */
+  virtual bool isTransparent() const { return false; }
+  /** @brief Get the AABB of drawn parts, for frustum culling
+   *
+   * The default uses the main body, at its drawn position.
+   * Return \e false if the AABB is not known, the object is then never
+   * culled. Objects drawing parts outside their main body should override
+   * it.
+   */
+  virtual bool getDrawAabb(const Display* d, btVector3& aabb_min, btVector3& aabb_max) const;
 
   /** @name Transformation, position and rotation accessors
    */
@@ -74,8 +157,9 @@ class Object: public SmartObject
 
   /** @brief Draw a collision shape
    *
-   * @note This function is based on <em>GL_ShapeDrawer::drawOpenGL</em> method
-   * from <em>Bullet</em>'s demos.
+   * Geometry is rebuilt on each call, this function is intended to be
+   * compiled in display lists. Use Display::drawShape() to draw a cached
+   * mesh.
    */
   static void drawShape(const btCollisionShape* shape);
 
@@ -87,10 +171,29 @@ class Object: public SmartObject
    */
   Physics* physics_;
 
+  /// Add a body to a world, with the collision filter if set
+  void addBodyToWorld(Physics* physics, btRigidBody* body);
+
+  /** @brief Notify the world that the object has been moved
+   *
+   * Must be called by setTrans() implementations, so that cached ray
+   * results are not reused and displays are refreshed.
+   */
+  void markMoved();
+
   /// Enable the tick callback
   void enableTickCallback();
   /// Disable the tick callback
   void disableTickCallback();
+
+ private:
+  /// Handles in world's registries
+  RegistryHandle world_handle_;
+  RegistryHandle tick_handle_;
+
+  bool collision_filter_;
+  CollisionFilterInt collision_group_;
+  CollisionFilterInt collision_mask_;
 };
 
 
@@ -159,6 +262,7 @@ class OSimple: public Object, public btRigidBody
   virtual void draw(Display* d) const;
   /// Draw the object last, if transparent
   virtual void drawLast(Display* d) const;
+  virtual bool isTransparent() const { return color_.a() < 0.95; }
   /** @brief Draw the object, whichever the color
    *
    * This method is called by draw() and drawLast().
@@ -167,7 +271,8 @@ class OSimple: public Object, public btRigidBody
   void drawObject(Display* d) const;
 
   virtual const btTransform getTrans() const { return getCenterOfMassTransform(); }
-  virtual void setTrans(const btTransform& tr) { setCenterOfMassTransform(tr); }
+  virtual void setTrans(const btTransform& tr) { setCenterOfMassTransform(tr); markMoved(); }
+  virtual const btCollisionObject* getMainBody() const { return this; }
 
   /** @brief Place above (not on or in) the ground
    *
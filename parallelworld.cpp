@@ -0,0 +1,184 @@
+#include <cstdint>
+#include <algorithm>
+#include "parallelworld.h"
+#include "threadpool.h"
+
+
+/// Return the island of a constraint, as done by Bullet
+static int constraint_island_id(const btTypedConstraint* c)
+{
+  const btCollisionObject& a = c->getRigidBodyA();
+  const btCollisionObject& b = c->getRigidBodyB();
+  return a.getIslandTag() >= 0 ? a.getIslandTag() : b.getIslandTag();
+}
+
+static bool constraint_island_less(const btTypedConstraint* a, const btTypedConstraint* b)
+{
+  return constraint_island_id(a) < constraint_island_id(b);
+}
+
+
+/** @brief Collect islands instead of solving them
+ *
+ * Arrays given by the island manager are reused between islands, their
+ * content is copied.
+ */
+class ParallelDynamicsWorld::IslandCollector: public btSimulationIslandManager::IslandCallback
+{
+ public:
+  IslandCollector(ParallelDynamicsWorld* world): world_(world) {}
+
+  virtual void ProcessIsland(btCollisionObject** bodies, int nbodies, btPersistentManifold** manifolds, int nmanifolds, int island_id)
+  {
+    Island island;
+    island.id = island_id;
+    island.bodies_begin = world_->bodies_.size();
+    world_->bodies_.insert(world_->bodies_.end(), bodies, bodies+nbodies);
+    island.bodies_end = world_->bodies_.size();
+    island.manifolds_begin = world_->manifolds_.size();
+    world_->manifolds_.insert(world_->manifolds_.end(), manifolds, manifolds+nmanifolds);
+    island.manifolds_end = world_->manifolds_.size();
+
+    // constraints are sorted by island, -1 is used for all of them
+    const std::vector<btTypedConstraint*>& cs = world_->constraints_;
+    if(island_id < 0) {
+      island.constraints_begin = 0;
+      island.constraints_end = cs.size();
+    } else {
+      auto it = std::lower_bound(cs.begin(), cs.end(), island_id,
+                                 [](const btTypedConstraint* c, int id) { return constraint_island_id(c) < id; });
+      island.constraints_begin = it - cs.begin();
+      while(it != cs.end() && constraint_island_id(*it) == island_id) {
+        ++it;
+      }
+      island.constraints_end = it - cs.begin();
+    }
+    world_->islands_.push_back(island);
+  }
+
+ private:
+  ParallelDynamicsWorld* world_;
+};
+
+
+ParallelDynamicsWorld::ParallelDynamicsWorld(btDispatcher* dispatcher, btBroadphaseInterface* pair_cache, btConstraintSolver* solver, btCollisionConfiguration* col_config):
+    btDiscreteDynamicsWorld(dispatcher, pair_cache, solver, col_config), pool_(NULL)
+{
+}
+
+ParallelDynamicsWorld::~ParallelDynamicsWorld()
+{
+}
+
+
+void ParallelDynamicsWorld::solveConstraints(btContactSolverInfo& solverInfo)
+{
+  if(pool_ == NULL || !canSolveConcurrently()) {
+    btDiscreteDynamicsWorld::solveConstraints(solverInfo);
+    return;
+  }
+
+  constraints_.resize(m_constraints.size());
+  for(int i=0; i<m_constraints.size(); i++) {
+    constraints_[i] = m_constraints[i];
+  }
+  std::stable_sort(constraints_.begin(), constraints_.end(), constraint_island_less);
+
+  islands_.clear();
+  bodies_.clear();
+  manifolds_.clear();
+  IslandCollector collector(this);
+  getSimulationIslandManager()->buildAndProcessIslands(getDispatcher(), this, &collector);
+
+  // the calling thread solves batches too
+  const unsigned int nbatches = dispatchIslands((pool_->size()+1)*BATCHES_PER_THREAD);
+  if(nbatches == 1) {
+    solveBatch(batches_[0], solverInfo);
+  } else if(nbatches > 1) {
+    const btContactSolverInfo& info = solverInfo;
+    pool_->parallelFor(nbatches, [&](unsigned int i) { solveBatch(batches_[i], info); });
+  }
+}
+
+
+bool ParallelDynamicsWorld::canSolveConcurrently() const
+{
+  // kinematic bodies are not assigned to an island but are updated by the
+  // solver of each island they touch
+  for(int i=0; i<m_collisionObjects.size(); i++) {
+    if(m_collisionObjects[i]->isKinematicObject()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+unsigned int ParallelDynamicsWorld::dispatchIslands(unsigned int max_batches)
+{
+  const unsigned int nislands = islands_.size();
+  if(nislands == 0) {
+    return 0;
+  }
+
+  // islands are split in contiguous ranges of similar cost
+  std::vector<unsigned int> costs(nislands);
+  unsigned int total_cost = 0;
+  for(unsigned int i=0; i<nislands; i++) {
+    const Island& island = islands_[i];
+    costs[i] = 1 + (island.bodies_end - island.bodies_begin)
+        + (island.manifolds_end - island.manifolds_begin)
+        + (island.constraints_end - island.constraints_begin);
+    total_cost += costs[i];
+  }
+  const unsigned int nbatches = std::min(nislands, max_batches);
+  if(batches_.size() < nbatches) {
+    batches_.resize(nbatches);
+  }
+
+  unsigned int island = 0;
+  unsigned int cost = 0;
+  for(unsigned int i=0; i<nbatches; i++) {
+    Batch& batch = batches_[i];
+    batch.islands_begin = island;
+    // leave at least one island for each remaining batch
+    const unsigned int cost_end = (uint64_t)total_cost * (i+1) / nbatches;
+    const unsigned int island_end = nislands - (nbatches - (i+1));
+    do {
+      cost += costs[island++];
+    } while(island < island_end && cost < cost_end);
+    batch.islands_end = island;
+  }
+  return nbatches;
+}
+
+
+void ParallelDynamicsWorld::solveBatch(Batch& batch, const btContactSolverInfo& info)
+{
+  if(!batch.solver) {
+    batch.solver.reset(new btSequentialImpulseConstraintSolver());
+  }
+  batch.bodies.clear();
+  batch.manifolds.clear();
+  batch.constraints.clear();
+  for(unsigned int i=batch.islands_begin; i<batch.islands_end; i++) {
+    const Island& island = islands_[i];
+    batch.bodies.insert(batch.bodies.end(), bodies_.begin()+island.bodies_begin, bodies_.begin()+island.bodies_end);
+    batch.manifolds.insert(batch.manifolds.end(), manifolds_.begin()+island.manifolds_begin, manifolds_.begin()+island.manifolds_end);
+    batch.constraints.insert(batch.constraints.end(), constraints_.begin()+island.constraints_begin, constraints_.begin()+island.constraints_end);
+  }
+  if(batch.bodies.empty()) {
+    return;
+  }
+
+  batch.solver->solveGroup(
+      &batch.bodies[0], batch.bodies.size(),
+      batch.manifolds.empty() ? NULL : &batch.manifolds[0], batch.manifolds.size(),
+      batch.constraints.empty() ? NULL : &batch.constraints[0], batch.constraints.size(),
+      info, NULL,
+#if BT_BULLET_VERSION < 282
+      NULL,
+#endif
+      getDispatcher());
+}
+
@@ -0,0 +1,85 @@
+#ifndef PARALLELWORLD_H_
+#define PARALLELWORLD_H_
+
+///@file
+
+#include <vector>
+#include <memory>
+#include "smart.h"
+
+class ThreadPool;
+
+
+/** @brief Dynamics world with islands solved in parallel
+ *
+ * When a thread pool is set, simulation islands are dispatched into
+ * batches which are solved concurrently, each one with its own solver.
+ * Otherwise, the parent implementation is used.
+ *
+ * Islands do not share any dynamic body, the result of solving an island
+ * does not depend on other islands. Batches only depend on islands and on
+ * the thread count: results are deterministic for a fixed thread count.
+ *
+ * Kinematic bodies may be shared between islands and updated by the
+ * solver. Islands are solved sequentially when the world contains
+ * kinematic bodies.
+ */
+class ParallelDynamicsWorld: public btDiscreteDynamicsWorld
+{
+ public:
+  ParallelDynamicsWorld(btDispatcher* dispatcher, btBroadphaseInterface* pair_cache, btConstraintSolver* solver, btCollisionConfiguration* col_config);
+  virtual ~ParallelDynamicsWorld();
+
+  /// Set the pool used to solve islands, \e NULL to solve sequentially
+  void setThreadPool(ThreadPool* pool) { pool_ = pool; }
+  ThreadPool* getThreadPool() const { return pool_; }
+
+ protected:
+  virtual void solveConstraints(btContactSolverInfo& solverInfo);
+
+ private:
+  /// Number of batches per pool thread, to balance the load
+  static const unsigned int BATCHES_PER_THREAD = 4;
+
+  /// Island data, as ranges in collected arrays
+  struct Island
+  {
+    int id;
+    unsigned int bodies_begin, bodies_end;
+    unsigned int manifolds_begin, manifolds_end;
+    unsigned int constraints_begin, constraints_end;
+  };
+
+  /** @brief Island batch, solved by a single thread
+   *
+   * Batches are kept between steps to reuse their solver and buffers.
+   */
+  struct Batch
+  {
+    unsigned int islands_begin, islands_end;
+    std::unique_ptr<btSequentialImpulseConstraintSolver> solver;
+    std::vector<btCollisionObject*> bodies;
+    std::vector<btPersistentManifold*> manifolds;
+    std::vector<btTypedConstraint*> constraints;
+  };
+
+  class IslandCollector;
+
+  /// Return \e true if islands can be solved concurrently
+  bool canSolveConcurrently() const;
+  /// Split collected islands into batches, return the batch count
+  unsigned int dispatchIslands(unsigned int max_batches);
+  /// Solve the islands of a batch
+  void solveBatch(Batch& batch, const btContactSolverInfo& info);
+
+  ThreadPool* pool_;
+  std::vector<Island> islands_;
+  std::vector<btCollisionObject*> bodies_;
+  std::vector<btPersistentManifold*> manifolds_;
+  /// Constraints, sorted by island
+  std::vector<btTypedConstraint*> constraints_;
+  std::vector<Batch> batches_;
+};
+
+
+#endif
@@ -1,6 +1,11 @@
 #include <cstring>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
 #include "physics.h"
 #include "object.h"
+#include "record.h"
+#include "profiler.h"
 #include "log.h"
 
 
@@ -9,21 +14,56 @@ btScalar Physics::margin_epsilon = 0.001_m;
 btVector3 Physics::world_aabb_min = btVector3(-10.0_m,-5.0_m,-2.0_m);
 btVector3 Physics::world_aabb_max = btVector3(10.0_m,5.0_m,2.0_m);
 unsigned int Physics::world_objects_max = 300;
+const unsigned int Physics::AXIS_SWEEP_MAX_OBJECTS;
 
 
-Physics::Physics(btScalar step_dt): step_dt_(0), time_(0)
+/** @brief Bullet world of Physics instances
+ *
+ * Grow the broadphase before adding an object when it is full.
+ */
+class Physics::World: public ProfiledDynamicsWorld
+{
+ public:
+  World(Physics* physics, btDispatcher* dispatcher, btBroadphaseInterface* pair_cache, btConstraintSolver* solver, btCollisionConfiguration* col_config):
+      ProfiledDynamicsWorld(dispatcher, pair_cache, solver, col_config), physics_(physics) {}
+
+  virtual void addCollisionObject(btCollisionObject* co, CollisionFilterInt group, CollisionFilterInt mask)
+  {
+    const unsigned int capacity = physics_->broadphase_capacity_;
+    if(capacity > 0 && (unsigned int)getNumCollisionObjects() >= capacity) {
+      physics_->growBroadphase();
+    }
+    ProfiledDynamicsWorld::addCollisionObject(co, group, mask);
+  }
+
+ private:
+  Physics* physics_;
+};
+
+
+Physics::Physics(btScalar step_dt, BroadphaseType broadphase):
+    rays_(this), step_dt_(0), step_index_(0), time_(0), revision_(0), profiling_(false)
 {
   if(step_dt <= 0) {
     throw(Error("invalid step_dt value"));
   }
   step_dt_ = step_dt;
 
+  broadphase_type_ = broadphase;
+  broadphase_capacity_ = 0;
+  if(broadphase != BROADPHASE_DBVT) {
+    broadphase_capacity_ = std::max(world_objects_max, 2u);
+    if(broadphase == BROADPHASE_AXIS_SWEEP) {
+      broadphase_capacity_ = std::min(broadphase_capacity_, AXIS_SWEEP_MAX_OBJECTS);
+    }
+  }
+
   col_config_ = new btDefaultCollisionConfiguration();
   dispatcher_ = new btCollisionDispatcher(col_config_);
-  broadphase_ = new btAxisSweep3(world_aabb_min, world_aabb_max, world_objects_max);
+  broadphase_ = createBroadphase(broadphase_type_, broadphase_capacity_);
   solver_ = new btSequentialImpulseConstraintSolver();
 
-  world_ = new btDiscreteDynamicsWorld(
+  world_ = new World(this,
       dispatcher_, broadphase_, solver_, col_config_
       );
   world_->setGravity(btVector3(0,0,-world_gravity));
@@ -32,12 +72,12 @@ Physics::Physics(btScalar step_dt): step_dt_(0), time_(0)
 
 Physics::~Physics()
 {
-  tick_objs_.clear();
+  recorder_.reset();
 
-  // removeFromWorld() modify the set, don't use an iterator
+  // removeFromWorld() modify the registry, don't use an iterator
   while(!objs_.empty()) {
     // keep a reference to avoid deleting the object during the call
-    SmartPtr<Object> obj = *objs_.begin();
+    SmartPtr<Object> obj = objs_.back();
     obj->removeFromWorld();
   }
   delete world_;
@@ -49,26 +89,264 @@ Physics::~Physics()
 
 
 void Physics::step()
+{
+  Profiler* profiler = profiling_ ? profiler_.get() : NULL;
+  Profiler::Clock::time_point start;
+  if(profiler) {
+    start = Profiler::Clock::now();
+  }
+
+  if(recorder_) {
+    recorder_->recordChanges();
+  }
+
+  {
+    Profiler::Timer timer(profiler, Profiler::PHASE_SIMULATION);
+    simulateStep();
+  }
+
+  if(recorder_) {
+    recorder_->recordSimulation();
+  }
+
+  // Scheduled tasks
+  // tasks may schedule other tasks for the current step, they are executed
+  // in the same loop
+  unsigned int ntasks = 0;
+  {
+    Profiler::Timer timer(profiler, Profiler::PHASE_TASKS);
+    task_wheel_.advance(step_index_);
+    SmartPtr<TaskPhysics> task;
+    while(task_wheel_.popReady(task)) {
+      task->process(this);
+      ntasks++;
+    }
+  }
+
+  if(ntasks > 0) {
+    revision_++;  // tasks may modify anything
+  }
+
+  if(recorder_) {
+    recorder_->recordTasks(ntasks);
+  }
+
+  if(profiler) {
+    profiler->addPhase(Profiler::PHASE_STEP, Profiler::elapsed(start));
+    profiler->endStep(ntasks);
+  }
+}
+
+void Physics::simulateStep()
 {
   //XXX Simulation goes smoother with several 1-substep calls than with 1
   // several-substep-call. Yes, it's a bit strange.
   world_->stepSimulation(step_dt_, 0, step_dt_);
-  time_ += step_dt_;
+  step_index_++;
+  time_ = step_index_ * step_dt_;
+}
 
-  // Scheduled tasks
-  while(!task_queue_.empty() && task_queue_.top().first <= time_) {
-    // the task may push other tasks
-    // popping after processing may pop one of these tasks
-    SmartPtr<TaskPhysics> task = task_queue_.top().second;
-    task_queue_.pop();
-    task->process(this);
+void Physics::stepMany(unsigned int n)
+{
+  for(unsigned int i=0; i<n; i++) {
+    step();
+  }
+}
+
+void Physics::runUntil(btScalar time)
+{
+  while(time_ + step_dt_/2 < time) {
+    step();
   }
 }
 
 
 void Physics::scheduleTask(TaskPhysics* task, btScalar time)
 {
-  task_queue_.push( TaskQueueValue(time, SmartPtr<TaskPhysics>(task)) );
+  task_wheel_.schedule(task, timeToStep(time), time);
+}
+
+uint64_t Physics::timeToStep(btScalar time) const
+{
+  if(time <= 0) {
+    return 0;
+  }
+  const btScalar n = std::ceil(time / step_dt_);
+  if(!(n < (btScalar)(UINT64_MAX/2))) {
+    return UINT64_MAX/2;
+  }
+  // fix rounding errors, time is computed as in simulateStep()
+  uint64_t index = (uint64_t)n;
+  while(index > 0 && (index-1) * step_dt_ >= time) {
+    index--;
+  }
+  while(index * step_dt_ < time) {
+    index++;
+  }
+  return index;
+}
+
+void Physics::setStepIndex(uint64_t index)
+{
+  if(index == step_index_) {
+    return;
+  }
+  step_index_ = index;
+  time_ = step_index_ * step_dt_;
+  // reschedule tasks relatively to the new step
+  std::vector<TaskWheel::Entry> tasks;
+  task_wheel_.getEntries(tasks);
+  task_wheel_.reset(step_index_ + 1);
+  for(auto& entry : tasks) {
+    task_wheel_.schedule(entry.task, entry.step, entry.time);
+  }
+}
+
+btBroadphaseInterface* Physics::createBroadphase(BroadphaseType type, unsigned int capacity)
+{
+  switch(type) {
+    case BROADPHASE_AXIS_SWEEP:
+      return new btAxisSweep3(world_aabb_min, world_aabb_max, capacity);
+    case BROADPHASE_AXIS_SWEEP_32:
+      return new bt32BitAxisSweep3(world_aabb_min, world_aabb_max, capacity);
+    case BROADPHASE_DBVT:
+      return new btDbvtBroadphase();
+  }
+  throw(Error("invalid broadphase type"));
+}
+
+btBroadphaseProxy* Physics::createProxy(btBroadphaseInterface* broadphase, btCollisionObject* co, CollisionFilterInt group, CollisionFilterInt mask)
+{
+  btVector3 aabb_min, aabb_max;
+  co->getCollisionShape()->getAabb(co->getWorldTransform(), aabb_min, aabb_max);
+  return broadphase->createProxy(
+      aabb_min, aabb_max, co->getCollisionShape()->getShapeType(), co, group, mask,
+#if BT_BULLET_VERSION < 285
+      dispatcher_, NULL);
+#else
+      dispatcher_);
+#endif
+}
+
+void Physics::setBodyCollisionFilter(btCollisionObject* co, CollisionFilterInt group, CollisionFilterInt mask)
+{
+  btBroadphaseProxy* proxy = co->getBroadphaseHandle();
+  if(proxy == NULL) {
+    return;
+  }
+  // pairs are not filtered again, the proxy is recreated to find new ones
+  broadphase_->getOverlappingPairCache()->cleanProxyFromPairs(proxy, dispatcher_);
+  broadphase_->destroyProxy(proxy, dispatcher_);
+  co->setBroadphaseHandle(createProxy(broadphase_, co, group, mask));
+  world_->updateSingleAabb(co);
+}
+
+void Physics::growBroadphase()
+{
+  BroadphaseType type = broadphase_type_;
+  unsigned int capacity = 2 * broadphase_capacity_;
+  if(type == BROADPHASE_AXIS_SWEEP && capacity > AXIS_SWEEP_MAX_OBJECTS) {
+    type = BROADPHASE_AXIS_SWEEP_32;
+  }
+  LOG("broadphase full, increase capacity to %u objects", capacity);
+
+  // move proxies to the new broadphase
+  btBroadphaseInterface* broadphase = createBroadphase(type, capacity);
+  btOverlappingPairCache* pair_cache = broadphase_->getOverlappingPairCache();
+  btCollisionObjectArray& cos = world_->getCollisionObjectArray();
+  for(int i=0; i<cos.size(); i++) {
+    btCollisionObject* co = cos[i];
+    btBroadphaseProxy* proxy = co->getBroadphaseHandle();
+    if(proxy == NULL) {
+      continue;
+    }
+    btBroadphaseProxy* new_proxy = createProxy(broadphase, co, proxy->m_collisionFilterGroup, proxy->m_collisionFilterMask);
+    // manifolds are destroyed with pairs, the next collision detection
+    // recreates them before contacts are tracked
+    pair_cache->cleanProxyFromPairs(proxy, dispatcher_);
+    broadphase_->destroyProxy(proxy, dispatcher_);
+    co->setBroadphaseHandle(new_proxy);
+  }
+
+  world_->setBroadphase(broadphase);
+  delete broadphase_;
+  broadphase_ = broadphase;
+  broadphase_type_ = type;
+  broadphase_capacity_ = capacity;
+  world_->updateAabbs();
+}
+
+void Physics::setProfiling(bool enabled)
+{
+  if(enabled && !profiler_) {
+    profiler_.reset(new Profiler());
+  }
+  profiling_ = enabled;
+  static_cast<ProfiledDynamicsWorld*>(world_)->setProfiler(enabled ? profiler_.get() : NULL);
+}
+
+void Physics::resetProfiling()
+{
+  if(profiler_) {
+    profiler_->clear();
+  }
+}
+
+void Physics::releaseProfiledObject(Object* obj)
+{
+  if(profiler_) {
+    profiler_->removeObject(obj);
+  }
+}
+
+void Physics::setSolverThreadPool(ThreadPool* pool)
+{
+  static_cast<ParallelDynamicsWorld*>(world_)->setThreadPool(pool);
+}
+
+ThreadPool* Physics::getSolverThreadPool() const
+{
+  return static_cast<const ParallelDynamicsWorld*>(world_)->getThreadPool();
+}
+
+void Physics::exportStates(btScalar* pos, btScalar* rot, btScalar* lin_vel, btScalar* ang_vel) const
+{
+  const size_t n = objs_.size();
+  for(size_t i=0; i<n; i++) {
+    const Object* obj = objs_[i];
+    if(pos || rot) {
+      const btTransform tr = obj->getTrans();
+      if(pos) {
+        const btVector3 v = btUnscale(tr.getOrigin());
+        pos[3*i] = v.x();
+        pos[3*i+1] = v.y();
+        pos[3*i+2] = v.z();
+      }
+      if(rot) {
+        const btQuaternion q = tr.getRotation();
+        rot[4*i] = q.x();
+        rot[4*i+1] = q.y();
+        rot[4*i+2] = q.z();
+        rot[4*i+3] = q.w();
+      }
+    }
+    if(lin_vel || ang_vel) {
+      const btRigidBody* body = btRigidBody::upcast(obj->getMainBody());
+      const btVector3 zero(0, 0, 0);
+      if(lin_vel) {
+        const btVector3 v = body ? btUnscale(body->getLinearVelocity()) : zero;
+        lin_vel[3*i] = v.x();
+        lin_vel[3*i+1] = v.y();
+        lin_vel[3*i+2] = v.z();
+      }
+      if(ang_vel) {
+        const btVector3& v = body ? body->getAngularVelocity() : zero;
+        ang_vel[3*i] = v.x();
+        ang_vel[3*i+1] = v.y();
+        ang_vel[3*i+2] = v.z();
+      }
+    }
+  }
 }
 
 void Physics::transform(const btTransform& tr)
@@ -76,15 +354,306 @@ void Physics::transform(const btTransform& tr)
   for(auto& obj : objs_) {
     obj->setTrans(tr * obj->getTrans());
   }
+  revision_++;
+}
+
+SmartPtr<Physics::Snapshot> Physics::snapshot()
+{
+  SmartPtr<Snapshot> snap = new Snapshot();
+  snap->physics_ = this;
+  snap->step_index_ = step_index_;
+  snap->time_ = time_;
+
+  // bodies
+  const btCollisionObjectArray& cos = world_->getCollisionObjectArray();
+  const int nbodies = cos.size();
+  snap->bodies_.resize(nbodies);
+  snap->body_states_.resize(nbodies);
+  for(int i=0; i<nbodies; i++) {
+    snap->bodies_[i] = cos[i];
+    saveBodyState(cos[i], snap->body_states_[i]);
+  }
+
+  // constraints
+  const int nconstraints = world_->getNumConstraints();
+  snap->constraints_.resize(nconstraints);
+  for(int i=0; i<nconstraints; i++) {
+    btTypedConstraint* constraint = world_->getConstraint(i);
+    Snapshot::ConstraintEntry& entry = snap->constraints_[i];
+    entry.constraint = constraint;
+    entry.body_a = &constraint->getRigidBodyA();
+    entry.body_b = &constraint->getRigidBodyB();
+    saveConstraintState(constraint, entry.state);
+  }
+
+  // objects
+  snap->data_.setPhysics(this);
+  snap->objs_.assign(objs_.begin(), objs_.end());
+  for(auto& obj : objs_) {
+    obj->saveState(snap->data_);
+  }
+
+  // tasks
+  task_wheel_.getEntries(snap->tasks_);
+  for(auto& entry : snap->tasks_) {
+    entry.task->saveState(snap->data_);
+  }
+
+  return snap;
 }
 
+void Physics::restore(Snapshot* snapshot)
+{
+  if(snapshot->physics_ != this) {
+    throw(Error("snapshot has been taken on another world"));
+  }
+
+  // check that objects and bodies did not change
+  if(objs_.size() != snapshot->objs_.size() ||
+     !std::equal(objs_.begin(), objs_.end(), snapshot->objs_.begin())) {
+    throw(Error("world objects changed since the snapshot"));
+  }
+  const btCollisionObjectArray& cos = world_->getCollisionObjectArray();
+  const int nbodies = cos.size();
+  if(nbodies != (int)snapshot->bodies_.size()) {
+    throw(Error("world bodies changed since the snapshot"));
+  }
+  for(int i=0; i<nbodies; i++) {
+    if(cos[i] != snapshot->bodies_[i]) {
+      throw(Error("world bodies changed since the snapshot"));
+    }
+  }
+
+  step_index_ = snapshot->step_index_;
+  time_ = snapshot->time_;
+
+  // objects, first since they may add or remove constraints
+  StateBuffer& data = snapshot->data_;
+  data.rewind();
+  for(auto& obj : objs_) {
+    obj->restoreState(data);
+  }
+
+  // bodies
+  for(int i=0; i<nbodies; i++) {
+    restoreBodyState(cos[i], snapshot->body_states_[i]);
+  }
+
+  // constraints
+  // skip constraints which have been removed (or recreated) since the snapshot
+  std::vector<btTypedConstraint*> constraints(world_->getNumConstraints());
+  for(size_t i=0; i<constraints.size(); i++) {
+    constraints[i] = world_->getConstraint(i);
+  }
+  std::sort(constraints.begin(), constraints.end());
+  for(auto& entry : snapshot->constraints_) {
+    btTypedConstraint* constraint = entry.constraint;
+    if(!std::binary_search(constraints.begin(), constraints.end(), constraint) ||
+       constraint->getConstraintType() != entry.state.type ||
+       &constraint->getRigidBodyA() != entry.body_a ||
+       &constraint->getRigidBodyB() != entry.body_b) {
+      continue;
+    }
+    restoreConstraintState(constraint, entry.state);
+  }
+
+  // tasks
+  task_wheel_.reset(step_index_ + 1);
+  for(auto& entry : snapshot->tasks_) {
+    task_wheel_.schedule(entry.task, entry.step, entry.time);
+  }
+  for(auto& entry : snapshot->tasks_) {
+    entry.task->restoreState(data);
+  }
+
+  resetContacts();
+  rays_.invalidate();
+  revision_++;
+}
+
+
+/// Store a transformation as scalar values
+static void pack_transform(const btTransform& tr, btScalar* p)
+{
+  const btMatrix3x3& m = tr.getBasis();
+  for(int i=0; i<3; i++) {
+    p[3*i+0] = m[i].x();
+    p[3*i+1] = m[i].y();
+    p[3*i+2] = m[i].z();
+  }
+  p[9] = tr.getOrigin().x();
+  p[10] = tr.getOrigin().y();
+  p[11] = tr.getOrigin().z();
+}
+
+static btTransform unpack_transform(const btScalar* p)
+{
+  return btTransform(
+      btMatrix3x3(p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7], p[8]),
+      btVector3(p[9], p[10], p[11]));
+}
+
+static void pack_vector(const btVector3& v, btScalar* p)
+{
+  p[0] = v.x();
+  p[1] = v.y();
+  p[2] = v.z();
+}
+
+static btVector3 unpack_vector(const btScalar* p)
+{
+  return btVector3(p[0], p[1], p[2]);
+}
+
+
+void Physics::saveBodyState(const btCollisionObject* co, BodyState& state)
+{
+  // clear padding, states are compared bytewise
+  memset(&state, 0, sizeof(state));
+  pack_transform(co->getWorldTransform(), state.trans);
+  pack_transform(co->getInterpolationWorldTransform(), state.interp_trans);
+  pack_vector(co->getInterpolationLinearVelocity(), state.interp_v);
+  pack_vector(co->getInterpolationAngularVelocity(), state.interp_av);
+  state.hit_fraction = co->getHitFraction();
+  state.deactivation_time = co->getDeactivationTime();
+  state.activation_state = co->getActivationState();
+  const btRigidBody* body = btRigidBody::upcast(co);
+  if(body) {
+    pack_vector(body->getLinearVelocity(), state.v);
+    pack_vector(body->getAngularVelocity(), state.av);
+  }
+}
+
+void Physics::restoreBodyState(btCollisionObject* co, const BodyState& state)
+{
+  co->setWorldTransform(unpack_transform(state.trans));
+  co->setInterpolationWorldTransform(unpack_transform(state.interp_trans));
+  co->setInterpolationLinearVelocity(unpack_vector(state.interp_v));
+  co->setInterpolationAngularVelocity(unpack_vector(state.interp_av));
+  co->setHitFraction(state.hit_fraction);
+  co->forceActivationState(state.activation_state);
+  co->setDeactivationTime(state.deactivation_time);
+  btRigidBody* body = btRigidBody::upcast(co);
+  if(body) {
+    body->setLinearVelocity(unpack_vector(state.v));
+    body->setAngularVelocity(unpack_vector(state.av));
+    body->clearForces();
+    body->updateInertiaTensor();
+  }
+}
+
+void Physics::saveConstraintState(btTypedConstraint* constraint, ConstraintState& state)
+{
+  memset(&state, 0, sizeof(state));
+  state.type = constraint->getConstraintType();
+  state.enabled = constraint->isEnabled();
+  if(state.type == HINGE_CONSTRAINT_TYPE) {
+    const btHingeConstraint* hinge = static_cast<btHingeConstraint*>(constraint);
+    state.limits[0] = hinge->getLowerLimit();
+    state.limits[1] = hinge->getUpperLimit();
+  } else if(state.type == SLIDER_CONSTRAINT_TYPE) {
+    btSliderConstraint* slider = static_cast<btSliderConstraint*>(constraint);
+    state.limits[0] = slider->getLowerLinLimit();
+    state.limits[1] = slider->getUpperLinLimit();
+    state.limits[2] = slider->getLowerAngLimit();
+    state.limits[3] = slider->getUpperAngLimit();
+    state.powered_lin = slider->getPoweredLinMotor();
+    state.powered_ang = slider->getPoweredAngMotor();
+    state.lin_motor_v = slider->getTargetLinMotorVelocity();
+    state.ang_motor_v = slider->getTargetAngMotorVelocity();
+    state.lin_motor_force = slider->getMaxLinMotorForce();
+    state.ang_motor_force = slider->getMaxAngMotorForce();
+  }
+}
+
+void Physics::restoreConstraintState(btTypedConstraint* constraint, const ConstraintState& state)
+{
+  constraint->setEnabled(state.enabled);
+  if(state.type == HINGE_CONSTRAINT_TYPE) {
+    btHingeConstraint* hinge = static_cast<btHingeConstraint*>(constraint);
+    // setLimit() also resets limit parameters, avoid calling it if not needed
+    if(hinge->getLowerLimit() != state.limits[0] || hinge->getUpperLimit() != state.limits[1]) {
+      hinge->setLimit(state.limits[0], state.limits[1]);
+    }
+  } else if(state.type == SLIDER_CONSTRAINT_TYPE) {
+    btSliderConstraint* slider = static_cast<btSliderConstraint*>(constraint);
+    slider->setLowerLinLimit(state.limits[0]);
+    slider->setUpperLinLimit(state.limits[1]);
+    slider->setLowerAngLimit(state.limits[2]);
+    slider->setUpperAngLimit(state.limits[3]);
+    slider->setPoweredLinMotor(state.powered_lin);
+    slider->setPoweredAngMotor(state.powered_ang);
+    slider->setTargetLinMotorVelocity(state.lin_motor_v);
+    slider->setTargetAngMotorVelocity(state.ang_motor_v);
+    slider->setMaxLinMotorForce(state.lin_motor_force);
+    slider->setMaxAngMotorForce(state.ang_motor_force);
+  }
+}
+
+void Physics::resetContacts()
+{
+  btOverlappingPairCache* pair_cache = broadphase_->getOverlappingPairCache();
+  btBroadphasePairArray& pairs = pair_cache->getOverlappingPairArray();
+  for(int i=0; i<pairs.size(); i++) {
+    pair_cache->cleanOverlappingPair(pairs[i], dispatcher_);
+  }
+  world_->updateAabbs();
+  contacts_.reset();
+}
+
+
+SmartPtr<Journal> Physics::startRecording()
+{
+  if(recorder_) {
+    throw(Error("world is already being recorded"));
+  }
+  recorder_.reset(new Recorder(this));
+  return recorder_->getJournal();
+}
+
+void Physics::stopRecording()
+{
+  if(!recorder_) {
+    throw(Error("world is not being recorded"));
+  }
+  recorder_.reset();
+}
+
+
 void Physics::worldTickCallback(btDynamicsWorld* world, btScalar /*step*/)
 {
   Physics* physics = (Physics*)world->getWorldUserInfo();
 
-  for(auto& obj : physics->tick_objs_) {
-    obj->tickCallback();
+  physics->contacts_.update(physics->dispatcher_);
+
+  // callbacks may enable or disable callbacks: call objects registered when
+  // the dispatch starts, except those disabled since
+  std::vector<SmartPtr<Object>>& objs = physics->tick_dispatch_;
+  objs.assign(physics->tick_objs_.begin(), physics->tick_objs_.end());
+  if(physics->profiling_) {
+    Profiler* profiler = physics->profiler_.get();
+    Profiler::Timer timer(profiler, Profiler::PHASE_TICK_CALLBACKS);
+    for(auto& obj : objs) {
+      if(!obj->isTickEnabled()) {
+        continue;
+      }
+      Profiler::Clock::time_point start = Profiler::Clock::now();
+      obj->tickCallback();
+      const uint64_t ns = Profiler::elapsed(start);
+      // statistics of removed objects have been dropped
+      if(obj->getPhysics() == physics) {
+        profiler->addObject(obj, ns);
+      }
+    }
+  } else {
+    for(auto& obj : objs) {
+      if(obj->isTickEnabled()) {
+        obj->tickCallback();
+      }
+    }
   }
+  // removed objects may be deleted
+  objs.clear();
 }
 
 
@@ -107,12 +676,89 @@ void TaskBasic::process(Physics* ph)
   }
 
   callback_(ph);
-  if(period_ > 0.0) {
+  if(period_ > 0.0 && !cancelled_) {
     ph->scheduleTask(this, ph->getTime() + period_);
   }
 }
 
 
+void TaskPhysics::unschedule()
+{
+  if(wheel_) {
+    wheel_->cancel(this);
+  }
+}
+
+
+void TaskBasic::saveState(StateBuffer& buf) const
+{
+  buf.write(cancelled_);
+}
+
+void TaskBasic::restoreState(StateBuffer& buf)
+{
+  buf.read(cancelled_);
+}
+
+
+Physics::Snapshot::Snapshot(): physics_(NULL), step_index_(0), time_(0)
+{
+}
+
+Physics::Snapshot::~Snapshot()
+{
+}
+
+
+void StateBuffer::writeBody(const btCollisionObject* co)
+{
+  if(!physics_) {
+    throw(Error("state buffer is not associated to a world"));
+  }
+  int index = -1;
+  if(co != NULL) {
+    const btCollisionObjectArray& cos = physics_->getWorld()->getCollisionObjectArray();
+    index = cos.findLinearSearch(const_cast<btCollisionObject*>(co));
+    if(index == cos.size()) {
+      throw(Error("body is not in the world"));
+    }
+  }
+  write(index);
+}
+
+btCollisionObject* StateBuffer::readBody()
+{
+  if(!physics_) {
+    throw(Error("state buffer is not associated to a world"));
+  }
+  int index;
+  read(index);
+  if(index < 0) {
+    return NULL;
+  }
+  const btCollisionObjectArray& cos = physics_->getWorld()->getCollisionObjectArray();
+  if(index >= cos.size()) {
+    throw(Error("invalid body index"));
+  }
+  return cos[index];
+}
+
+void StateBuffer::writeRaw(const void* p, size_t n)
+{
+  const char* c = static_cast<const char*>(p);
+  data_.insert(data_.end(), c, c+n);
+}
+
+void StateBuffer::readRaw(void* p, size_t n)
+{
+  if(pos_ + n > data_.size()) {
+    throw(Error("state buffer overflow"));
+  }
+  memcpy(p, &data_[pos_], n);
+  pos_ += n;
+}
+
+
 CompoundShapeSmart::~CompoundShapeSmart()
 {
   clearChildReferences();
@@ -3,15 +3,86 @@
 
 ///@file
 
-#include <set>
-#include <queue>
 #include <vector>
 #include <functional>
+#include <memory>
 #include "smart.h"
+#include "taskwheel.h"
+#include "registry.h"
+#include "contacts.h"
+#include "raybatch.h"
 
 class Object;
 class TaskPhysics;
+class Physics;
+class Recorder;
+class Journal;
+class Profiler;
+class ThreadPool;
 
+/// Registry of world objects
+typedef DenseRegistry<SmartPtr<Object>> ObjectRegistry;
+
+
+/** @brief Binary buffer for saved states
+ *
+ * Values are written then read back in the same order, using raw memory
+ * copies. Only trivially copyable values can be stored.
+ *
+ * Pointers to bodies must be written using writeBody(): bodies are saved as
+ * their index in the world, which allows to restore them in another process.
+ */
+class StateBuffer
+{
+ public:
+  StateBuffer(): physics_(NULL), pos_(0) {}
+
+  /// Set the world of saved bodies
+  void setPhysics(Physics* ph) { physics_ = ph; }
+  Physics* getPhysics() const { return physics_; }
+
+  template <class T> void write(const T& v) { writeRaw(&v, sizeof(T)); }
+  template <class T> void read(T& v) { readRaw(&v, sizeof(T)); }
+
+  template <class T> void writeVector(const std::vector<T>& v)
+  {
+    write(v.size());
+    if(!v.empty()) {
+      writeRaw(&v[0], v.size()*sizeof(T));
+    }
+  }
+  template <class T> void readVector(std::vector<T>& v)
+  {
+    size_t n;
+    read(n);
+    v.resize(n);
+    if(n > 0) {
+      readRaw(&v[0], n*sizeof(T));
+    }
+  }
+
+  /// Write a reference to a body of the world
+  void writeBody(const btCollisionObject* co);
+  /// Read a body reference written with writeBody()
+  btCollisionObject* readBody();
+
+  /// Restart reading from the beginning
+  void rewind() { pos_ = 0; }
+  void clear() { data_.clear(); pos_ = 0; }
+  size_t size() const { return data_.size(); }
+  bool atEnd() const { return pos_ >= data_.size(); }
+
+  const std::vector<char>& getData() const { return data_; }
+  void setData(const std::vector<char>& data) { data_ = data; pos_ = 0; }
+
+  void writeRaw(const void* p, size_t n);
+  void readRaw(void* p, size_t n);
+
+ private:
+  Physics* physics_;
+  std::vector<char> data_;
+  size_t pos_; ///< read position
+};
 
 
 /** @brief Physics environment
@@ -19,6 +90,7 @@ class TaskPhysics;
 class Physics: public SmartObject
 {
  public:
+  class Snapshot;
 
   /** @name Configuration values
    */
@@ -37,37 +109,198 @@ class Physics: public SmartObject
   static btVector3 world_aabb_min;
   /// AABB's maximum for new worlds
   static btVector3 world_aabb_max;
-  /// Maximum object count for new worlds
+  /** @brief Initial object capacity of axis sweep broadphases
+   *
+   * Capacity is increased automatically when needed.
+   */
   static unsigned int world_objects_max;
 
   //@}
 
-  Physics(btScalar step_dt=0.002);
+  /** @brief Broadphase types
+   *
+   * Axis sweep broadphases are faster for mostly static worlds contained in
+   * \e world_aabb_min and \e world_aabb_max. Their handles are preallocated.
+   * A dynamic AABB tree has no size limit and no preallocated handles.
+   */
+  enum BroadphaseType {
+    BROADPHASE_AXIS_SWEEP,  ///< 16-bit axis sweep (btAxisSweep3)
+    BROADPHASE_AXIS_SWEEP_32,  ///< 32-bit axis sweep (bt32BitAxisSweep3)
+    BROADPHASE_DBVT,  ///< dynamic AABB tree (btDbvtBroadphase)
+  };
+
+  /// Maximum object count of 16-bit axis sweep broadphases
+  static const unsigned int AXIS_SWEEP_MAX_OBJECTS = 32766;
+
+  Physics(btScalar step_dt=0.002, BroadphaseType broadphase=BROADPHASE_AXIS_SWEEP);
   virtual ~Physics();
 
   /// Advance simulation
   void step();
+  /** @brief Advance simulation of several steps
+   *
+   * Equivalent to calling step() \e n times.
+   */
+  void stepMany(unsigned int n);
+  /** @brief Advance simulation up to a given time
+   *
+   * Steps are executed until current time reaches \e time. A half-step
+   * tolerance is used to not execute an extra step due to rounding errors.
+   */
+  void runUntil(btScalar time);
 
   btScalar getStepDt() const { return step_dt_; }
 
   /// Return current simulation time
   btScalar getTime() const { return time_; }
+  /// Return the number of steps since the creation of the world
+  uint64_t getStepIndex() const { return step_index_; }
+
+  /** @brief Return the world revision
+   *
+   * The revision changes when the world is modified apart from the
+   * simulation: objects added, removed or moved, tasks executed, restored
+   * snapshots. Displays use it to detect changes of sleeping worlds, ray
+   * sensors to discard cached results.
+   */
+  uint64_t getRevision() const { return revision_; }
+  /// Change the world revision, for modifications it does not track
+  void markModified() { revision_++; }
 
   /** @brief Schedule a task
    *
    * If \e time is negative, the task will be executed after the next
    * step.
    *
+   * Tasks are executed at the first step whose time is greater or equal to
+   * their scheduled time. Tasks of a same step are executed by scheduled
+   * time, then in scheduling order.
+   *
    * @note Precision of execution time will depends on simulation time step.
    * Execution order is not affected.
    */
   void scheduleTask(TaskPhysics* task, btScalar time=-1);
 
+  BroadphaseType getBroadphaseType() const { return broadphase_type_; }
+  /// Return the current broadphase object capacity, 0 if unlimited
+  unsigned int getBroadphaseCapacity() const { return broadphase_capacity_; }
+
   btDynamicsWorld* getWorld() { return world_; }
   const btDynamicsWorld* getWorld() const { return world_; }
 
-  std::set<SmartPtr<Object>>& getObjs() { return objs_; }
-  std::set<SmartPtr<Object>>& getTickObjs() { return tick_objs_; }
+  /** @brief Change the collision filter of a body in the world
+   *
+   * The body's broadphase proxy is replaced: filtered pairs are dropped
+   * and newly allowed ones are found. Unlike removing then adding the body
+   * back, its position in the world is kept, and so are snapshots and
+   * contact tracking state.
+   */
+  void setBodyCollisionFilter(btCollisionObject* co, CollisionFilterInt group, CollisionFilterInt mask);
+
+  ObjectRegistry& getObjs() { return objs_; }
+  const ObjectRegistry& getObjs() const { return objs_; }
+  ObjectRegistry& getTickObjs() { return tick_objs_; }
+
+  /** @brief Return the contact tracker
+   *
+   * Contact events are emitted at the end of each substep, before object
+   * tick callbacks.
+   */
+  ContactTracker& getContacts() { return contacts_; }
+  /// Return the default event queue, used by bindings
+  ContactQueue& getContactQueue() { return contact_queue_; }
+
+  /// Return the batch of ray sensors
+  RayBatch& getRays() { return rays_; }
+
+  /** @brief Export states of all objects into arrays
+   *
+   * Arrays are indexed by object, in getObjs() order, and filled with
+   * unscaled values. Positions and velocities use 3 values per object,
+   * rotations are quaternions with 4 values per object (x, y, z, w).
+   *
+   * Velocities are those of object's main body, or null if the object has
+   * no main rigid body.
+   *
+   * Each array may be \e NULL to not export the corresponding values.
+   */
+  void exportStates(btScalar* pos, btScalar* rot, btScalar* lin_vel, btScalar* ang_vel) const;
+
+  /** @name Snapshots
+   *
+   * A snapshot saves the state of every body and constraint of the world,
+   * object states (see Object::saveState()) and scheduled tasks.
+   * Restoring a snapshot updates the existing objects in place: objects and
+   * bodies must be the same than when the snapshot has been taken.
+   *
+   * Contact caches are not saved. They are reset when a snapshot is
+   * restored.
+   */
+  //@{
+  /// Save the current world state
+  SmartPtr<Snapshot> snapshot();
+  /** @brief Restore a world state
+   *
+   * The snapshot must have been taken on the same world.
+   *
+   * @note This method must not be called during a step (e.g. from a task).
+   */
+  void restore(Snapshot* snapshot);
+  //@}
+
+  /** @name Recording
+   *
+   * The recorder saves in a journal all changes made to the world between
+   * simulation steps (by tasks or by external code). The journal can then
+   * be replayed without executing tasks, using a Replayer.
+   */
+  //@{
+  /// Start a new recording, return the journal being recorded
+  SmartPtr<Journal> startRecording();
+  /// Stop the current recording
+  void stopRecording();
+  bool isRecording() const { return recorder_.get() != NULL; }
+  //@}
+
+  /** @name Profiling
+   *
+   * When profiling is enabled, time spent in each phase of the steps is
+   * measured. It has no cost when disabled.
+   */
+  //@{
+  /** @brief Enable or disable profiling
+   *
+   * Statistics are kept when profiling is disabled then enabled again.
+   */
+  void setProfiling(bool enabled);
+  bool isProfiling() const { return profiling_; }
+  /// Return the profiler, \e NULL if profiling has never been enabled
+  const Profiler* getProfiler() const { return profiler_.get(); }
+  /// Reset profiling statistics
+  void resetProfiling();
+  /** @brief Drop profiling statistics of an object
+   *
+   * Called when an object is removed from the world, so that the profiler
+   * does not keep it alive.
+   */
+  void releaseProfiledObject(Object* obj);
+  //@}
+
+  /** @name Parallel solver
+   *
+   * Simulation islands can be solved concurrently on a thread pool. This
+   * speeds up worlds with many independent groups of interacting bodies.
+   * Results are deterministic for a given pool size.
+   *
+   * The pool can be shared with other worlds, including worlds run by a
+   * WorldPool. Islands are solved sequentially if the world contains
+   * kinematic bodies.
+   */
+  //@{
+  /// Set the pool used to solve islands, \e NULL to disable
+  void setSolverThreadPool(ThreadPool* pool);
+  ThreadPool* getSolverThreadPool() const;
+  //@}
 
   /** @brief Change world's referential
    *
@@ -81,6 +314,10 @@ class Physics: public SmartObject
   static const btRigidBody static_body;
 
  private:
+  friend class Recorder;
+  friend class Replayer;
+  class World;
+
   /** @brief Encapsulated world
    *
    * The world user info is set to the physics instance pointer.
@@ -91,13 +328,45 @@ class Physics: public SmartObject
   btBroadphaseInterface* broadphase_;
   btCollisionConfiguration* col_config_;
 
-  /// All simulated objects
-  std::set<SmartPtr<Object>> objs_;
+  BroadphaseType broadphase_type_;
+  /// Broadphase object capacity, 0 if unlimited
+  unsigned int broadphase_capacity_;
+  /// Create a broadphase of given type
+  static btBroadphaseInterface* createBroadphase(BroadphaseType type, unsigned int capacity);
+  /// Create a broadphase proxy of a collision object
+  btBroadphaseProxy* createProxy(btBroadphaseInterface* broadphase, btCollisionObject* co, CollisionFilterInt group, CollisionFilterInt mask);
+  /** @brief Replace the broadphase by a larger one
+   *
+   * 16-bit axis sweeps are replaced by 32-bit ones when they reach their
+   * maximum size.
+   *
+   * Overlapping pairs and their manifolds are destroyed. They are rebuilt by
+   * the collision detection of the next step, before the contact tracker is
+   * updated: its state is kept and no contact event is emitted for pairs
+   * still touching.
+   */
+  void growBroadphase();
+
+  /** @brief All simulated objects
+   *
+   * Objects are iterated in a deterministic order, which does not depend
+   * on their address.
+   */
+  ObjectRegistry objs_;
 
   /** @brief Object whose tick callback must be called
    * @sa Object::tickCallback()
    */
-  std::set<SmartPtr<Object>> tick_objs_;
+  ObjectRegistry tick_objs_;
+  /// Objects whose tick callback is being called, kept to avoid reallocations
+  std::vector<SmartPtr<Object>> tick_dispatch_;
+
+  /// Contact events of subscribed bodies
+  ContactTracker contacts_;
+  ContactQueue contact_queue_;
+
+  /// Ray sensors
+  RayBatch rays_;
 
   /// Tick callback called by Bullet
   static void worldTickCallback(btDynamicsWorld* world, btScalar step);
@@ -105,12 +374,112 @@ class Physics: public SmartObject
   /// Simulation time step, must not be modified
   btScalar step_dt_;
 
+  /// Current step index, time is computed from it
+  uint64_t step_index_;
   btScalar time_;
+  uint64_t revision_;
 
-  typedef std::pair<btScalar, SmartPtr<TaskPhysics>> TaskQueueValue;
-  typedef std::priority_queue<TaskQueueValue, std::vector<TaskQueueValue>, std::greater<TaskQueueValue>> TaskQueue;
   /// Scheduled tasks
-  TaskQueue task_queue_;
+  TaskWheel task_wheel_;
+
+  /// Return the first step whose time is greater or equal to \e time
+  uint64_t timeToStep(btScalar time) const;
+  /// Set current step index, reschedule tasks if needed
+  void setStepIndex(uint64_t index);
+
+  /// Current recorder, if any
+  std::unique_ptr<Recorder> recorder_;
+
+  /** @brief Step profiler
+   *
+   * It is not deleted when profiling is disabled, in case it is disabled
+   * during a step.
+   */
+  std::unique_ptr<Profiler> profiler_;
+  bool profiling_;
+
+  /// Simulate a single step, without executing tasks
+  void simulateStep();
+
+  /** @brief Saved state of a collision object
+   *
+   * Transformations are stored as basis rows followed by the origin.
+   * Only scalar values are used so that states can be compared bytewise.
+   */
+  struct BodyState
+  {
+    btScalar trans[12];
+    btScalar interp_trans[12];
+    btScalar interp_v[3];
+    btScalar interp_av[3];
+    btScalar v[3];
+    btScalar av[3];
+    btScalar hit_fraction;
+    btScalar deactivation_time;
+    int activation_state;
+  };
+
+  /** @brief Saved state of a constraint
+   *
+   * Only values which may be modified after the creation are saved.
+   */
+  struct ConstraintState
+  {
+    int type;
+    int enabled;
+    btScalar limits[4];  ///< hinge (2 values) or slider limits
+    int powered_lin;
+    int powered_ang;
+    btScalar lin_motor_v;
+    btScalar ang_motor_v;
+    btScalar lin_motor_force;
+    btScalar ang_motor_force;
+  };
+
+  static void saveBodyState(const btCollisionObject* co, BodyState& state);
+  static void restoreBodyState(btCollisionObject* co, const BodyState& state);
+  static void saveConstraintState(btTypedConstraint* constraint, ConstraintState& state);
+  /// Restore a constraint state, constraint type must match
+  static void restoreConstraintState(btTypedConstraint* constraint, const ConstraintState& state);
+  /// Reset contact caches and tracked contacts (e.g. after bodies have been moved)
+  void resetContacts();
+};
+
+
+/** @brief Saved state of a world
+ *
+ * @sa Physics::snapshot(), Physics::restore()
+ */
+class Physics::Snapshot: public SmartObject
+{
+  friend class Physics;
+ public:
+  virtual ~Snapshot();
+  /// Return the world time of the snapshot
+  btScalar getTime() const { return time_; }
+
+ private:
+  Snapshot();
+
+  /// Constraint identity and state
+  struct ConstraintEntry
+  {
+    btTypedConstraint* constraint;
+    const btRigidBody* body_a;
+    const btRigidBody* body_b;
+    ConstraintState state;
+  };
+
+  const Physics* physics_;
+  uint64_t step_index_;
+  btScalar time_;
+  std::vector<SmartPtr<Object>> objs_;
+  std::vector<btCollisionObject*> bodies_;
+  std::vector<BodyState> body_states_;
+  std::vector<ConstraintEntry> constraints_;
+  std::vector<TaskWheel::Entry> tasks_;
+  /// Object and task states
+  StateBuffer data_;
 };
 
 
@@ -120,11 +489,30 @@ class Physics: public SmartObject
  */
 class TaskPhysics: public SmartObject
 {
+  friend class TaskWheel;
  public:
-  TaskPhysics() {}
+  TaskPhysics(): wheel_(NULL), nodes_(NULL) {}
   virtual ~TaskPhysics() {}
 
   virtual void process(Physics* ph) = 0;
+
+  /// Return \e true if the task is scheduled
+  bool scheduled() const { return nodes_ != NULL; }
+  /// Remove all pending executions of the task
+  void unschedule();
+
+  /** @brief Save task state, for snapshots
+   * @sa Object::saveState()
+   */
+  virtual void saveState(StateBuffer&) const {}
+  /// Restore task state saved with saveState()
+  virtual void restoreState(StateBuffer&) {}
+
+ private:
+  /// Wheel the task is scheduled in, \e NULL if not scheduled
+  TaskWheel* wheel_;
+  /// Pending executions
+  TaskWheel::Node* nodes_;
 };
 
 /** @brief Basic task
@@ -136,9 +524,11 @@ class TaskBasic: public TaskPhysics
   virtual ~TaskBasic() {}
 
   virtual void process(Physics* ph);
+  virtual void saveState(StateBuffer& buf) const;
+  virtual void restoreState(StateBuffer& buf);
 
-  /// Cancel the task
-  void cancel() { cancelled_ = true; }
+  /// Cancel the task, remove it from the scheduled tasks
+  void cancel() { cancelled_ = true; unschedule(); }
 
   typedef std::function<void (Physics*)> Callback;
   void setCallback(Callback cb) { callback_ = cb; }
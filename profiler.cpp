@@ -0,0 +1,131 @@
+#include "profiler.h"
+#include "object.h"
+
+
+void ProfileStats::add(uint64_t v)
+{
+  count_++;
+  total_ += v;
+  if(v < min_) {
+    min_ = v;
+  }
+  if(v > max_) {
+    max_ = v;
+  }
+  unsigned int bucket = 0;
+  while(v > 1 && bucket < BUCKETS-1) {
+    v >>= 1;
+    bucket++;
+  }
+  histogram_[bucket]++;
+}
+
+void ProfileStats::clear()
+{
+  count_ = 0;
+  total_ = 0;
+  min_ = UINT64_MAX;
+  max_ = 0;
+  for(unsigned int i=0; i<BUCKETS; i++) {
+    histogram_[i] = 0;
+  }
+}
+
+
+const char* Profiler::getPhaseName(Phase phase)
+{
+  static const char* names[PHASE_NB] = {
+    "step",
+    "simulation",
+    "broadphase",
+    "narrowphase",
+    "solver",
+    "integration",
+    "tick_callbacks",
+    "tasks",
+  };
+  return names[phase];
+}
+
+Profiler::Profiler()
+{
+  clear();
+}
+
+void Profiler::clear()
+{
+  for(unsigned int i=0; i<PHASE_NB; i++) {
+    phases_[i].clear();
+    current_[i] = 0;
+  }
+  objects_.clear();
+  tasks_.clear();
+}
+
+void Profiler::endStep(unsigned int ntasks)
+{
+  for(unsigned int i=0; i<PHASE_NB; i++) {
+    phases_[i].add(current_[i]);
+    current_[i] = 0;
+  }
+  tasks_.add(ntasks);
+}
+
+void Profiler::addObject(Object* obj, uint64_t ns)
+{
+  objects_[obj].add(ns);
+}
+
+void Profiler::removeObject(Object* obj)
+{
+  objects_.erase(obj);
+}
+
+
+void ProfiledDynamicsWorld::performDiscreteCollisionDetection()
+{
+  if(!profiler_) {
+    btDiscreteDynamicsWorld::performDiscreteCollisionDetection();
+    return;
+  }
+
+  // same as btCollisionWorld::performDiscreteCollisionDetection(), with
+  // broadphase and narrowphase measured separately
+  {
+    Profiler::Timer timer(profiler_, Profiler::PHASE_BROADPHASE);
+    updateAabbs();
+    m_broadphasePairCache->calculateOverlappingPairs(m_dispatcher1);
+  }
+  {
+    Profiler::Timer timer(profiler_, Profiler::PHASE_NARROWPHASE);
+    btDispatcher* dispatcher = getDispatcher();
+    if(dispatcher) {
+      dispatcher->dispatchAllCollisionPairs(m_broadphasePairCache->getOverlappingPairCache(), getDispatchInfo(), m_dispatcher1);
+    }
+  }
+}
+
+void ProfiledDynamicsWorld::predictUnconstraintMotion(btScalar timeStep)
+{
+  Profiler::Timer timer(profiler_, Profiler::PHASE_INTEGRATION);
+  btDiscreteDynamicsWorld::predictUnconstraintMotion(timeStep);
+}
+
+void ProfiledDynamicsWorld::integrateTransforms(btScalar timeStep)
+{
+  Profiler::Timer timer(profiler_, Profiler::PHASE_INTEGRATION);
+  btDiscreteDynamicsWorld::integrateTransforms(timeStep);
+}
+
+void ProfiledDynamicsWorld::calculateSimulationIslands()
+{
+  Profiler::Timer timer(profiler_, Profiler::PHASE_SOLVER);
+  btDiscreteDynamicsWorld::calculateSimulationIslands();
+}
+
+void ProfiledDynamicsWorld::solveConstraints(btContactSolverInfo& solverInfo)
+{
+  Profiler::Timer timer(profiler_, Profiler::PHASE_SOLVER);
+  ParallelDynamicsWorld::solveConstraints(solverInfo);
+}
+
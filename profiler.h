@@ -0,0 +1,168 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+
+///@file
+
+#include <cstdint>
+#include <chrono>
+#include <map>
+#include "smart.h"
+#include "parallelworld.h"
+
+class Object;
+
+
+/** @brief Statistics of profiled values
+ *
+ * Values are aggregated into a logarithmic histogram: bucket \e i counts
+ * values in <tt>[2^i,2^(i+1))</tt>. Bucket 0 also counts null values.
+ */
+class ProfileStats
+{
+ public:
+  static const unsigned int BUCKETS = 32;
+
+  ProfileStats() { clear(); }
+  void add(uint64_t v);
+  void clear();
+
+  uint64_t getCount() const { return count_; }
+  uint64_t getTotal() const { return total_; }
+  /// Return the minimum value, 0 if there are no values
+  uint64_t getMin() const { return count_ ? min_ : 0; }
+  uint64_t getMax() const { return max_; }
+  const uint64_t* getHistogram() const { return histogram_; }
+
+ private:
+  uint64_t count_;
+  uint64_t total_;
+  uint64_t min_;
+  uint64_t max_;
+  uint64_t histogram_[BUCKETS];
+};
+
+
+/** @brief Step profiler
+ *
+ * Measure wall time of simulation phases, in nanoseconds, and per-object
+ * cost of tick callbacks. Each world has its own profiler, worlds can be
+ * profiled concurrently.
+ *
+ * Phase durations are summed over a step, then added to statistics when
+ * the step ends: there is one value per step for each phase.
+ *
+ * @sa Physics::setProfiling()
+ */
+class Profiler
+{
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  /// Profiled phases
+  enum Phase {
+    PHASE_STEP = 0,  ///< whole step
+    PHASE_SIMULATION,  ///< Bullet step, including next phases
+    PHASE_BROADPHASE,  ///< AABB update and overlapping pairs
+    PHASE_NARROWPHASE,  ///< contact computation
+    PHASE_SOLVER,  ///< islands and constraint solving
+    PHASE_INTEGRATION,  ///< motion prediction and integration
+    PHASE_TICK_CALLBACKS,  ///< object tick callbacks
+    PHASE_TASKS,  ///< scheduled tasks
+    PHASE_NB
+  };
+
+  /// Return the name of a phase
+  static const char* getPhaseName(Phase phase);
+
+  /** @brief Measure the duration of a scope
+   *
+   * Nothing is measured if the profiler is \e NULL.
+   */
+  class Timer
+  {
+   public:
+    Timer(Profiler* profiler, Phase phase): profiler_(profiler), phase_(phase)
+    {
+      if(profiler_) {
+        start_ = Clock::now();
+      }
+    }
+    ~Timer()
+    {
+      if(profiler_) {
+        profiler_->addPhase(phase_, Profiler::elapsed(start_));
+      }
+    }
+
+   private:
+    Profiler* profiler_;
+    Phase phase_;
+    Clock::time_point start_;
+  };
+
+  Profiler();
+  ~Profiler() {}
+
+  /// Reset all statistics
+  void clear();
+
+  /// Add a duration to a phase of the current step
+  void addPhase(Phase phase, uint64_t ns) { current_[phase] += ns; }
+  void addObject(Object* obj, uint64_t ns);
+  /// Drop statistics of an object, release the reference on it
+  void removeObject(Object* obj);
+  /// End the current step, \e ntasks is the number of executed tasks
+  void endStep(unsigned int ntasks);
+
+  const ProfileStats& getPhase(Phase phase) const { return phases_[phase]; }
+  /// Return tick callback statistics of each object
+  const std::map<SmartPtr<Object>, ProfileStats>& getObjects() const { return objects_; }
+  /// Return statistics of executed task counts, per step
+  const ProfileStats& getTasks() const { return tasks_; }
+
+  /// Return elapsed nanoseconds since a given time
+  static uint64_t elapsed(const Clock::time_point& start)
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+  }
+
+ private:
+  ProfileStats phases_[PHASE_NB];
+  /// Phase durations of the current step
+  uint64_t current_[PHASE_NB];
+  std::map<SmartPtr<Object>, ProfileStats> objects_;
+  ProfileStats tasks_;
+};
+
+
+/** @brief Dynamics world with profiled phases
+ *
+ * Bullet's own profiler (CProfileManager) is global and cannot be used to
+ * profile worlds simulated concurrently. Instead, phases are measured by
+ * overloading world's internal methods.
+ *
+ * When no profiler is set, parent methods are called directly.
+ */
+class ProfiledDynamicsWorld: public ParallelDynamicsWorld
+{
+ public:
+  ProfiledDynamicsWorld(btDispatcher* dispatcher, btBroadphaseInterface* pair_cache, btConstraintSolver* solver, btCollisionConfiguration* col_config):
+      ParallelDynamicsWorld(dispatcher, pair_cache, solver, col_config), profiler_(NULL) {}
+  virtual ~ProfiledDynamicsWorld() {}
+
+  void setProfiler(Profiler* profiler) { profiler_ = profiler; }
+
+  virtual void performDiscreteCollisionDetection();
+
+ protected:
+  virtual void predictUnconstraintMotion(btScalar timeStep);
+  virtual void integrateTransforms(btScalar timeStep);
+  virtual void calculateSimulationIslands();
+  virtual void solveConstraints(btContactSolverInfo& solverInfo);
+
+ private:
+  Profiler* profiler_;
+};
+
+
+#endif
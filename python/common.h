@@ -14,6 +14,8 @@
 #define MS_WIN64
 #endif
 #include <boost/python.hpp>
+#include <memory>
+#include <string>
 #include "smart.h"
 #include "maths.h"
 
@@ -81,6 +83,79 @@ void py_smart_register()
 //@}
 
 
+/** @name GIL handling
+ *
+ * Long C++ operations (e.g. simulation steps) release the GIL. C++ code
+ * calling Python must then acquire it back.
+ */
+//@{
+
+/// Release the GIL during the instance lifetime
+class PyGILRelease: boost::noncopyable
+{
+ public:
+  PyGILRelease(): state_(PyEval_SaveThread()) {}
+  ~PyGILRelease() { PyEval_RestoreThread(state_); }
+ private:
+  PyThreadState* state_;
+};
+
+/** @brief Acquire the GIL during the instance lifetime
+ *
+ * It can be used whether the GIL is already held or not.
+ */
+class PyGILLock: boost::noncopyable
+{
+ public:
+  PyGILLock(): state_(PyGILState_Ensure()) {}
+  ~PyGILLock() { PyGILState_Release(state_); }
+ private:
+  PyGILState_STATE state_;
+};
+
+/** @brief Python object holder, safe to copy and destroy without the GIL
+ *
+ * Used to store Python objects in C++ callbacks which may be copied or
+ * destroyed while the GIL is released.
+ * The GIL must be held to access the held object.
+ */
+class PyObjectHolder
+{
+ public:
+  PyObjectHolder(const py::object& o): o_(new py::object(o), deleter) {}
+  const py::object& get() const { return *o_; }
+ private:
+  static void deleter(py::object* o) { PyGILLock lock; delete o; }
+  std::shared_ptr<py::object> o_;
+};
+
+/** @brief Fetch and clear the current Python error, return it as a string
+ *
+ * Used to report Python errors which cannot be propagated as Python
+ * exceptions (e.g. from threads not created by Python).
+ */
+inline std::string py_fetch_error()
+{
+  PyObject *type, *value, *traceback;
+  PyErr_Fetch(&type, &value, &traceback);
+  PyErr_NormalizeException(&type, &value, &traceback);
+  py::handle<> htype(py::allow_null(type));
+  py::handle<> hvalue(py::allow_null(value));
+  py::handle<> htraceback(py::allow_null(traceback));
+  if(!htype) {
+    return "unknown Python error";
+  }
+  std::string msg = py::extract<std::string>(py::object(htype).attr("__name__"));
+  if(hvalue) {
+    msg += ": ";
+    msg += py::extract<std::string>(py::str(py::object(hvalue)))();
+  }
+  return msg;
+}
+
+//@}
+
+
 #define SIMULOTTER_MODULE_NAME _simulotter
 
 #define QUOTE_(x) #x
@@ -3,6 +3,7 @@
 #include "display.h"
 #include "physics.h"
 #include "object.h"
+#include "log.h"
 
 
 static void Display_resize(Display& d, int width, int height, py::object mode)
@@ -25,8 +26,10 @@ static py::object Display_get_screen_size(const Display& d)
 static py::object py_event_cls;
 static py::object py_key_enum;
 
-static void Display_handler_cb(py::object cb, Display* d, const SDL_Event* event)
+// run() releases the GIL, handlers acquire it
+static void Display_handler_cb(const PyObjectHolder& cb, Display* d, const SDL_Event* event)
 {
+  PyGILLock lock;
   py::object py_ev = py_event_cls(); // new instance
   // fill py_ev with event infos
   py_ev.attr("type") = event->type;
@@ -51,7 +54,7 @@ static void Display_handler_cb(py::object cb, Display* d, const SDL_Event* event
       throw py::error_already_set();
   }
 
-  py::call<void>(cb.ptr(), py::ptr(d), py_ev);
+  py::call<void>(cb.get().ptr(), py::ptr(d), py_ev);
 }
 
 static void Display_set_handler(Display& d, py::object cb, Uint8 type, py::dict kw)
@@ -64,7 +67,7 @@ static void Display_set_handler(Display& d, py::object cb, Uint8 type, py::dict
       PyErr_SetString(PyExc_TypeError, "callback is not callable");
       throw py::error_already_set();
     }
-    cpp_cb = boost::bind(Display_handler_cb, cb, _1, _2);
+    cpp_cb = boost::bind(Display_handler_cb, PyObjectHolder(cb), _1, _2);
   }
 
   SDL_Event ev;
@@ -114,9 +117,33 @@ static py::tuple Display_set_handler_wrap(py::tuple args, py::dict kw)
 }
 
 
+static void Display_run(Display& d)
+{
+  PyGILRelease nogil;
+  d.run();
+}
+
+static SmartPtr<FrameCapture> Display_get_capture(const Display& d) { return d.getCapture(); }
+static void Display_set_capture(Display& d, const SmartPtr<FrameCapture>& c) { d.setCapture(c); }
+
+static void FrameCapture_close(FrameCapture& c)
+{
+  PyGILRelease nogil;
+  c.close();
+}
+
+
 static btScalar Display_get_draw_epsilon() { return btUnscale(Display::draw_epsilon); }
 static void Display_set_draw_epsilon(btScalar v) { Display::draw_epsilon = btScale(v); }
 
+static void Display_set_time_scale(Display& o, float v)
+{
+  if(!(v > 0)) {
+    throw(Error("time scale must be positive"));
+  }
+  o.time_scale_ = v;
+}
+
 static btTransform Camera_get_trans(const Display::Camera& o) { return btUnscale(o.trans); }
 static void Camera_set_trans(Display::Camera& o, const btTransform& tr) { o.trans = btScale(tr); }
 static SmartPtr<Object> Camera_get_obj(const Display::Camera& o) { return o.obj; }
@@ -129,30 +156,45 @@ static void Camera_set_z_far(Display::Camera& o, float v) { o.z_far = btScale(v)
 
 void python_export_display()
 {
-  py::scope in_Display = py::class_<Display, SmartPtr<Display>, boost::noncopyable>("Display")
-      .def("run", &Display::run)
+  py::scope in_Display = py::class_<Display, SmartPtr<Display>, boost::noncopyable>("Display",
+          py::init<bool>((py::arg("offscreen")=false)))
+      .add_property("offscreen", &Display::isOffscreen)
+      .def("run", &Display_run)
       .def("abort", &Display::abort)
       .add_property("physics",
                     py::make_function(&Display::getPhysics, py::return_internal_reference<>()),
                     &Display::setPhysics)
       .def("update", &Display::update)
+      .def("set_dirty", &Display::setDirty)
       .def("resize", &Display_resize,
            ( py::arg("width"), py::arg("height"), py::arg("mode")=py::object() ))
       .add_property("screen_size", &Display_get_screen_size)
       .def("close", &Display::close)
       .def("screenshot", &Display::savePNGScreenshot)
+      // property required for None conversions
+      .add_property("capture", &Display_get_capture, &Display_set_capture)
+      .add_property("mesh_budget", &Display::getMeshBudget, &Display::setMeshBudget)
+      .add_property("resource_stats", &Display::getResourceStats)
+      .add_property("run_stats", &Display::getRunStats)
       .def("set_handler", py::raw_function(&Display_set_handler_wrap, 3))
       .def("set_default_handlers", &Display::setDefaultHandlers)
       // dynamic configuration
-      .def_readwrite("time_scale", &Display::time_scale_)
+      .add_property("time_scale", py::make_getter(&Display::time_scale_), &Display_set_time_scale)
       .def_readwrite("fps", &Display::fps_)
       .def_readwrite("paused", &Display::paused_)
+      .def_readwrite("threaded", &Display::threaded_)
+      .def_readwrite("fast", &Display::fast_)
+      .def_readwrite("fast_fps", &Display::fast_fps_)
+      .def_readwrite("max_steps_per_frame", &Display::max_steps_per_frame_)
       .def_readwrite("bg_color", &Display::bg_color_)
+      .def_readwrite("osd_rate", &Display::osd_rate_)
       .add_property("camera", py::make_getter(&Display::camera_, py::return_internal_reference<>()))
       // statics
       .add_static_property("draw_epsilon", &Display_get_draw_epsilon, &Display_set_draw_epsilon)
       .def_readwrite("draw_div", &Display::draw_div)
       .def_readwrite("antialias", &Display::antialias)
+      .def_readwrite("lod_levels", &Display::lod_levels)
+      .def_readwrite("lod_size", &Display::lod_size)
       ;
 
   py::class_<Display::Camera, Display::Camera*, boost::noncopyable>("Camera", py::no_init)
@@ -166,6 +208,48 @@ void python_export_display()
       .def("mouse_move", &Display::Camera::mouseMove)
       ;
 
+  py::class_<Display::ResourceStats>("ResourceStats", py::no_init)
+      .def_readonly("display_lists", &Display::ResourceStats::display_lists)
+      .def_readonly("meshes", &Display::ResourceStats::meshes)
+      .def_readonly("mesh_size", &Display::ResourceStats::mesh_size)
+      .def_readonly("released", &Display::ResourceStats::released)
+      .def_readonly("evicted", &Display::ResourceStats::evicted)
+      ;
+
+  py::class_<Display::RunStats>("RunStats", py::no_init)
+      .def_readonly("frames", &Display::RunStats::frames)
+      .def_readonly("idle_frames", &Display::RunStats::idle_frames)
+      .def_readonly("steps", &Display::RunStats::steps)
+      .def_readonly("skipped", &Display::RunStats::skipped)
+      .def_readonly("behind", &Display::RunStats::behind)
+      ;
+
+  py_smart_register<FrameCapture>();
+  {
+    py::class_<FrameCapture, SmartPtr<FrameCapture>, boost::noncopyable> py_capture_cls("FrameCapture", py::no_init);
+    py::scope in_FrameCapture = py_capture_cls;
+
+    py::enum_<FrameCapture::Format>("Format")
+        .value("PNG", FrameCapture::FORMAT_PNG)
+        .value("Y4M", FrameCapture::FORMAT_Y4M)
+        .value("RAW", FrameCapture::FORMAT_RAW)
+        .export_values()  // export in FrameCapture
+        ;
+
+    py_capture_cls
+        .def(py::init<const std::string&, FrameCapture::Format, float, unsigned int, bool>((
+            py::arg("path"), py::arg("format")=FrameCapture::FORMAT_PNG, py::arg("fps")=60,
+            py::arg("pool_size")=8, py::arg("drop")=true)))
+        .add_property("path", py::make_function(&FrameCapture::getPath, py::return_value_policy<py::copy_const_reference>()))
+        .add_property("format", &FrameCapture::getFormat)
+        .def("close", &FrameCapture_close)
+        .add_property("closed", &FrameCapture::isClosed)
+        .add_property("captured", &FrameCapture::getCaptured)
+        .add_property("dropped", &FrameCapture::getDropped)
+        .add_property("written", &FrameCapture::getWritten)
+        ;
+  }
+
   py_event_cls = py::class_<SDL_Event, boost::noncopyable>("Event");
 
   // enums
@@ -9,6 +9,8 @@ void python_export_object();
 void python_export_robot();
 void python_export_sensors();
 void python_export_galipeur();
+void python_export_worldpool();
+void python_export_record();
 #define SIMULOTTER_MODULES_APPLY_EXPR(module) \
     void python_export_##module();
 SIMULOTTER_MODULES_APPLY
@@ -20,6 +22,9 @@ SIMULOTTER_MODULES_APPLY
 
 XBOOST_PYTHON_MODULE(SIMULOTTER_MODULE_NAME)
 {
+  // required to release the GIL and call Python from other threads
+  PyEval_InitThreads();
+
   py::object package = py::scope();
   package.attr("__path__") = SIMULOTTER_MODULE_NAME_STR;
 
@@ -32,6 +37,8 @@ XBOOST_PYTHON_MODULE(SIMULOTTER_MODULE_NAME)
   python_export_robot();
   python_export_sensors();
   python_export_galipeur();
+  python_export_worldpool();
+  python_export_record();
 
   // sub modules
 #define SIMULOTTER_MODULES_APPLY_EXPR(module) \
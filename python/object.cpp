@@ -8,6 +8,12 @@ static void Object_setPos(Object& o, const btVector3& v) { o.setPos(btScale(v));
 static btTransform Object_getTrans(const Object& o) { return btUnscale(o.getTrans()); }
 static void Object_setTrans(Object& o, const btTransform& tr) { o.setTrans(btScale(tr)); }
 
+static int Object_getCollisionGroup(const Object& o) { return o.getCollisionGroup(); }
+static void Object_setCollisionGroup(Object& o, int v) { o.setCollisionFilter(v, o.getCollisionMask()); }
+static int Object_getCollisionMask(const Object& o) { return o.getCollisionMask(); }
+static void Object_setCollisionMask(Object& o, int v) { o.setCollisionFilter(o.getCollisionGroup(), v); }
+static void Object_setCollisionFilter(Object& o, int group, int mask) { o.setCollisionFilter(group, mask); }
+
 static SmartPtr<OGround> OGround_init(const btVector2& size, const Color4& color) { return new OGround(btScale(size), color); }
 static btVector2 OGround_getSize(const OGround& o) { return btUnscale(o.getSize()); }
 
@@ -32,6 +38,18 @@ void python_export_object()
 {
   py_smart_register<Object>();
 
+  py::enum_<CollisionGroup>("CollisionGroup")
+      .value("DEFAULT", COLLISION_DEFAULT)
+      .value("STATIC", COLLISION_STATIC)
+      .value("KINEMATIC", COLLISION_KINEMATIC)
+      .value("DEBRIS", COLLISION_DEBRIS)
+      .value("SENSOR_TRIGGER", COLLISION_SENSOR_TRIGGER)
+      .value("CHARACTER", COLLISION_CHARACTER)
+      .value("MAGNET", COLLISION_MAGNET)
+      .value("USER", COLLISION_USER)
+      .value("ALL", COLLISION_ALL)
+      ;
+
   py::class_<Object, SmartPtr<Object>, boost::noncopyable>("Object", py::no_init)
       .def("addToWorld", &Object::addToWorld)
       .def("removeFromWorld", &Object::removeFromWorld)
@@ -40,6 +58,10 @@ void python_export_object()
       .add_property("trans", &Object_getTrans, &Object_setTrans)
       .add_property("physics", py::make_function(
               &Object::getPhysics, py::return_internal_reference<>()))
+      .def("set_collision_filter", &Object_setCollisionFilter,
+           (py::arg("group"), py::arg("mask")))
+      .add_property("collision_group", &Object_getCollisionGroup, &Object_setCollisionGroup)
+      .add_property("collision_mask", &Object_getCollisionMask, &Object_setCollisionMask)
       ;
 
   py::class_<OSimple, py::bases<Object>, SmartPtr<OSimple>, boost::noncopyable>("OSimple")
@@ -1,7 +1,14 @@
+#include <cstring>
 #include <functional>
+#include <unordered_map>
 #include "python/common.h"
 #include <boost/python/stl_iterator.hpp>
 #include "physics.h"
+#include "object.h"
+#include "record.h"
+#include "profiler.h"
+#include "threadpool.h"
+#include "log.h"
 
 static btScalar Physics_get_world_gravity() { return btUnscale(Physics::world_gravity); }
 static void Physics_set_world_gravity(btScalar v) { Physics::world_gravity = btScale(v); }
@@ -13,20 +20,56 @@ static btVector3 Physics_get_world_aabb_max() { return btUnscale(Physics::world_
 static void Physics_set_world_aabb_max(const btVector3& v) { Physics::world_aabb_max = btScale(v); }
 static void Physics_transform(Physics& ph, const btTransform& tr) { ph.transform(btScale(tr)); }
 
-static void Physics_task_cb(py::object cb, Physics* ph)
+static void Physics_step_many(Physics& ph, unsigned int n)
 {
-  py::call<void>(cb.ptr(), py::ptr(ph));
+  PyGILRelease nogil;
+  ph.stepMany(n);
 }
 
-static void Physics_task_iter(SmartPtr<TaskBasic> task, py::object iter, Physics*)
+static void Physics_run_until(Physics& ph, btScalar time)
 {
-  // note: instantiating the iterator iterate it
-  py::stl_input_iterator<void*> it(iter), end;
-  if(it == end) {
-    task->cancel(); // end, do nothing
+  PyGILRelease nogil;
+  ph.runUntil(time);
+}
+
+/** @brief Call a Python function from a task
+ *
+ * Task callbacks may be called with the GIL released, possibly from threads
+ * not created by Python (e.g. when using a WorldPool). Python errors cannot
+ * be propagated from such threads; they are converted to Error instead.
+ */
+static void Physics_task_call(const std::function<void()>& f)
+{
+  const bool python_thread = PyGILState_GetThisThreadState() != NULL;
+  PyGILLock lock;
+  try {
+    f();
+  } catch(const py::error_already_set&) {
+    if(python_thread) {
+      throw;
+    }
+    throw(Error(py_fetch_error()));
   }
 }
 
+static void Physics_task_cb(const PyObjectHolder& cb, Physics* ph)
+{
+  Physics_task_call([&]() {
+    py::call<void>(cb.get().ptr(), py::ptr(ph));
+  });
+}
+
+static void Physics_task_iter(SmartPtr<TaskBasic> task, const PyObjectHolder& iter, Physics*)
+{
+  Physics_task_call([&]() {
+    // note: instantiating the iterator iterate it
+    py::stl_input_iterator<void*> it(iter.get()), end;
+    if(it == end) {
+      task->cancel(); // end, do nothing
+    }
+  });
+}
+
 static SmartPtr<TaskBasic> Task_init(py::object cb, py::object period)
 {
   SmartPtr<TaskBasic> task;
@@ -38,12 +81,12 @@ static SmartPtr<TaskBasic> Task_init(py::object cb, py::object period)
   }
 
   if(PyObject_HasAttrString(cb.ptr(), "__iter__")) {
-    task->setCallback(boost::bind(Physics_task_iter, task, cb, _1));
+    task->setCallback(boost::bind(Physics_task_iter, task, PyObjectHolder(cb), _1));
   } else if(!PyCallable_Check(cb.ptr())) {
     PyErr_SetString(PyExc_TypeError, "callback is not callable");
     throw py::error_already_set();
   } else {
-    task->setCallback(boost::bind(Physics_task_cb, cb, _1));
+    task->setCallback(boost::bind(Physics_task_cb, PyObjectHolder(cb), _1));
   }
   return task;
 }
@@ -64,16 +107,231 @@ static SmartPtr<TaskBasic> Physics_schedule_cb(Physics& ph, py::object cb, py::o
   return Physics_schedule_task(ph, cpp_task, time);
 }
 
+/** @brief Convert profiling statistics to a dict
+ *
+ * Values are multiplied by \e scale (e.g. to convert nanoseconds to
+ * seconds). Histogram is not scaled.
+ */
+static py::dict ProfileStats_to_dict(const ProfileStats& stats, double scale)
+{
+  py::dict d;
+  d["count"] = stats.getCount();
+  d["total"] = stats.getTotal() * scale;
+  d["min"] = stats.getMin() * scale;
+  d["max"] = stats.getMax() * scale;
+  d["mean"] = stats.getCount() ? stats.getTotal() * scale / stats.getCount() : 0.;
+  py::list histogram;
+  const uint64_t* buckets = stats.getHistogram();
+  for(unsigned int i=0; i<ProfileStats::BUCKETS; i++) {
+    histogram.append(buckets[i]);
+  }
+  d["histogram"] = histogram;
+  return d;
+}
+
+/** @brief Writable array of scalars, from a Python buffer
+ *
+ * The object must support the buffer protocol (e.g. a numpy array) and be
+ * a contiguous array of at least \e n scalars, of the same type than
+ * btScalar. \e None gives a \e NULL array.
+ */
+class PyScalarBuffer: boost::noncopyable
+{
+ public:
+  PyScalarBuffer(const py::object& o, size_t n, const char* name): data_(NULL)
+  {
+    if(o.ptr() == Py_None) {
+      return;
+    }
+    if(!PyObject_CheckBuffer(o.ptr())) {
+      PyErr_Format(PyExc_TypeError, "%s does not support the buffer protocol", name);
+      throw py::error_already_set();
+    }
+    if(PyObject_GetBuffer(o.ptr(), &view_, PyBUF_WRITABLE|PyBUF_FORMAT|PyBUF_C_CONTIGUOUS) < 0) {
+      throw py::error_already_set();
+    }
+    // format may be prefixed by a byte order character
+    const char type = sizeof(btScalar) == sizeof(double) ? 'd' : 'f';
+    const size_t len = view_.format ? strlen(view_.format) : 0;
+    if(len == 0 || view_.format[len-1] != type || view_.itemsize != sizeof(btScalar)) {
+      PyBuffer_Release(&view_);
+      PyErr_Format(PyExc_TypeError, "%s items must be of type '%c'", name, type);
+      throw py::error_already_set();
+    }
+    if((size_t)view_.len < n * sizeof(btScalar)) {
+      PyBuffer_Release(&view_);
+      PyErr_Format(PyExc_ValueError, "%s is too small, %u values expected", name, (unsigned int)n);
+      throw py::error_already_set();
+    }
+    data_ = static_cast<btScalar*>(view_.buf);
+  }
+  ~PyScalarBuffer()
+  {
+    if(data_) {
+      PyBuffer_Release(&view_);
+    }
+  }
+  btScalar* data() const { return data_; }
+
+ private:
+  Py_buffer view_;
+  btScalar* data_;
+};
+
+static size_t Physics_export_states(const Physics& ph, py::object pos, py::object rot, py::object lin_vel, py::object ang_vel)
+{
+  const size_t n = ph.getObjs().size();
+  PyScalarBuffer buf_pos(pos, 3*n, "pos");
+  PyScalarBuffer buf_rot(rot, 4*n, "rot");
+  PyScalarBuffer buf_lin_vel(lin_vel, 3*n, "lin_vel");
+  PyScalarBuffer buf_ang_vel(ang_vel, 3*n, "ang_vel");
+  ph.exportStates(buf_pos.data(), buf_rot.data(), buf_lin_vel.data(), buf_ang_vel.data());
+  return n;
+}
+
+static py::list Physics_get_objects(const Physics& ph)
+{
+  py::list l;
+  for(auto& obj : ph.getObjs()) {
+    l.append(obj);
+  }
+  return l;
+}
+
+static void Physics_subscribe_contacts(Physics& ph, const Object& obj, bool begin, bool persist, bool end)
+{
+  const btCollisionObject* co = obj.getMainBody();
+  if(co == NULL) {
+    PyErr_SetString(PyExc_ValueError, "object has no main body");
+    throw py::error_already_set();
+  }
+  const unsigned int flags = (begin ? ContactEvent::BEGIN : 0)
+      | (persist ? ContactEvent::PERSIST : 0) | (end ? ContactEvent::END : 0);
+  if(flags == 0) {
+    ph.getContacts().unsubscribe(co);
+  } else {
+    ph.getContacts().subscribe(co, &ph.getContactQueue(), flags);
+  }
+}
+
+static void Physics_unsubscribe_contacts(Physics& ph, const Object& obj)
+{
+  if(obj.getMainBody()) {
+    ph.getContacts().unsubscribe(obj.getMainBody());
+  }
+}
+
+/// Return queued contact events as a list of tuples, clear the queue
+static py::list Physics_pop_contacts(Physics& ph)
+{
+  py::list l;
+  ContactQueue& queue = ph.getContactQueue();
+  if(queue.getEvents().empty()) {
+    return l;
+  }
+  // objects of event bodies, bodies which are not main bodies give None
+  std::unordered_map<const btCollisionObject*, py::object> objects;
+  for(auto& obj : ph.getObjs()) {
+    if(obj->getMainBody()) {
+      objects[obj->getMainBody()] = py::object(obj);
+    }
+  }
+  auto body_object = [&](const btCollisionObject* co) {
+    auto it = objects.find(co);
+    return it == objects.end() ? py::object() : it->second;
+  };
+  for(auto& ev : queue.getEvents()) {
+    l.append(py::make_tuple(
+        ev.type, body_object(ev.body_a), body_object(ev.body_b),
+        btUnscale(ev.point), ev.normal, btUnscale(ev.distance), ev.impulse));
+  }
+  queue.clear();
+  return l;
+}
+
+static void Physics_invalidate_rays(Physics& ph) { ph.getRays().invalidate(); }
+
+static bool Physics_get_parallel_solver(const Physics& ph)
+{
+  return ph.getSolverThreadPool() != NULL;
+}
+
+static void Physics_set_parallel_solver(Physics& ph, bool enabled)
+{
+  ph.setSolverThreadPool(enabled ? &ThreadPool::shared() : NULL);
+}
+
+static py::dict Physics_profile(const Physics& ph)
+{
+  py::dict d;
+  const Profiler* profiler = ph.getProfiler();
+  if(profiler == NULL) {
+    return d;
+  }
+  py::dict phases;
+  for(unsigned int i=0; i<Profiler::PHASE_NB; i++) {
+    Profiler::Phase phase = (Profiler::Phase)i;
+    phases[Profiler::getPhaseName(phase)] = ProfileStats_to_dict(profiler->getPhase(phase), 1e-9);
+  }
+  py::dict objects;
+  for(auto& kv : profiler->getObjects()) {
+    objects[kv.first] = ProfileStats_to_dict(kv.second, 1e-9);
+  }
+  d["steps"] = profiler->getPhase(Profiler::PHASE_STEP).getCount();
+  d["phases"] = phases;
+  d["objects"] = objects;
+  d["tasks"] = ProfileStats_to_dict(profiler->getTasks(), 1);
+  return d;
+}
+
 void python_export_physics()
 {
-  py::scope in_Physics = py::class_<Physics, SmartPtr<Physics>, boost::noncopyable>("Physics", py::no_init)
-      .def(py::init<btScalar>((py::arg("step_dt")=0.002)))
+  py::class_<Physics, SmartPtr<Physics>, boost::noncopyable> py_physics_cls("Physics", py::no_init);
+  py::scope in_Physics = py_physics_cls;
+
+  // defined first, used as default value
+  py::enum_<Physics::BroadphaseType>("Broadphase")
+      .value("AXIS_SWEEP", Physics::BROADPHASE_AXIS_SWEEP)
+      .value("AXIS_SWEEP_32", Physics::BROADPHASE_AXIS_SWEEP_32)
+      .value("DBVT", Physics::BROADPHASE_DBVT)
+      ;
+
+  py::enum_<ContactEvent::Type>("Contact")
+      .value("BEGIN", ContactEvent::BEGIN)
+      .value("PERSIST", ContactEvent::PERSIST)
+      .value("END", ContactEvent::END)
+      ;
+
+  py_physics_cls
+      .def(py::init<btScalar, Physics::BroadphaseType>((py::arg("step_dt")=0.002, py::arg("broadphase")=Physics::BROADPHASE_AXIS_SWEEP)))
       .def("step", &Physics::step)
+      .def("step_many", &Physics_step_many, py::arg("n"))
+      .def("run_until", &Physics_run_until, py::arg("time"))
       .add_property("step_dt", &Physics::getStepDt)
       .add_property("time", &Physics::getTime)
       .def("schedule", &Physics_schedule_task, ( py::arg("task"), py::arg("time")=py::object() ))
       .def("schedule", &Physics_schedule_cb, ( py::arg("cb"), py::arg("period"), py::arg("time")=py::object() ))
       .def("transform", &Physics_transform)
+      .def("snapshot", &Physics::snapshot)
+      .def("restore", &Physics::restore, py::arg("snapshot"))
+      .def("start_recording", &Physics::startRecording)
+      .def("stop_recording", &Physics::stopRecording)
+      .add_property("broadphase", &Physics::getBroadphaseType)
+      .add_property("broadphase_capacity", &Physics::getBroadphaseCapacity)
+      .add_property("recording", &Physics::isRecording)
+      .add_property("profiling", &Physics::isProfiling, &Physics::setProfiling)
+      .def("profile", &Physics_profile)
+      .def("reset_profile", &Physics::resetProfiling)
+      .add_property("parallel_solver", &Physics_get_parallel_solver, &Physics_set_parallel_solver)
+      .add_property("objects", &Physics_get_objects)
+      .def("invalidate_rays", &Physics_invalidate_rays)
+      .def("subscribe_contacts", &Physics_subscribe_contacts, (
+              py::arg("obj"), py::arg("begin")=true, py::arg("persist")=false, py::arg("end")=true ))
+      .def("unsubscribe_contacts", &Physics_unsubscribe_contacts, py::arg("obj"))
+      .def("pop_contacts", &Physics_pop_contacts)
+      .def("export_states", &Physics_export_states, (
+              py::arg("pos")=py::object(), py::arg("rot")=py::object(),
+              py::arg("lin_vel")=py::object(), py::arg("ang_vel")=py::object() ))
       // statics
       .add_static_property("world_gravity", &Physics_get_world_gravity, &Physics_set_world_gravity)
       .add_static_property("margin_epsilon", &Physics_get_margin_epsilon, &Physics_set_margin_epsilon)
@@ -88,5 +346,9 @@ void python_export_physics()
       .def("cancel", &TaskBasic::cancel)
       .add_property("cancelled", &TaskBasic::cancelled)
       ;
+
+  py::class_<Physics::Snapshot, SmartPtr<Physics::Snapshot>, boost::noncopyable>("Snapshot", py::no_init)
+      .add_property("time", &Physics::Snapshot::getTime)
+      ;
 }
 
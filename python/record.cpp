@@ -0,0 +1,37 @@
+#include "python/common.h"
+#include "record.h"
+
+
+static void Replayer_run(Replayer& replayer)
+{
+  PyGILRelease nogil;
+  replayer.run();
+}
+
+static py::object Replayer_get_divergence(const Replayer& replayer)
+{
+  int step = replayer.getDivergence();
+  return step < 0 ? py::object() : py::object(step);
+}
+
+void python_export_record()
+{
+  py::class_<Journal, SmartPtr<Journal>, boost::noncopyable>("Journal", py::no_init)
+      .add_property("step_dt", &Journal::getStepDt)
+      .add_property("steps", &Journal::getStepCount)
+      .add_property("size", &Journal::getSize)
+      .def("save", &Journal::save, py::arg("filename"))
+      .def("load", &Journal::load, py::arg("filename"))
+      .staticmethod("load")
+      ;
+
+  py::class_<Replayer, SmartPtr<Replayer>, boost::noncopyable>("Replayer", py::no_init)
+      .def(py::init<Physics*, Journal*>((py::arg("physics"), py::arg("journal"))))
+      .def("step", &Replayer::step)
+      .def("run", &Replayer_run)
+      .add_property("current_step", &Replayer::getStep)
+      .add_property("divergence", &Replayer_get_divergence)
+      .add_property("tasks_fired", &Replayer::getTasksFired)
+      ;
+}
+
@@ -1,3 +1,4 @@
+#include <vector>
 #include "python/common.h"
 #include "sensors.h"
 
@@ -16,6 +17,25 @@ static void SRay_set_attach_obj(SRay& o, const SmartPtr<Object>& obj) { o.setAtt
 static btTransform SRay_get_attach_point(const SRay& o) { return btUnscale(o.getAttachPoint()); }
 static void SRay_set_attach_point(SRay& o, const btTransform& tr) { o.setAttachPoint(btScale(tr)); }
 
+static SmartPtr<SLidar> SLidar_init(btScalar min, btScalar max, unsigned int beams, btScalar scan_rate)
+{
+  return new SLidar(btScale(min), btScale(max), beams, scan_rate);
+}
+
+/// Return the last scan as an array.array of scalars
+static py::object SLidar_get_scan(const SLidar& o)
+{
+  const std::vector<btScalar>& scan = o.getScan();
+  std::vector<btScalar> values(scan.size());
+  for(size_t i=0; i<scan.size(); i++) {
+    values[i] = scan[i] < 0 ? -1.0 : btUnscale(scan[i]);
+  }
+  const char* type = sizeof(btScalar) == sizeof(double) ? "d" : "f";
+  py::object data(py::handle<>(PyString_FromStringAndSize(
+      reinterpret_cast<const char*>(values.data()), values.size()*sizeof(btScalar))));
+  return py::import("array").attr("array")(type, data);
+}
+
 void python_export_sensors()
 {
   py::class_<SRay, py::bases<Object>, SmartPtr<SRay>, boost::noncopyable>("SRay", py::no_init)
@@ -25,5 +45,14 @@ void python_export_sensors()
       .add_property("attach_point", &SRay_get_attach_point, &SRay_set_attach_point)
       .add_property("color", &SRay::getColor, &SRay::setColor)
       ;
+
+  py::class_<SLidar, py::bases<SRay>, SmartPtr<SLidar>, boost::noncopyable>("SLidar", py::no_init)
+      .def("__init__", py::make_constructor(&SLidar_init, py::default_call_policies(), (
+                  py::arg("min"), py::arg("max"), py::arg("beams"), py::arg("scan_rate")=0 )))
+      .add_property("beams", &SLidar::getBeams)
+      .add_property("scan_rate", &SLidar::getScanRate, &SLidar::setScanRate)
+      .add_property("scan", &SLidar_get_scan)
+      .add_property("scan_count", &SLidar::getScanCount)
+      ;
 }
 
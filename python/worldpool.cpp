@@ -0,0 +1,43 @@
+#include "python/common.h"
+#include "worldpool.h"
+
+
+static py::list WorldPool_get_worlds(const WorldPool& pool)
+{
+  py::list l;
+  for(auto& ph : pool.getWorlds()) {
+    l.append(ph);
+  }
+  return l;
+}
+
+static py::list WorldPool_run(WorldPool& pool, btScalar duration)
+{
+  std::vector<WorldPool::Result> results;
+  {
+    PyGILRelease nogil;
+    results = pool.run(duration);
+  }
+  py::list l;
+  for(auto& result : results) {
+    if(result.success) {
+      l.append(py::object());
+    } else {
+      l.append(result.error);
+    }
+  }
+  return l;
+}
+
+void python_export_worldpool()
+{
+  py::class_<WorldPool, SmartPtr<WorldPool>, boost::noncopyable>("WorldPool", py::no_init)
+      .def(py::init<unsigned int>((py::arg("threads")=0)))
+      .def("add_world", &WorldPool::addWorld)
+      .def("clear_worlds", &WorldPool::clearWorlds)
+      .add_property("worlds", &WorldPool_get_worlds)
+      .add_property("threads", &WorldPool::getThreadCount)
+      .def("run", &WorldPool_run, py::arg("duration"))
+      ;
+}
+
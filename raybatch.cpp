@@ -0,0 +1,161 @@
+#include <algorithm>
+#include <unordered_map>
+#include "raybatch.h"
+#include "sensors.h"
+#include "physics.h"
+#include "threadpool.h"
+
+
+/// Collect bodies whose bounding box overlaps a box
+class CandidateCollector: public btBroadphaseAabbCallback
+{
+ public:
+  CandidateCollector(std::vector<btCollisionObject*>& candidates): candidates_(candidates) {}
+  virtual bool process(const btBroadphaseProxy* proxy)
+  {
+    candidates_.push_back(static_cast<btCollisionObject*>(proxy->m_clientObject));
+    return true;
+  }
+ private:
+  std::vector<btCollisionObject*>& candidates_;
+};
+
+
+RayBatch::RayBatch(Physics* physics):
+    physics_(physics), step_(0), revision_(0), valid_(false)
+{
+}
+
+RayBatch::~RayBatch()
+{
+}
+
+
+RegistryHandle RayBatch::add(SRay* sensor)
+{
+  valid_ = false;
+  return sensors_.add(sensor);
+}
+
+void RayBatch::remove(RegistryHandle& h)
+{
+  valid_ = false;
+  sensors_.remove(h);
+}
+
+btScalar RayBatch::getHit(const RegistryHandle& h)
+{
+  if(!valid_ || step_ != physics_->getStepIndex() || revision_ != physics_->getRevision()) {
+    update();
+  }
+  return hits_[sensors_.index(h)];
+}
+
+
+void RayBatch::update()
+{
+  // group sensors by attach object and filter, unattached sensors are alone
+  groups_.clear();
+  std::unordered_map<const Object*, std::vector<size_t>> group_indexes;
+  for(size_t i=0; i<sensors_.size(); i++) {
+    const SRay* sensor = sensors_[i];
+    const Object* obj = sensor->getAttachObject();
+    const CollisionFilterInt filter_group = sensor->getCollisionGroup();
+    const CollisionFilterInt filter_mask = sensor->getCollisionMask();
+    if(obj) {
+      std::vector<size_t>& indexes = group_indexes[obj];
+      auto it = std::find_if(indexes.begin(), indexes.end(), [&](size_t j) {
+        return groups_[j].filter_group == filter_group && groups_[j].filter_mask == filter_mask;
+      });
+      if(it != indexes.end()) {
+        groups_[*it].sensors.push_back(i);
+        continue;
+      }
+      indexes.push_back(groups_.size());
+    }
+    groups_.push_back(Group());
+    groups_.back().obj = obj;
+    groups_.back().filter_group = filter_group;
+    groups_.back().filter_mask = filter_mask;
+    groups_.back().sensors.push_back(i);
+  }
+
+  hits_.assign(sensors_.size(), -1);
+  ThreadPool* pool = physics_->getSolverThreadPool();
+  if(pool && groups_.size() > 1) {
+    pool->parallelFor(groups_.size(), [&](unsigned int i) {
+      std::vector<btCollisionObject*> candidates;
+      updateGroup(groups_[i], candidates);
+    });
+  } else {
+    std::vector<btCollisionObject*> candidates;
+    for(auto& group : groups_) {
+      updateGroup(group, candidates);
+    }
+  }
+
+  step_ = physics_->getStepIndex();
+  revision_ = physics_->getRevision();
+  valid_ = true;
+}
+
+
+void RayBatch::updateGroup(const Group& group, std::vector<btCollisionObject*>& candidates)
+{
+  const size_t n = group.sensors.size();
+  btAlignedObjectArray<btVector3> from, to;
+  from.resize(n);
+  to.resize(n);
+  std::vector<btScalar> fractions(n);
+  for(size_t i=0; i<n; i++) {
+    sensors_[group.sensors[i]]->getRay(from[i], to[i]);
+  }
+  castRays(physics_->getWorld(), n, &from[0], &to[0], &fractions[0], candidates, group.filter_group, group.filter_mask);
+  for(size_t i=0; i<n; i++) {
+    hits_[group.sensors[i]] = fractions[i];
+  }
+}
+
+
+void RayBatch::castRays(btCollisionWorld* world, size_t n, const btVector3* from, const btVector3* to, btScalar* fractions, std::vector<btCollisionObject*>& candidates,
+                        CollisionFilterInt group, CollisionFilterInt mask)
+{
+  if(n == 0) {
+    return;
+  }
+
+  // traverse the broadphase once, for all rays
+  btVector3 aabb_min = from[0];
+  btVector3 aabb_max = from[0];
+  for(size_t i=0; i<n; i++) {
+    aabb_min.setMin(from[i]);
+    aabb_min.setMin(to[i]);
+    aabb_max.setMax(from[i]);
+    aabb_max.setMax(to[i]);
+  }
+  candidates.clear();
+  CandidateCollector collector(candidates);
+  world->getBroadphase()->aabbTest(aabb_min, aabb_max, collector);
+
+  // same tests than btCollisionWorld::rayTest(), on candidates only
+  for(size_t i=0; i<n; i++) {
+    const btTransform from_tr(btMatrix3x3::getIdentity(), from[i]);
+    const btTransform to_tr(btMatrix3x3::getIdentity(), to[i]);
+    btCollisionWorld::ClosestRayResultCallback ray_cb(from[i], to[i]);
+    ray_cb.m_collisionFilterGroup = group;
+    ray_cb.m_collisionFilterMask = mask;
+    for(auto co : candidates) {
+      const btBroadphaseProxy* proxy = co->getBroadphaseHandle();
+      if(!ray_cb.needsCollision(const_cast<btBroadphaseProxy*>(proxy))) {
+        continue;
+      }
+      btScalar lambda = ray_cb.m_closestHitFraction;
+      btVector3 normal;
+      if(btRayAabb(from[i], to[i], proxy->m_aabbMin, proxy->m_aabbMax, lambda, normal)) {
+        btCollisionWorld::rayTestSingle(from_tr, to_tr, co, co->getCollisionShape(), co->getWorldTransform(), ray_cb);
+      }
+    }
+    fractions[i] = ray_cb.hasHit() ? ray_cb.m_closestHitFraction : -1;
+  }
+}
+
@@ -0,0 +1,95 @@
+#ifndef RAYBATCH_H_
+#define RAYBATCH_H_
+
+///@file
+
+#include <cstdint>
+#include <vector>
+#include "smart.h"
+#include "registry.h"
+#include "object.h"
+
+class Physics;
+class SRay;
+
+
+/** @brief Batched ray tests of a world's ray sensors
+ *
+ * All sensors of a world are cast at once, the first time a result is
+ * requested after a step. Results are then cached until the next step or
+ * until the world revision changes (e.g. an object is moved).
+ *
+ * Sensors attached to the same object and with the same collision filter
+ * are grouped: the broadphase is traversed once per group, using the
+ * bounding box of its rays, then each ray is tested against candidate bodies
+ * only. Groups are tested concurrently when the world has a solver thread
+ * pool.
+ */
+class RayBatch
+{
+ public:
+  RayBatch(Physics* physics);
+  ~RayBatch();
+
+  /// Add a sensor, return its handle
+  RegistryHandle add(SRay* sensor);
+  /// Remove a sensor, invalidate its handle
+  void remove(RegistryHandle& h);
+
+  /** @brief Get hit fraction of a sensor's ray
+   *
+   * @retval fraction of the ray, in <tt>[0,1]</tt>, on success
+   * @retval -1.0 if there is no hit
+   */
+  btScalar getHit(const RegistryHandle& h);
+
+  /// Discard cached results
+  void invalidate() { valid_ = false; }
+
+  /** @brief Cast several rays at once
+   *
+   * The broadphase is traversed once with the bounding box of all rays.
+   * Rays are then tested against overlapping bodies only.
+   *
+   * @param world  world to test rays against
+   * @param n  ray count
+   * @param from  ray starts
+   * @param to  ray ends
+   * @param fractions  hit fraction of each ray, -1.0 if there is no hit
+   * @param candidates  buffer for overlapping bodies
+   * @param group  collision group of the rays
+   * @param mask  collision mask of the rays
+   */
+  static void castRays(btCollisionWorld* world, size_t n, const btVector3* from, const btVector3* to, btScalar* fractions, std::vector<btCollisionObject*>& candidates,
+                       CollisionFilterInt group=COLLISION_DEFAULT, CollisionFilterInt mask=COLLISION_ALL);
+
+ private:
+  /// Sensors attached to the same object, with the same collision filter
+  struct Group
+  {
+    const Object* obj;
+    CollisionFilterInt filter_group;
+    CollisionFilterInt filter_mask;
+    /// Sensor indexes, in sensors_
+    std::vector<size_t> sensors;
+  };
+
+  /// Cast all rays
+  void update();
+  /// Cast rays of a group
+  void updateGroup(const Group& group, std::vector<btCollisionObject*>& candidates);
+
+  Physics* physics_;
+  DenseRegistry<SRay*> sensors_;
+  /// Hit fraction of each sensor, in sensors_ order, negative if no hit
+  std::vector<btScalar> hits_;
+  std::vector<Group> groups_;
+  /// Step of cached results
+  uint64_t step_;
+  /// World revision of cached results
+  uint64_t revision_;
+  bool valid_;
+};
+
+
+#endif
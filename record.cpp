@@ -0,0 +1,393 @@
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include "record.h"
+#include "object.h"
+#include "log.h"
+
+
+/// Magic value at the beginning of journal files
+static const char journal_magic[8] = { 'S','O','J','O','U','R','N','2' };
+
+
+/** @brief Return world objects, ordered by main body index
+ *
+ * Objects without main body are skipped. If such objects have a state, it
+ * would not be possible to identify them on replay: an error is raised.
+ */
+static std::vector<SmartPtr<Object>> sorted_objects(Physics* ph)
+{
+  const btCollisionObjectArray& cos = ph->getWorld()->getCollisionObjectArray();
+  std::vector<std::pair<int, Object*>> indexed;
+  for(auto& obj : ph->getObjs()) {
+    const btCollisionObject* co = obj->getMainBody();
+    if(co == NULL) {
+      StateBuffer buf;
+      buf.setPhysics(ph);
+      obj->saveState(buf);
+      if(buf.size() > 0) {
+        throw(Error("cannot identify object with a state but no main body"));
+      }
+      continue;
+    }
+    int index = cos.findLinearSearch(const_cast<btCollisionObject*>(co));
+    if(index == cos.size()) {
+      throw(Error("object's main body is not in the world"));
+    }
+    indexed.push_back(std::make_pair(index, obj.get()));
+  }
+  std::sort(indexed.begin(), indexed.end());
+  std::vector<SmartPtr<Object>> objects(indexed.size());
+  for(size_t i=0; i<indexed.size(); i++) {
+    objects[i] = indexed[i].second;
+  }
+  return objects;
+}
+
+/// Return the hash (FNV-1a) of all body states
+static uint64_t body_states_hash(const void* p, size_t n)
+{
+  const unsigned char* data = static_cast<const unsigned char*>(p);
+  uint64_t h = 14695981039346656037ULL;
+  for(size_t i=0; i<n; i++) {
+    h = (h ^ data[i]) * 1099511628211ULL;
+  }
+  return h;
+}
+
+
+Journal::Journal():
+    step_dt_(0), body_count_(0), object_count_(0), step_count_(0)
+{
+}
+
+void Journal::save(const std::string& filename) const
+{
+  std::ofstream fout(filename.c_str(), std::ios::out|std::ios::binary);
+  if(!fout) {
+    throw(Error("cannot open journal file '%s'", filename.c_str()));
+  }
+  const std::vector<char>& data = data_.getData();
+  uint64_t size = data.size();
+  fout.write(journal_magic, sizeof(journal_magic));
+  fout.write((const char*)&step_dt_, sizeof(step_dt_));
+  fout.write((const char*)&body_count_, sizeof(body_count_));
+  fout.write((const char*)&object_count_, sizeof(object_count_));
+  fout.write((const char*)&step_count_, sizeof(step_count_));
+  fout.write((const char*)&size, sizeof(size));
+  if(size > 0) {
+    fout.write(&data[0], size);
+  }
+  if(!fout) {
+    throw(Error("cannot write journal file '%s'", filename.c_str()));
+  }
+}
+
+SmartPtr<Journal> Journal::load(const std::string& filename)
+{
+  std::ifstream fin(filename.c_str(), std::ios::in|std::ios::binary);
+  if(!fin) {
+    throw(Error("cannot open journal file '%s'", filename.c_str()));
+  }
+  SmartPtr<Journal> journal = new Journal();
+  char magic[sizeof(journal_magic)];
+  uint64_t size;
+  fin.read(magic, sizeof(magic));
+  fin.read((char*)&journal->step_dt_, sizeof(journal->step_dt_));
+  fin.read((char*)&journal->body_count_, sizeof(journal->body_count_));
+  fin.read((char*)&journal->object_count_, sizeof(journal->object_count_));
+  fin.read((char*)&journal->step_count_, sizeof(journal->step_count_));
+  fin.read((char*)&size, sizeof(size));
+  if(!fin || memcmp(magic, journal_magic, sizeof(magic)) != 0) {
+    throw(Error("invalid journal file '%s'", filename.c_str()));
+  }
+  std::vector<char> data(size);
+  if(size > 0) {
+    fin.read(&data[0], size);
+    if(!fin) {
+      throw(Error("truncated journal file '%s'", filename.c_str()));
+    }
+  }
+  journal->data_.setData(data);
+  return journal;
+}
+
+
+Recorder::Recorder(Physics* ph):
+    physics_(ph), journal_(new Journal())
+{
+  btDynamicsWorld* world = ph->getWorld();
+  const btCollisionObjectArray& cos = world->getCollisionObjectArray();
+  bodies_.resize(cos.size());
+  for(int i=0; i<cos.size(); i++) {
+    bodies_[i] = cos[i];
+  }
+  objects_ = sorted_objects(ph);
+
+  journal_->step_dt_ = ph->getStepDt();
+  journal_->body_count_ = bodies_.size();
+  journal_->object_count_ = objects_.size();
+  StateBuffer& data = journal_->data_;
+  data.setPhysics(ph);
+
+  // initial state
+  data.write(ph->getStepIndex());
+
+  object_states_.resize(objects_.size());
+  for(size_t i=0; i<objects_.size(); i++) {
+    StateBuffer buf;
+    buf.setPhysics(ph);
+    objects_[i]->saveState(buf);
+    object_states_[i] = buf.getData();
+    data.writeVector(object_states_[i]);
+  }
+
+  body_states_.resize(bodies_.size());
+  for(size_t i=0; i<bodies_.size(); i++) {
+    Physics::saveBodyState(bodies_[i], body_states_[i]);
+  }
+  data.writeVector(body_states_);
+
+  constraint_states_.resize(world->getNumConstraints());
+  for(size_t i=0; i<constraint_states_.size(); i++) {
+    Physics::saveConstraintState(world->getConstraint(i), constraint_states_[i]);
+  }
+  data.writeVector(constraint_states_);
+}
+
+
+void Recorder::recordChanges()
+{
+  checkWorld();
+  btDynamicsWorld* world = physics_->getWorld();
+  StateBuffer& data = journal_->data_;
+
+  data.write(physics_->getStepIndex());
+
+  // objects first, restoring them may add or remove constraints
+  std::vector<uint32_t> changed;
+  for(size_t i=0; i<objects_.size(); i++) {
+    StateBuffer buf;
+    buf.setPhysics(physics_);
+    objects_[i]->saveState(buf);
+    if(buf.getData() != object_states_[i]) {
+      changed.push_back(i);
+      object_states_[i] = buf.getData();
+    }
+  }
+  data.write((uint32_t)changed.size());
+  for(auto i : changed) {
+    data.write(i);
+    data.writeVector(object_states_[i]);
+  }
+
+  changed.clear();
+  for(size_t i=0; i<bodies_.size(); i++) {
+    BodyState state;
+    Physics::saveBodyState(bodies_[i], state);
+    if(memcmp(&state, &body_states_[i], sizeof(state)) != 0) {
+      changed.push_back(i);
+      body_states_[i] = state;
+    }
+  }
+  data.write((uint32_t)changed.size());
+  for(auto i : changed) {
+    data.write(i);
+    data.write(body_states_[i]);
+  }
+
+  // constraints are compared by index
+  // new constraints are always written
+  changed.clear();
+  const size_t nconstraints = world->getNumConstraints();
+  constraint_states_.resize(nconstraints);
+  for(size_t i=0; i<nconstraints; i++) {
+    ConstraintState state;
+    Physics::saveConstraintState(world->getConstraint(i), state);
+    if(memcmp(&state, &constraint_states_[i], sizeof(state)) != 0) {
+      changed.push_back(i);
+      constraint_states_[i] = state;
+    }
+  }
+  data.write((uint32_t)nconstraints);
+  data.write((uint32_t)changed.size());
+  for(auto i : changed) {
+    data.write(i);
+    data.write(constraint_states_[i]);
+  }
+}
+
+void Recorder::recordSimulation()
+{
+  // simulation only modifies bodies, update their saved states
+  for(size_t i=0; i<bodies_.size(); i++) {
+    Physics::saveBodyState(bodies_[i], body_states_[i]);
+  }
+  uint64_t h = 0;
+  if(!body_states_.empty()) {
+    h = body_states_hash(&body_states_[0], body_states_.size()*sizeof(BodyState));
+  }
+  journal_->data_.write(h);
+}
+
+void Recorder::recordTasks(unsigned int n)
+{
+  journal_->data_.write((uint32_t)n);
+  journal_->step_count_++;
+}
+
+void Recorder::checkWorld() const
+{
+  const btCollisionObjectArray& cos = physics_->getWorld()->getCollisionObjectArray();
+  if(cos.size() != (int)bodies_.size()) {
+    throw(Error("world bodies changed during the recording"));
+  }
+  for(int i=0; i<cos.size(); i++) {
+    if(cos[i] != bodies_[i]) {
+      throw(Error("world bodies changed during the recording"));
+    }
+  }
+  for(auto& obj : objects_) {
+    if(obj->getPhysics() != physics_) {
+      throw(Error("world objects changed during the recording"));
+    }
+  }
+}
+
+
+Replayer::Replayer(Physics* ph, Journal* journal):
+    physics_(ph), journal_(journal),
+    step_(0), divergence_(-1), tasks_fired_(0)
+{
+  if(ph->getStepDt() != journal->step_dt_) {
+    throw(Error("journal step duration does not match the world"));
+  }
+  btDynamicsWorld* world = ph->getWorld();
+  const btCollisionObjectArray& cos = world->getCollisionObjectArray();
+  if(cos.size() != (int)journal->body_count_) {
+    throw(Error("journal bodies do not match the world"));
+  }
+  objects_ = sorted_objects(ph);
+  if(objects_.size() != journal->object_count_) {
+    throw(Error("journal objects do not match the world"));
+  }
+
+  data_.setPhysics(ph);
+  data_.setData(journal->data_.getData());
+
+  // initial state
+  uint64_t step_index;
+  data_.read(step_index);
+  ph->setStepIndex(step_index);
+
+  std::vector<char> obj_state;
+  StateBuffer buf;
+  buf.setPhysics(ph);
+  for(auto& obj : objects_) {
+    data_.readVector(obj_state);
+    buf.setData(obj_state);
+    obj->restoreState(buf);
+  }
+
+  std::vector<BodyState> body_states;
+  data_.readVector(body_states);
+  for(size_t i=0; i<body_states.size(); i++) {
+    Physics::restoreBodyState(cos[i], body_states[i]);
+  }
+
+  std::vector<ConstraintState> constraint_states;
+  data_.readVector(constraint_states);
+  if((int)constraint_states.size() != world->getNumConstraints()) {
+    throw(Error("journal constraints do not match the world"));
+  }
+  for(size_t i=0; i<constraint_states.size(); i++) {
+    btTypedConstraint* constraint = world->getConstraint(i);
+    if(constraint->getConstraintType() != constraint_states[i].type) {
+      throw(Error("journal constraints do not match the world"));
+    }
+    Physics::restoreConstraintState(constraint, constraint_states[i]);
+  }
+}
+
+
+bool Replayer::step()
+{
+  if(step_ >= journal_->step_count_ || data_.atEnd()) {
+    return false;
+  }
+
+  btDynamicsWorld* world = physics_->getWorld();
+  const btCollisionObjectArray& cos = world->getCollisionObjectArray();
+  uint32_t n, index;
+  uint64_t step_index;
+
+  data_.read(step_index);
+  physics_->setStepIndex(step_index);
+
+  data_.read(n);
+  std::vector<char> obj_state;
+  StateBuffer buf;
+  buf.setPhysics(physics_);
+  for(uint32_t i=0; i<n; i++) {
+    data_.read(index);
+    data_.readVector(obj_state);
+    if(index >= objects_.size()) {
+      throw(Error("invalid object index in journal"));
+    }
+    buf.setData(obj_state);
+    objects_[index]->restoreState(buf);
+  }
+
+  data_.read(n);
+  for(uint32_t i=0; i<n; i++) {
+    BodyState state;
+    data_.read(index);
+    data_.read(state);
+    if((int)index >= cos.size()) {
+      throw(Error("invalid body index in journal"));
+    }
+    Physics::restoreBodyState(cos[index], state);
+  }
+
+  data_.read(n);
+  if((int)n != world->getNumConstraints()) {
+    throw(Error("journal constraints do not match the world at step %u", step_));
+  }
+  data_.read(n);
+  for(uint32_t i=0; i<n; i++) {
+    ConstraintState state;
+    data_.read(index);
+    data_.read(state);
+    btTypedConstraint* constraint = world->getConstraint(index);
+    if(constraint->getConstraintType() != state.type) {
+      throw(Error("journal constraints do not match the world at step %u", step_));
+    }
+    Physics::restoreConstraintState(constraint, state);
+  }
+
+  physics_->simulateStep();
+
+  std::vector<BodyState> states(cos.size());
+  for(int i=0; i<cos.size(); i++) {
+    Physics::saveBodyState(cos[i], states[i]);
+  }
+  uint64_t h = 0;
+  if(!states.empty()) {
+    h = body_states_hash(&states[0], states.size()*sizeof(BodyState));
+  }
+  uint64_t recorded_h;
+  data_.read(recorded_h);
+  if(divergence_ < 0 && h != recorded_h) {
+    divergence_ = step_;
+  }
+
+  data_.read(n);
+  tasks_fired_ += n;
+  step_++;
+  return true;
+}
+
+void Replayer::run()
+{
+  while(step()) {}
+}
@@ -0,0 +1,148 @@
+#ifndef RECORD_H_
+#define RECORD_H_
+
+///@file
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include "physics.h"
+#include "object.h"
+
+
+/** @brief Recorded simulation run
+ *
+ * A journal contains the initial state of a world followed by, for each
+ * step, changes made to the world before the step (by tasks or external
+ * code) and a hash of body states after the simulation step.
+ *
+ * Bodies are identified by their index in the world and objects by the
+ * index of their main body. The replayed world must thus have been built
+ * the same way than the recorded one.
+ *
+ * @sa Physics::startRecording(), Replayer
+ */
+class Journal: public SmartObject
+{
+  friend class Recorder;
+  friend class Replayer;
+ public:
+  Journal();
+  virtual ~Journal() {}
+
+  btScalar getStepDt() const { return step_dt_; }
+  /// Return the number of recorded steps
+  unsigned int getStepCount() const { return step_count_; }
+  /// Return the size of recorded data, in bytes
+  size_t getSize() const { return data_.size(); }
+
+  /// Save the journal to a file
+  void save(const std::string& filename) const;
+  /// Load a journal saved with save()
+  static SmartPtr<Journal> load(const std::string& filename);
+
+ private:
+  btScalar step_dt_;
+  uint32_t body_count_;
+  uint32_t object_count_;
+  uint32_t step_count_;
+  StateBuffer data_;
+};
+
+
+/** @brief Record a world into a journal
+ *
+ * Recorders are internal to Physics, they are created and used by the
+ * recording methods and the step() method.
+ *
+ * For each step, body, constraint and object states are compared to the
+ * ones of the previous step. Only modified states are written.
+ * Bodies and objects must not be added or removed during a recording.
+ */
+class Recorder
+{
+ public:
+  /// Start a recording, write the initial state
+  Recorder(Physics* ph);
+  ~Recorder() {}
+
+  Journal* getJournal() const { return journal_.get(); }
+
+  /// Record changes made since the last step
+  void recordChanges();
+  /// Record the result of the simulation step
+  void recordSimulation();
+  /// Record the number of executed tasks, end the step
+  void recordTasks(unsigned int n);
+
+ private:
+  typedef Physics::BodyState BodyState;
+  typedef Physics::ConstraintState ConstraintState;
+
+  /// Check that world bodies and objects did not change
+  void checkWorld() const;
+
+  Physics* physics_;
+  SmartPtr<Journal> journal_;
+  std::vector<btCollisionObject*> bodies_;
+  std::vector<SmartPtr<Object>> objects_;
+  /// States of the previous step
+  std::vector<BodyState> body_states_;
+  std::vector<ConstraintState> constraint_states_;
+  std::vector<std::vector<char>> object_states_;
+};
+
+
+/** @brief Replay a journal
+ *
+ * Recorded changes are applied to the world before each step. Tasks are not
+ * executed, their effects are part of the recorded changes.
+ *
+ * After each step, body states are compared to the recorded ones. The step
+ * of the first difference is saved as divergence step.
+ *
+ * Contact caches are not part of the journal. The recording should be
+ * started on a newly built world (or after a snapshot restore) for the
+ * replay to be exact.
+ */
+class Replayer: public SmartObject
+{
+ public:
+  /** @brief Prepare a replay, apply the initial state to the world
+   *
+   * The world must have been built like the recorded one: same step
+   * duration, same bodies and objects, created in the same order.
+   */
+  Replayer(Physics* ph, Journal* journal);
+  virtual ~Replayer() {}
+
+  /** @brief Replay a single step
+   * @return \e false if the end of the journal has been reached.
+   */
+  bool step();
+  /// Replay all remaining steps
+  void run();
+
+  /// Return the number of replayed steps
+  unsigned int getStep() const { return step_; }
+  /// Return the first step whose result differs, -1 if none
+  int getDivergence() const { return divergence_; }
+  /// Return the number of tasks executed during the recording of replayed steps
+  unsigned int getTasksFired() const { return tasks_fired_; }
+
+ private:
+  typedef Physics::BodyState BodyState;
+  typedef Physics::ConstraintState ConstraintState;
+
+  SmartPtr<Physics> physics_;
+  SmartPtr<Journal> journal_;
+  std::vector<SmartPtr<Object>> objects_;
+  /// Read buffer, journal data may be replayed several times concurrently
+  StateBuffer data_;
+  unsigned int step_;
+  int divergence_;
+  unsigned int tasks_fired_;
+};
+
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef REGISTRY_H_
+#define REGISTRY_H_
+
+///@file
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+
+/** @brief Handle of a registry element
+ *
+ * Handles remain valid when other elements are added or removed. A handle
+ * of a removed element is detected as invalid, even if its slot has been
+ * reused since.
+ */
+struct RegistryHandle
+{
+  static const uint32_t INVALID = UINT32_MAX;
+
+  RegistryHandle(): slot(INVALID), generation(0) {}
+  bool valid() const { return slot != INVALID; }
+
+  uint32_t slot;
+  uint32_t generation;
+};
+
+
+/** @brief Dense registry of elements with stable handles
+ *
+ * Elements are stored contiguously. Adding and removing elements are O(1):
+ * a removed element is replaced by the last one, handles reference slots
+ * which track the position of each element.
+ *
+ * Iteration order only depends on the sequence of additions and removals:
+ * elements are in insertion order until one is removed.
+ */
+template <class T>
+class DenseRegistry
+{
+ public:
+  typedef typename std::vector<T>::const_iterator const_iterator;
+
+  DenseRegistry(): free_slot_(RegistryHandle::INVALID) {}
+
+  /// Add an element, return its handle
+  RegistryHandle add(const T& value)
+  {
+    RegistryHandle h;
+    if(free_slot_ != RegistryHandle::INVALID) {
+      h.slot = free_slot_;
+      free_slot_ = slots_[h.slot].index;
+    } else {
+      h.slot = slots_.size();
+      slots_.push_back(Slot());
+      slots_.back().generation = 0;
+    }
+    Slot& slot = slots_[h.slot];
+    slot.index = values_.size();
+    h.generation = slot.generation;
+    values_.push_back(value);
+    value_slots_.push_back(h.slot);
+    return h;
+  }
+
+  /** @brief Remove an element
+   *
+   * The handle is invalidated. Nothing is done if the handle is not valid.
+   *
+   * @return \e true if an element has been removed.
+   */
+  bool remove(RegistryHandle& h)
+  {
+    if(!contains(h)) {
+      return false;
+    }
+    const uint32_t slot = h.slot;
+    const uint32_t index = slots_[slot].index;
+    const uint32_t last = values_.size() - 1;
+    if(index != last) {
+      // move the last element to the removed one
+      std::swap(values_[index], values_[last]);
+      value_slots_[index] = value_slots_[last];
+      slots_[value_slots_[index]].index = index;
+    }
+    slots_[slot].generation++;
+    slots_[slot].index = free_slot_;
+    free_slot_ = slot;
+    h = RegistryHandle();
+    // the element may own the handle, release it last
+    value_slots_.pop_back();
+    values_.pop_back();
+    return true;
+  }
+
+  /// Return \e true if the handle references an element of the registry
+  bool contains(const RegistryHandle& h) const
+  {
+    return h.slot < slots_.size() && slots_[h.slot].generation == h.generation;
+  }
+
+  const T& get(const RegistryHandle& h) const { return values_[slots_[h.slot].index]; }
+  /// Return the current position of an element
+  size_t index(const RegistryHandle& h) const { return slots_[h.slot].index; }
+
+  size_t size() const { return values_.size(); }
+  bool empty() const { return values_.empty(); }
+  const T& operator[](size_t i) const { return values_[i]; }
+  const T& back() const { return values_.back(); }
+  const_iterator begin() const { return values_.begin(); }
+  const_iterator end() const { return values_.end(); }
+
+ private:
+  /** @brief Handle slot
+   *
+   * For used slots, \e index is the element position. For free slots, it is
+   * the next free slot.
+   */
+  struct Slot
+  {
+    uint32_t index;
+    uint32_t generation;
+  };
+
+  std::vector<T> values_;
+  /// Slot of each element
+  std::vector<uint32_t> value_slots_;
+  std::vector<Slot> slots_;
+  uint32_t free_slot_;
+};
+
+
+#endif
@@ -1,6 +1,7 @@
 #include <cmath>
 #include "robot.h"
 #include "display.h"
+#include "graphics.h"
 #include "physics.h"
 #include "log.h"
 
@@ -45,7 +46,7 @@ RBasic::~RBasic()
 
 void RBasic::addToWorld(Physics* physics)
 {
-  physics->getWorld()->addRigidBody(body_);
+  addBodyToWorld(physics, body_);
   Robot::addToWorld(physics);
 }
 
@@ -56,28 +57,53 @@ void RBasic::removeFromWorld()
   ph_bak->getWorld()->removeRigidBody(body_);
 }
 
+void RBasic::saveState(StateBuffer& buf) const
+{
+  Robot::saveState(buf);
+  buf.write(order_);
+  buf.write(target_xy_);
+  buf.write(target_a_);
+  buf.write(target_back_xy_);
+  buf.write(v_max);
+  buf.write(av_max);
+  buf.write(threshold_xy);
+  buf.write(threshold_a);
+}
+
+void RBasic::restoreState(StateBuffer& buf)
+{
+  Robot::restoreState(buf);
+  buf.read(order_);
+  buf.read(target_xy_);
+  buf.read(target_a_);
+  buf.read(target_back_xy_);
+  buf.read(v_max);
+  buf.read(av_max);
+  buf.read(threshold_xy);
+  buf.read(threshold_a);
+}
+
 
 void RBasic::draw(Display* d) const
 {
   glColor4fv(color_);
   glPushMatrix();
-  drawTransform(body_->getCenterOfMassTransform());
-  if(d->callOrCreateDisplayList(body_->getCollisionShape())) {
-    drawShape(body_->getCollisionShape());
-    d->endDisplayList();
-  }
+  drawTransform(d->getDrawTrans(body_));
+  d->drawShape(body_->getCollisionShape());
   drawDirection(d);
   glPopMatrix();
 }
 
-void RBasic::drawDirection(Display*) const
+void RBasic::drawDirection(Display* d) const
 {
+  // height above the body center, at the drawn orientation
+  const btTransform tr(d->getDrawTrans(body_).getBasis());
   btVector3 aabb_min, aabb_max;
-  body_->getAabb(aabb_min, aabb_max);
+  body_->getCollisionShape()->getAabb(tr, aabb_min, aabb_max);
 
-  btglTranslate(0, 0, aabb_max.getZ()-getPos().getZ()+DIRECTION_CONE_R+Display::draw_epsilon);
+  btglTranslate(0, 0, aabb_max.getZ()+DIRECTION_CONE_R+Display::draw_epsilon);
   btglRotate(90.0f, 0.0f, 1.0f, 0.0f);
-  glutSolidCone(DIRECTION_CONE_R, DIRECTION_CONE_H, Display::draw_div, Display::draw_div);
+  graphics::drawCone(DIRECTION_CONE_R, DIRECTION_CONE_H, Display::draw_div, Display::draw_div);
 }
 
 const float RBasic::DIRECTION_CONE_R = 0.05_m;
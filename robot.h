@@ -54,6 +54,8 @@ class RBasic: public Robot
 
   virtual void addToWorld(Physics* physics);
   virtual void removeFromWorld();
+  virtual void saveState(StateBuffer& buf) const;
+  virtual void restoreState(StateBuffer& buf);
 
   Color4 getColor() const { return color_; }
   /** @brief Set main color
@@ -76,7 +78,8 @@ class RBasic: public Robot
 
 
   virtual const btTransform getTrans() const { return body_->getCenterOfMassTransform(); }
-  virtual void setTrans(const btTransform& tr) { body_->setCenterOfMassTransform(tr); }
+  virtual void setTrans(const btTransform& tr) { body_->setCenterOfMassTransform(tr); markMoved(); }
+  virtual const btCollisionObject* getMainBody() const { return body_; }
 
   /** @brief Turn and move forward asserv
    *
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include "display.h"
 #include "sensors.h"
 #include "physics.h"
@@ -35,8 +36,17 @@ void SRay::setAttachObject(Object* obj)
 }
 
 
+void SRay::addToWorld(Physics* physics)
+{
+  Object::addToWorld(physics);
+  ray_handle_ = physics->getRays().add(this);
+}
+
 void SRay::removeFromWorld()
 {
+  if(physics_) {
+    physics_->getRays().remove(ray_handle_);
+  }
   obj_ = NULL;
   Object::removeFromWorld();
 }
@@ -57,29 +67,45 @@ void SRay::setTrans(const btTransform& tr)
   } else {
     attach_ = obj_->getTrans().inverse() * tr;
   }
+  markMoved();
 }
 
-btScalar SRay::hitTest() const
+btTransform SRay::getDrawTrans(const Display* d) const
 {
-  const btTransform tr = getTrans();
-  btVector3 ray_from = tr * btVector3(range_min_, 0, 0);
-  btVector3 ray_to = tr * btVector3(range_max_, 0, 0);
-  btCollisionWorld::ClosestRayResultCallback ray_cb( ray_from, ray_to );
+  if(!obj_) {
+    return attach_;
+  }
+  const btCollisionObject* body = obj_->getMainBody();
+  if(!body) {
+    return getTrans();
+  }
+  return d->getDrawTrans(body) * attach_;
+}
 
-  physics_->getWorld()->rayTest( ray_from, ray_to, ray_cb );
+void SRay::getRay(btVector3& from, btVector3& to) const
+{
+  const btTransform tr = getTrans();
+  from = tr * btVector3(range_min_, 0, 0);
+  to = tr * btVector3(range_max_, 0, 0);
+}
 
-  if(ray_cb.hasHit()) {
-    return ray_cb.m_closestHitFraction + range_min_;
-  } else {
+btScalar SRay::hitTest() const
+{
+  if(!physics_) {
+    throw(Error("sensor is not in a world"));
+  }
+  const btScalar fraction = physics_->getRays().getHit(ray_handle_);
+  if(fraction < 0) {
     return -1.0;
   }
+  return range_min_ + fraction * (range_max_ - range_min_);
 }
 
 
-void SRay::draw(Display*) const
+void SRay::draw(Display* d) const
 {
   glPushMatrix();
-  drawTransform(getTrans());
+  drawTransform(getDrawTrans(d));
   glColor4fv(color_);
 
   glDisable(GL_LIGHTING);
@@ -93,3 +119,102 @@ void SRay::draw(Display*) const
 }
 
 
+SLidar::SLidar(btScalar min, btScalar max, unsigned int beams, btScalar scan_rate):
+    SRay(min, max), beams_(beams), scan_rate_(0),
+    beams_due_(0), next_beam_(0), scan_count_(0)
+{
+  if(beams == 0) {
+    throw(Error("invalid lidar beam count: %u", beams));
+  }
+  setScanRate(scan_rate);
+  dirs_.resize(beams_);
+  for(unsigned int i=0; i<beams_; i++) {
+    const btScalar a = SIMD_2_PI*i/beams_;
+    dirs_[i] = btVector3(btCos(a), btSin(a), 0);
+  }
+  ranges_.resize(beams_, -1.0);
+  from_.resize(beams_);
+  to_.resize(beams_);
+  fractions_.resize(beams_);
+}
+
+SLidar::~SLidar()
+{
+}
+
+void SLidar::addToWorld(Physics* physics)
+{
+  SRay::addToWorld(physics);
+  enableTickCallback();
+}
+
+void SLidar::setScanRate(btScalar rate)
+{
+  if(rate < 0) {
+    throw(Error("invalid lidar scan rate: %f", rate));
+  }
+  scan_rate_ = rate;
+}
+
+
+void SLidar::tickCallback()
+{
+  unsigned int n = beams_;
+  if(scan_rate_ > 0) {
+    beams_due_ += beams_ * scan_rate_ * physics_->getStepDt();
+    n = (unsigned int)beams_due_;
+    beams_due_ -= n;
+  }
+  while(n > 0) {
+    const unsigned int k = std::min(n, beams_ - next_beam_);
+    castBeams(next_beam_, k);
+    next_beam_ += k;
+    n -= k;
+    if(next_beam_ == beams_) {
+      std::lock_guard<std::mutex> lock(scan_mutex_);
+      scan_ = ranges_;
+      scan_count_++;
+      next_beam_ = 0;
+    }
+  }
+}
+
+void SLidar::castBeams(unsigned int first, unsigned int n)
+{
+  const btTransform tr = getTrans();
+  const btMatrix3x3& basis = tr.getBasis();
+  const btVector3& origin = tr.getOrigin();
+  for(unsigned int i=0; i<n; i++) {
+    const btVector3 dir = basis * dirs_[first+i];
+    from_[i] = origin + dir * range_min_;
+    to_[i] = origin + dir * range_max_;
+  }
+  RayBatch::castRays(physics_->getWorld(), n, &from_[0], &to_[0], &fractions_[0], candidates_, getCollisionGroup(), getCollisionMask());
+  for(unsigned int i=0; i<n; i++) {
+    const btScalar f = fractions_[i];
+    ranges_[first+i] = f < 0 ? -1.0 : range_min_ + f * (range_max_ - range_min_);
+  }
+}
+
+
+void SLidar::draw(Display* d) const
+{
+  glPushMatrix();
+  drawTransform(getDrawTrans(d));
+  glColor4fv(color_);
+
+  glDisable(GL_LIGHTING);
+  glBegin(GL_LINES);
+  // the physics thread may complete a scan meanwhile
+  std::lock_guard<std::mutex> lock(scan_mutex_);
+  for(size_t i=0; i<scan_.size(); i++) {
+    const btScalar d = scan_[i] < 0 ? range_max_ : scan_[i];
+    btglVertex3(dirs_[i].x() * range_min_, dirs_[i].y() * range_min_, 0);
+    btglVertex3(dirs_[i].x() * d, dirs_[i].y() * d, 0);
+  }
+  glEnd();
+  glEnable(GL_LIGHTING);
+
+  glPopMatrix();
+}
+
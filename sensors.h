@@ -3,6 +3,8 @@
 
 ///@file
 
+#include <vector>
+#include <mutex>
 #include "object.h"
 
 
@@ -24,10 +26,17 @@ class SRay: public Object
   virtual ~SRay();
 
   /** @brief Get hit distance
+   *
+   * Sensors of a world are tested in batch, results are cached until the
+   * next step (see RayBatch).
+   *
    * @retval a positive value in sensor range on success, -1.0 otherwise
    */
   btScalar hitTest() const;
 
+  /// Get ray ends, in world coordinates
+  void getRay(btVector3& from, btVector3& to) const;
+
   Object* getAttachObject() const { return obj_; }
   /** @brief Attach the sensor to an object
    *
@@ -38,8 +47,9 @@ class SRay: public Object
   void setAttachObject(Object* obj);
 
   const btTransform& getAttachPoint() const { return attach_; }
-  void setAttachPoint(const btTransform& tr) { attach_ = tr; }
+  void setAttachPoint(const btTransform& tr) { attach_ = tr; markMoved(); }
 
+  virtual void addToWorld(Physics* physics);
   virtual void removeFromWorld();
 
   virtual const btTransform getTrans() const;
@@ -60,6 +70,88 @@ class SRay: public Object
   btScalar range_min_, range_max_;
 
   Color4 color_;
+
+  /// Get the transform to draw, see Display::getDrawTrans()
+  btTransform getDrawTrans(const Display* d) const;
+
+ private:
+  /// Handle in world's ray batch
+  RegistryHandle ray_handle_;
+};
+
+
+/** @brief Rotating multi-beam lidar
+ *
+ * The lidar turns around its Z axis. Beams are evenly distributed over a
+ * revolution, the first one along the X axis. Each beam behaves like a
+ * SRay with the same range; hitTest() returns the hit of the first beam,
+ * in the current pose.
+ *
+ * Beams are cast during simulation substeps, at the lidar scan rate: a
+ * revolution takes several steps, each step casting the beams covered
+ * during it. Beams of a step are cast at once (see RayBatch::castRays()).
+ * If the scan rate is null, a whole revolution is cast at each step.
+ *
+ * Completed revolutions are available with getScan().
+ *
+ * @note Lidar's scan progress is not saved in snapshots.
+ */
+class SLidar: public SRay
+{
+ public:
+  /** @brief Constructor
+   *
+   * @param min  minimum range
+   * @param max  maximum range
+   * @param beams  number of beams per revolution
+   * @param scan_rate  revolutions per second, 0 for a revolution per step
+   */
+  SLidar(btScalar min, btScalar max, unsigned int beams, btScalar scan_rate=0);
+  virtual ~SLidar();
+
+  virtual void addToWorld(Physics* physics);
+
+  unsigned int getBeams() const { return beams_; }
+  btScalar getScanRate() const { return scan_rate_; }
+  void setScanRate(btScalar rate);
+
+  /** @brief Return the last complete scan
+   *
+   * Hit distance of each beam, -1.0 if there was no hit. The scan is empty
+   * until the first revolution completes.
+   */
+  const std::vector<btScalar>& getScan() const { return scan_; }
+  /// Return the number of completed revolutions
+  unsigned long getScanCount() const { return scan_count_; }
+
+  virtual void tickCallback();
+
+  /// Draw the last scan hits
+  virtual void draw(Display* d) const;
+
+ private:
+  /// Cast \e n beams, starting at beam \e first
+  void castBeams(unsigned int first, unsigned int n);
+
+  unsigned int beams_;
+  btScalar scan_rate_;
+  /// Beam directions, in lidar referential
+  btAlignedObjectArray<btVector3> dirs_;
+  /// Beams due but not cast yet, may be fractional
+  btScalar beams_due_;
+  /// Next beam to cast in the current revolution
+  unsigned int next_beam_;
+  /// Current revolution
+  std::vector<btScalar> ranges_;
+  std::vector<btScalar> scan_;
+  unsigned long scan_count_;
+  /// Protect scan_ updates against draws of a threaded run
+  mutable std::mutex scan_mutex_;
+
+  /// Buffers kept to avoid reallocations
+  btAlignedObjectArray<btVector3> from_, to_;
+  std::vector<btScalar> fractions_;
+  std::vector<btCollisionObject*> candidates_;
 };
 
 
@@ -106,8 +106,21 @@ template<class T> void bullet_ptr_release(T* p)
 }
 
 #include "bullet.h"
+
+/** @brief Release resources associated to a shape
+ *
+ * Called before a shape is deleted, see Display::releaseKey().
+ */
+void releaseShapeResources(const btCollisionShape* p);
+
 inline void SmartPtr_add_ref(btCollisionShape* p) { bullet_ptr_add_ref(p); }
-inline void SmartPtr_release(btCollisionShape* p) { bullet_ptr_release(p); }
+inline void SmartPtr_release(btCollisionShape* p)
+{
+  if((size_t)p->getUserPointer() == 1) {
+    releaseShapeResources(p);
+  }
+  bullet_ptr_release(p);
+}
 
 //@}
 
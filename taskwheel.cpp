@@ -0,0 +1,276 @@
+#include <algorithm>
+#include "taskwheel.h"
+#include "physics.h"
+#include "log.h"
+
+
+/** @brief Task node
+ *
+ * A node is either in a wheel slot, in the ready heap or in the free list.
+ * Nodes of a same task are linked to allow removing them all.
+ */
+struct TaskWheel::Node
+{
+  SmartPtr<TaskPhysics> task;
+  uint64_t step;
+  uint64_t seq;
+  btScalar time;
+  /// Slot list links, \e pprev is \e NULL for ready nodes
+  Node* next;
+  Node** pprev;
+  /// Links of nodes of the same task
+  Node* task_next;
+  Node* task_prev;
+};
+
+
+/// Comparison for the ready heap (first node is the first to execute)
+static bool node_later(const TaskWheel::Node* a, const TaskWheel::Node* b)
+{
+  if(a->time != b->time) {
+    return a->time > b->time;
+  }
+  return a->seq > b->seq;
+}
+
+/// Comparison for execution order
+static bool node_before(const TaskWheel::Node* a, const TaskWheel::Node* b)
+{
+  if(a->step != b->step) {
+    return a->step < b->step;
+  }
+  return node_later(b, a);
+}
+
+
+TaskWheel::TaskWheel(uint64_t next_step):
+    next_step_(next_step), next_seq_(0), size_(0), free_nodes_(NULL)
+{
+  std::fill(&slots_[0][0], &slots_[0][0]+LEVELS*SLOTS, (Node*)NULL);
+}
+
+TaskWheel::~TaskWheel()
+{
+  reset(0);
+}
+
+
+void TaskWheel::schedule(TaskPhysics* task, uint64_t step, btScalar time)
+{
+  if(task->wheel_ != NULL && task->wheel_ != this) {
+    throw(Error("task already scheduled in another world"));
+  }
+  Node* node = allocNode();
+  node->task = task;
+  node->step = step;
+  node->time = time;
+  node->seq = next_seq_++;
+  // link to the task
+  node->task_prev = NULL;
+  node->task_next = task->nodes_;
+  if(task->nodes_) {
+    task->nodes_->task_prev = node;
+  }
+  task->nodes_ = node;
+  task->wheel_ = this;
+  size_++;
+  insert(node);
+}
+
+void TaskWheel::cancel(TaskPhysics* task)
+{
+  if(task->wheel_ != this) {
+    return;
+  }
+  // releasing nodes may delete the task, keep it alive until we are done
+  SmartPtr<TaskPhysics> ref = task;
+  while(task->nodes_) {
+    Node* node = task->nodes_;
+    task->nodes_ = node->task_next;
+    unlink(node);
+    freeNode(node);
+  }
+  task->wheel_ = NULL;
+}
+
+void TaskWheel::advance(uint64_t step)
+{
+  while(next_step_ <= step) {
+    const uint64_t s = next_step_;
+    const unsigned int index = s & (SLOTS-1);
+    // cascade higher levels when a lower one wraps
+    if(index == 0) {
+      for(unsigned int level=1; level<LEVELS; level++) {
+        if(cascade(level, (s >> (level*SLOT_BITS)) & (SLOTS-1)) != 0) {
+          break;
+        }
+      }
+    }
+    Node* node = slots_[0][index];
+    slots_[0][index] = NULL;
+    while(node) {
+      Node* next = node->next;
+      node->pprev = NULL;
+      ready_.push_back(node);
+      std::push_heap(ready_.begin(), ready_.end(), node_later);
+      node = next;
+    }
+    next_step_ = s+1;
+  }
+}
+
+bool TaskWheel::popReady(SmartPtr<TaskPhysics>& task)
+{
+  if(ready_.empty()) {
+    return false;
+  }
+  std::pop_heap(ready_.begin(), ready_.end(), node_later);
+  Node* node = ready_.back();
+  ready_.pop_back();
+
+  // unlink from the task
+  TaskPhysics* t = node->task;
+  if(node->task_prev) {
+    node->task_prev->task_next = node->task_next;
+  } else {
+    t->nodes_ = node->task_next;
+  }
+  if(node->task_next) {
+    node->task_next->task_prev = node->task_prev;
+  }
+  if(t->nodes_ == NULL) {
+    t->wheel_ = NULL;
+  }
+
+  // transfer the node reference to the returned pointer
+  SmartPtr<TaskPhysics> old;
+  old.swap(task);
+  task.swap(node->task);
+  freeNode(node);
+  return true;
+}
+
+void TaskWheel::getEntries(std::vector<Entry>& entries) const
+{
+  std::vector<Node*> nodes(ready_);
+  for(unsigned int level=0; level<LEVELS; level++) {
+    for(unsigned int i=0; i<SLOTS; i++) {
+      for(Node* node=slots_[level][i]; node; node=node->next) {
+        nodes.push_back(node);
+      }
+    }
+  }
+  std::sort(nodes.begin(), nodes.end(), node_before);
+
+  entries.resize(nodes.size());
+  for(size_t i=0; i<nodes.size(); i++) {
+    entries[i].task = nodes[i]->task;
+    entries[i].step = nodes[i]->step;
+    entries[i].time = nodes[i]->time;
+  }
+}
+
+void TaskWheel::reset(uint64_t next_step)
+{
+  std::vector<Node*> nodes;
+  nodes.swap(ready_);
+  for(unsigned int level=0; level<LEVELS; level++) {
+    for(unsigned int i=0; i<SLOTS; i++) {
+      for(Node* node=slots_[level][i]; node; node=node->next) {
+        nodes.push_back(node);
+      }
+      slots_[level][i] = NULL;
+    }
+  }
+  // tasks may be deleted when releasing nodes, clear links first
+  for(auto node : nodes) {
+    node->task->wheel_ = NULL;
+    node->task->nodes_ = NULL;
+  }
+  for(auto node : nodes) {
+    freeNode(node);
+  }
+  next_step_ = next_step;
+}
+
+
+void TaskWheel::insert(Node* node)
+{
+  if(node->step < next_step_) {
+    node->pprev = NULL;
+    ready_.push_back(node);
+    std::push_heap(ready_.begin(), ready_.end(), node_later);
+    return;
+  }
+
+  uint64_t step = node->step;
+  uint64_t delta = step - next_step_;
+  unsigned int level = 0;
+  while(level < LEVELS-1 && delta >= ((uint64_t)1 << ((level+1)*SLOT_BITS))) {
+    level++;
+  }
+  // tasks beyond the last level are put in its last slot, they will be
+  // cascaded again when reached
+  const uint64_t max_delta = ((uint64_t)1 << (LEVELS*SLOT_BITS)) - 1;
+  if(delta > max_delta) {
+    step = next_step_ + max_delta;
+  }
+  Node** slot = &slots_[level][(step >> (level*SLOT_BITS)) & (SLOTS-1)];
+  node->next = *slot;
+  if(node->next) {
+    node->next->pprev = &node->next;
+  }
+  node->pprev = slot;
+  *slot = node;
+}
+
+unsigned int TaskWheel::cascade(unsigned int level, unsigned int index)
+{
+  Node* node = slots_[level][index];
+  slots_[level][index] = NULL;
+  while(node) {
+    Node* next = node->next;
+    insert(node);
+    node = next;
+  }
+  return index;
+}
+
+void TaskWheel::unlink(Node* node)
+{
+  if(node->pprev) {
+    *node->pprev = node->next;
+    if(node->next) {
+      node->next->pprev = node->pprev;
+    }
+  } else {
+    // ready node, the ready set is small
+    auto it = std::find(ready_.begin(), ready_.end(), node);
+    ready_.erase(it);
+    std::make_heap(ready_.begin(), ready_.end(), node_later);
+  }
+}
+
+TaskWheel::Node* TaskWheel::allocNode()
+{
+  if(free_nodes_ == NULL) {
+    Node* chunk = new Node[CHUNK_SIZE];
+    chunks_.push_back(std::unique_ptr<Node[]>(chunk));
+    for(unsigned int i=0; i<CHUNK_SIZE; i++) {
+      chunk[i].next = free_nodes_;
+      free_nodes_ = &chunk[i];
+    }
+  }
+  Node* node = free_nodes_;
+  free_nodes_ = node->next;
+  return node;
+}
+
+void TaskWheel::freeNode(Node* node)
+{
+  node->task = NULL;
+  node->next = free_nodes_;
+  free_nodes_ = node;
+  size_--;
+}
+
@@ -0,0 +1,101 @@
+#ifndef TASKWHEEL_H_
+#define TASKWHEEL_H_
+
+///@file
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include "smart.h"
+
+class TaskPhysics;
+
+
+/** @brief Hierarchical timing wheel for scheduled tasks
+ *
+ * Tasks are scheduled at integer step indexes. The wheel has 4 levels of
+ * 256 slots: the first level holds tasks due in the next 256 steps, the
+ * next ones hold farther tasks with a coarser resolution. Far tasks are
+ * moved to lower levels (cascaded) when the wheel reaches them.
+ *
+ * Scheduling and cancelling are O(1). Cancelled tasks are actually removed.
+ * Task nodes are allocated from a pool and reused.
+ *
+ * Tasks due at the current step are moved to a ready set. They are popped
+ * ordered by scheduled time then by scheduling order.
+ */
+class TaskWheel
+{
+ public:
+  struct Node;
+
+  /// Scheduled task, for snapshots
+  struct Entry
+  {
+    SmartPtr<TaskPhysics> task;
+    uint64_t step;
+    btScalar time;
+  };
+
+  /** @brief Constructor
+   *
+   * @param next_step  index of the first step to advance to
+   */
+  TaskWheel(uint64_t next_step=1);
+  ~TaskWheel();
+
+  /** @brief Schedule a task
+   *
+   * Tasks due before the next step are immediately ready.
+   *
+   * @param task  task to schedule
+   * @param step  step at which the task is due
+   * @param time  scheduled time, used to order tasks of the same step
+   */
+  void schedule(TaskPhysics* task, uint64_t step, btScalar time);
+  /// Remove all pending executions of a task
+  void cancel(TaskPhysics* task);
+  /// Make ready all the tasks due up to the given step
+  void advance(uint64_t step);
+  /** @brief Pop the next ready task
+   *
+   * @return \e false if there are no ready tasks.
+   */
+  bool popReady(SmartPtr<TaskPhysics>& task);
+  /// Return scheduled tasks, in execution order
+  void getEntries(std::vector<Entry>& entries) const;
+  /// Remove all tasks and set the next step
+  void reset(uint64_t next_step);
+
+  /// Return the number of scheduled tasks
+  size_t size() const { return size_; }
+
+ private:
+  static const unsigned int LEVELS = 4;
+  static const unsigned int SLOT_BITS = 8;
+  static const unsigned int SLOTS = 1 << SLOT_BITS;
+  /// Nodes allocated at once by the pool
+  static const unsigned int CHUNK_SIZE = 256;
+
+  /// Insert a node in the wheel or in the ready set
+  void insert(Node* node);
+  /// Move nodes of a slot to lower levels, return the slot index
+  unsigned int cascade(unsigned int level, unsigned int index);
+  /// Remove a node from the wheel or from the ready set
+  void unlink(Node* node);
+  Node* allocNode();
+  void freeNode(Node* node);
+
+  uint64_t next_step_;  ///< next step to advance to
+  uint64_t next_seq_;
+  size_t size_;
+  Node* slots_[LEVELS][SLOTS];
+  /// Ready nodes, as a heap
+  std::vector<Node*> ready_;
+
+  std::vector<std::unique_ptr<Node[]>> chunks_;
+  Node* free_nodes_;
+};
+
+
+#endif
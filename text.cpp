@@ -0,0 +1,119 @@
+#include <memory>
+#include <cstring>
+#include "text.h"
+#include "font.h"
+
+
+TextRenderer::TextRenderer():
+    texture_(0)
+{
+}
+
+TextRenderer::~TextRenderer()
+{
+  // the texture cannot be deleted without the context, see releaseGL()
+}
+
+
+int TextRenderer::getCharWidth()
+{
+  return font_8x13.width;
+}
+
+int TextRenderer::getLineHeight()
+{
+  // keep a blank row between lines
+  return font_8x13.height + 1;
+}
+
+
+void TextRenderer::add(const std::string& s, int x, int y, const Color4& color)
+{
+  const GLfloat w = font_8x13.width;
+  const GLfloat h = font_8x13.height;
+  const GLfloat tw = w / ATLAS_WIDTH;
+  const GLfloat th = h / ATLAS_HEIGHT;
+  const GLfloat y0 = y - (GLfloat)font_8x13.baseline;
+  const GLfloat y1 = y0 + h;
+
+  GLfloat x0 = x;
+  for(unsigned char c : s) {
+    const GLfloat u0 = (c % ATLAS_COLUMNS) * tw;
+    const GLfloat v0 = (c / ATLAS_COLUMNS) * th;
+    const GLfloat x1 = x0 + w;
+    vertices_.push_back(Vertex{{x0, y0}, {u0, v0}, {color.r(), color.g(), color.b(), color.a()}});
+    vertices_.push_back(Vertex{{x1, y0}, {u0+tw, v0}, {color.r(), color.g(), color.b(), color.a()}});
+    vertices_.push_back(Vertex{{x1, y1}, {u0+tw, v0+th}, {color.r(), color.g(), color.b(), color.a()}});
+    vertices_.push_back(Vertex{{x0, y1}, {u0, v0+th}, {color.r(), color.g(), color.b(), color.a()}});
+    x0 = x1;
+  }
+}
+
+void TextRenderer::flush()
+{
+  if(vertices_.empty()) {
+    return;
+  }
+  if(texture_ == 0) {
+    initGL();
+  }
+
+  glPushAttrib(GL_ENABLE_BIT | GL_TEXTURE_BIT);
+  glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+  glDisable(GL_LIGHTING);
+  glDisable(GL_DEPTH_TEST);
+  glEnable(GL_TEXTURE_2D);
+  glBindTexture(GL_TEXTURE_2D, texture_);
+  glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+  glEnableClientState(GL_VERTEX_ARRAY);
+  glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+  glEnableClientState(GL_COLOR_ARRAY);
+  glVertexPointer(2, GL_FLOAT, sizeof(Vertex), vertices_[0].pos);
+  glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), vertices_[0].tex);
+  glColorPointer(4, GL_FLOAT, sizeof(Vertex), vertices_[0].color);
+  glDrawArrays(GL_QUADS, 0, vertices_.size());
+
+  glPopClientAttrib();
+  glPopAttrib();
+  vertices_.clear();
+}
+
+void TextRenderer::releaseGL()
+{
+  if(texture_ != 0) {
+    glDeleteTextures(1, &texture_);
+    texture_ = 0;
+  }
+}
+
+
+void TextRenderer::initGL()
+{
+  // one alpha byte per pixel
+  std::unique_ptr<GLubyte[]> pixels(new GLubyte[ATLAS_WIDTH*ATLAS_HEIGHT]);
+  memset(pixels.get(), 0, ATLAS_WIDTH*ATLAS_HEIGHT);
+  const unsigned int w = font_8x13.width;
+  const unsigned int h = font_8x13.height;
+  for(unsigned int c=0; c<256; c++) {
+    const unsigned char* glyph = font_8x13.data + c*h;
+    const unsigned int x0 = (c % ATLAS_COLUMNS) * w;
+    const unsigned int y0 = (c / ATLAS_COLUMNS) * h;
+    for(unsigned int row=0; row<h; row++) {
+      GLubyte* line = pixels.get() + (y0+row)*ATLAS_WIDTH + x0;
+      for(unsigned int i=0; i<w; i++) {
+        line[i] = (glyph[row] & (0x80 >> i)) ? 0xff : 0;
+      }
+    }
+  }
+
+  glGenTextures(1, &texture_);
+  glBindTexture(GL_TEXTURE_2D, texture_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA8, ATLAS_WIDTH, ATLAS_HEIGHT, 0, GL_ALPHA, GL_UNSIGNED_BYTE, pixels.get());
+  glBindTexture(GL_TEXTURE_2D, 0);
+}
+
@@ -0,0 +1,70 @@
+#ifndef TEXT_H_
+#define TEXT_H_
+
+///@file
+
+#include <string>
+#include <vector>
+#include <SDL/SDL_opengl.h>
+#include "colors.h"
+
+
+/** @brief Batched bitmap text drawing
+ *
+ * Glyphs of a fixed 8x13 font are stored in a single atlas texture. Queued
+ * strings are drawn as textured quads, in a single call.
+ *
+ * It does not require a windowing system and can be used by offscreen
+ * displays.
+ */
+class TextRenderer
+{
+ public:
+  TextRenderer();
+  ~TextRenderer();
+
+  /** @brief Queue a string
+   *
+   * (\e x, \e y) is the start of the baseline, in pixels, with y=0 at the
+   * bottom of the screen.
+   */
+  void add(const std::string& s, int x, int y, const Color4& color);
+
+  /** @brief Draw queued strings
+   *
+   * The context must be current, with an orthographic projection in pixels.
+   */
+  void flush();
+
+  /// Release OpenGL resources
+  void releaseGL();
+
+  /// Glyph advance, in pixels
+  static int getCharWidth();
+  /// Line height, in pixels (glyph height plus one blank row)
+  static int getLineHeight();
+
+ private:
+  /// Glyphs per atlas row
+  static const unsigned int ATLAS_COLUMNS = 16;
+  /// Atlas size, power of two
+  static const GLsizei ATLAS_WIDTH = 128;
+  static const GLsizei ATLAS_HEIGHT = 256;
+
+  /// Create the atlas texture
+  void initGL();
+
+  struct Vertex
+  {
+    GLfloat pos[2];
+    GLfloat tex[2];
+    GLfloat color[4];
+  };
+  std::vector<Vertex> vertices_;
+
+  /// Atlas texture, 0 if not created
+  GLuint texture_;
+};
+
+
+#endif
@@ -0,0 +1,112 @@
+#include "threadpool.h"
+
+
+ThreadPool::ThreadPool(unsigned int threads): stop_(false)
+{
+  if(threads == 0) {
+    threads = std::thread::hardware_concurrency();
+    if(threads == 0) {
+      threads = 1;
+    }
+  }
+  threads_.reserve(threads);
+  for(unsigned int i=0; i<threads; i++) {
+    threads_.push_back(std::thread(&ThreadPool::workerMain, this));
+  }
+}
+
+ThreadPool& ThreadPool::shared()
+{
+  static ThreadPool pool;
+  return pool;
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cond_work_.notify_all();
+  for(auto& th : threads_) {
+    th.join();
+  }
+}
+
+
+void ThreadPool::parallelFor(unsigned int n, const Job& job, bool help)
+{
+  if(n == 0) {
+    return;
+  }
+
+  Batch batch;
+  batch.job = &job;
+  batch.n = n;
+  batch.next = 0;
+  batch.done = 0;
+  batch.workers = 0;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = batches_.insert(batches_.end(), &batch);
+  cond_work_.notify_all();
+  if(help) {
+    runBatch(&batch, lock);
+  }
+  // wait for iterations run by other threads
+  cond_done_.wait(lock, [&]{ return batch.done == batch.n && batch.workers == 0; });
+  batches_.erase(it);
+  lock.unlock();
+
+  if(batch.error) {
+    std::rethrow_exception(batch.error);
+  }
+}
+
+
+void ThreadPool::runBatch(Batch* batch, std::unique_lock<std::mutex>& lock)
+{
+  batch->workers++;
+  while(batch->next < batch->n) {
+    unsigned int i = batch->next++;
+    lock.unlock();
+    std::exception_ptr error;
+    try {
+      (*batch->job)(i);
+    } catch(...) {
+      error = std::current_exception();
+    }
+    lock.lock();
+    if(error && !batch->error) {
+      batch->error = error;
+    }
+    batch->done++;
+  }
+  batch->workers--;
+  if(batch->done == batch->n && batch->workers == 0) {
+    cond_done_.notify_all();
+  }
+}
+
+
+void ThreadPool::workerMain()
+{
+  std::unique_lock<std::mutex> lock(mutex_);
+  for(;;) {
+    Batch* batch = nullptr;
+    for(auto b : batches_) {
+      if(b->next < b->n) {
+        batch = b;
+        break;
+      }
+    }
+    if(batch) {
+      runBatch(batch, lock);
+    } else if(stop_) {
+      break;
+    } else {
+      cond_work_.wait(lock);
+    }
+  }
+}
+
@@ -0,0 +1,89 @@
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+///@file
+
+#include <vector>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+
+/** @brief Fixed pool of worker threads
+ *
+ * Work is submitted as parallel loops. Loop indexes are distributed
+ * dynamically: a thread which completes an iteration takes the next
+ * available one, whichever the loop it belongs to.
+ *
+ * Several loops can be run concurrently, including from a job of another
+ * loop (nested loops).
+ */
+class ThreadPool
+{
+ public:
+  typedef std::function<void (unsigned int)> Job;
+
+  /** @brief Create a thread pool
+   *
+   * @param threads  worker thread count, 0 to use the hardware concurrency
+   */
+  ThreadPool(unsigned int threads=0);
+  ~ThreadPool();
+
+  /// Return the number of worker threads
+  unsigned int size() const { return threads_.size(); }
+
+  /** @brief Return a process-wide pool
+   *
+   * The pool is created on first use, with one thread per core.
+   */
+  static ThreadPool& shared();
+
+  /** @brief Run a parallel loop
+   *
+   * Call \e job(i) for each \e i in <tt>[0,n)</tt> and return once all
+   * calls have completed.
+   *
+   * If \e help is \e true, the calling thread executes iterations too.
+   * Otherwise, it only waits for their completion.
+   *
+   * If a job throws an exception, remaining iterations are still executed
+   * and the first exception is rethrown.
+   */
+  void parallelFor(unsigned int n, const Job& job, bool help=true);
+
+ private:
+  /// Parallel loop data
+  struct Batch
+  {
+    const Job* job;
+    unsigned int n;
+    unsigned int next;  ///< next iteration to run
+    unsigned int done;  ///< completed iteration count
+    unsigned int workers;  ///< threads currently running iterations
+    std::exception_ptr error;
+  };
+
+  /** @brief Run iterations of a loop
+   * @note Must be called with the mutex locked.
+   */
+  void runBatch(Batch* batch, std::unique_lock<std::mutex>& lock);
+  /// Worker thread main loop
+  void workerMain();
+
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  /// Signaled when new work is available
+  std::condition_variable cond_work_;
+  /// Signaled when a batch is completed
+  std::condition_variable cond_done_;
+  /// Loops being run
+  std::list<Batch*> batches_;
+  bool stop_;
+};
+
+
+#endif
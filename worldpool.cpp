@@ -0,0 +1,53 @@
+#include <algorithm>
+#include "worldpool.h"
+#include "log.h"
+
+
+WorldPool::WorldPool(unsigned int threads):
+    pool_(threads)
+{
+}
+
+
+void WorldPool::addWorld(Physics* ph)
+{
+  if(ph == nullptr) {
+    throw(Error("invalid world"));
+  }
+  if(std::find(worlds_.begin(), worlds_.end(), ph) != worlds_.end()) {
+    throw(Error("world already in the pool"));
+  }
+  worlds_.push_back(ph);
+}
+
+
+std::vector<WorldPool::Result> WorldPool::run(btScalar duration)
+{
+  std::vector<Result> results(worlds_.size());
+  // errors are reported in results, jobs never throw
+  // the calling thread does not run worlds: this allows bindings to detect
+  // they are called from worker threads
+  pool_.parallelFor(worlds_.size(), [&](unsigned int i) {
+    Physics* ph = worlds_[i].get();
+    Result& result = results[i];
+    // worlds with a parallel solver use our threads, which are busy anyway
+    ThreadPool* solver_pool = ph->getSolverThreadPool();
+    if(solver_pool) {
+      ph->setSolverThreadPool(&pool_);
+    }
+    try {
+      ph->runUntil(ph->getTime() + duration);
+    } catch(const std::exception& e) {
+      result.success = false;
+      result.error = e.what();
+    } catch(...) {
+      result.success = false;
+      result.error = "unknown error";
+    }
+    if(solver_pool) {
+      ph->setSolverThreadPool(solver_pool);
+    }
+  }, false);
+  return results;
+}
+
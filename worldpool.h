@@ -0,0 +1,67 @@
+#ifndef WORLDPOOL_H_
+#define WORLDPOOL_H_
+
+///@file
+
+#include <vector>
+#include <string>
+#include "physics.h"
+#include "threadpool.h"
+
+
+/** @brief Run several physical worlds concurrently
+ *
+ * Worlds are stepped in parallel on a fixed pool of threads. Each thread
+ * simulates a whole world then takes the next one which has not been
+ * simulated yet, so that fast worlds do not delay the others.
+ *
+ * Worlds are independent: they must not share objects, tasks or any other
+ * mutable element. Tasks must not access other worlds.
+ */
+class WorldPool: public SmartObject
+{
+ public:
+  /// Simulation result of a single world
+  struct Result
+  {
+    Result(): success(true) {}
+    /// \e false if an error occurred
+    bool success;
+    /// Error message, empty on success
+    std::string error;
+  };
+
+  /** @brief Constructor
+   *
+   * @param threads  worker thread count, 0 to use the hardware concurrency
+   */
+  WorldPool(unsigned int threads=0);
+  virtual ~WorldPool() {}
+
+  /// Add a world to the pool
+  void addWorld(Physics* ph);
+  /// Remove all worlds from the pool
+  void clearWorlds() { worlds_.clear(); }
+  const std::vector<SmartPtr<Physics>>& getWorlds() const { return worlds_; }
+
+  unsigned int getThreadCount() const { return pool_.size(); }
+
+  /** @brief Advance simulation of all worlds
+   *
+   * Each world is simulated up to its current time plus \e duration.
+   * An error in a world stops its simulation but does not affect the others.
+   *
+   * Worlds using a parallel solver solve their islands on the pool threads
+   * during the run, their own solver pool is restored afterwards.
+   *
+   * @return The result of each world, in the same order than worlds.
+   */
+  std::vector<Result> run(btScalar duration);
+
+ private:
+  ThreadPool pool_;
+  std::vector<SmartPtr<Physics>> worlds_;
+};
+
+
+#endif